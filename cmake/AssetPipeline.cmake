@@ -0,0 +1,54 @@
+include(ExternalProject)
+
+# Host tools used to convert assets at build time. These are built with the native compiler, not the nxdk toolchain.
+set(ASSET_TOOLS_DIR ${CMAKE_CURRENT_BINARY_DIR}/tools)
+set(ASSET_OUTPUT_DIR ${CMAKE_CURRENT_BINARY_DIR}/assets)
+file(MAKE_DIRECTORY ${ASSET_OUTPUT_DIR})
+
+ExternalProject_Add(font_baker
+    SOURCE_DIR ${CMAKE_SOURCE_DIR}/tools/font_baker
+    BINARY_DIR ${ASSET_TOOLS_DIR}/font_baker
+    CMAKE_ARGS -DCMAKE_BUILD_TYPE=Release
+    INSTALL_COMMAND ""
+    BUILD_ALWAYS TRUE
+    BUILD_BYPRODUCTS ${ASSET_TOOLS_DIR}/font_baker/font_baker
+)
+
+ExternalProject_Add(texture_encoder
+    SOURCE_DIR ${CMAKE_SOURCE_DIR}/tools/texture_encoder
+    BINARY_DIR ${ASSET_TOOLS_DIR}/texture_encoder
+    CMAKE_ARGS -DCMAKE_BUILD_TYPE=Release
+    INSTALL_COMMAND ""
+    BUILD_ALWAYS TRUE
+    BUILD_BYPRODUCTS ${ASSET_TOOLS_DIR}/texture_encoder/texture_encoder
+)
+
+# Pack a TTF font into an A8 atlas blob that can be #embed'ed and loaded with text_create_baked.
+# Codepoint ranges are passed as extra arguments in the form <first>-<last>.
+function(add_baked_font TARGET_NAME OUTPUT_NAME TTF_FILE FONT_SIZE)
+    set(OUTPUT_FILE ${ASSET_OUTPUT_DIR}/${OUTPUT_NAME})
+    add_custom_command(
+        OUTPUT ${OUTPUT_FILE}
+        COMMAND ${ASSET_TOOLS_DIR}/font_baker/font_baker ${TTF_FILE} ${FONT_SIZE} ${ARGN} ${OUTPUT_FILE}
+        DEPENDS font_baker ${TTF_FILE}
+        COMMENT "Baking font atlas ${OUTPUT_NAME}"
+        VERBATIM
+    )
+    target_sources(${TARGET_NAME} PRIVATE ${OUTPUT_FILE})
+    set_property(SOURCE ${CMAKE_SOURCE_DIR}/main.c APPEND PROPERTY OBJECT_DEPENDS ${OUTPUT_FILE})
+endfunction()
+
+# Convert an image into a GPU ready texture blob that can be #embed'ed and loaded with texture_create_from_asset.
+# FORMAT is one of rgba, rgba_swizzled, p8, dxt1 or dxt5. The encoder reports the resulting size of each asset.
+function(add_encoded_texture TARGET_NAME OUTPUT_NAME IMAGE_FILE FORMAT)
+    set(OUTPUT_FILE ${ASSET_OUTPUT_DIR}/${OUTPUT_NAME})
+    add_custom_command(
+        OUTPUT ${OUTPUT_FILE}
+        COMMAND ${ASSET_TOOLS_DIR}/texture_encoder/texture_encoder ${IMAGE_FILE} ${FORMAT} ${OUTPUT_FILE}
+        DEPENDS texture_encoder ${IMAGE_FILE}
+        COMMENT "Encoding texture ${OUTPUT_NAME}"
+        VERBATIM
+    )
+    target_sources(${TARGET_NAME} PRIVATE ${OUTPUT_FILE})
+    set_property(SOURCE ${CMAKE_SOURCE_DIR}/main.c APPEND PROPERTY OBJECT_DEPENDS ${OUTPUT_FILE})
+endfunction()
@@ -23,6 +23,7 @@
 #include "ftp.h"
 #include "ftp_server.h"
 #include "ftp_file.h"
+#include "ftp_pool.h"
 #include "lwip/opt.h"
 #include "lwip/api.h"
 
@@ -31,6 +32,15 @@
 static const char *no_conn_allowed = "421 No more connections allowed\r\n";
 static server_stru_t ftp_links[FTP_NBR_CLIENTS];
 
+// connection state is only allocated while a client is connected
+static ftp_pool_t ftp_data_pool;
+static uint32_t ftp_connection_count;
+
+size_t ftp_memory_footprint(void)
+{
+	return ftp_pool_footprint();
+}
+
 // single ftp connection loop
 static void ftp_task(void *param)
 {
@@ -42,17 +52,31 @@ static void ftp_task(void *param)
 	server_stru_t *ftp = (server_stru_t *)param;
 
 	// save the instance number
-	ftp->ftp_data.ftp_con_num = ftp->number;
+	ftp->ftp_data->ftp_con_num = ftp->number;
+	ftp->ftp_data->data_port_incremented = ftp->data_port_incremented;
 
 	// feedback
 	FTP_PRINTF("FTP %d connected\r\n", ftp->number);
 
 	// service FTP server
-	ftp_service(ftp->ftp_connection, &ftp->ftp_data);
+	ftp_service(ftp->ftp_connection, ftp->ftp_data);
 
 	// delete the connection.
 	netconn_delete(ftp->ftp_connection);
 
+	// give the connection state back
+	ftp->data_port_incremented = ftp->ftp_data->data_port_incremented;
+	ftp_pool_put(&ftp_data_pool, ftp->ftp_data);
+	ftp->ftp_data = NULL;
+
+	// nobody connected anymore, give the pooled memory back to the dashboard
+	if (__atomic_sub_fetch(&ftp_connection_count, 1, __ATOMIC_RELAXED) == 0)
+	{
+		ftp_pool_trim(&ftp_data_pool);
+		ftps_cache_trim();
+		FTP_PRINTF("FTP idle, holding %u bytes\r\n", (unsigned int)ftp_memory_footprint());
+	}
+
 	// reset the socket to be sure
 	ftp->ftp_connection = NULL;
 
@@ -80,6 +104,10 @@ void ftp_server(void)
 	struct netconn *ftp_client_conn;
 	uint8_t index = 0;
 
+	// Start the threads that read and write files for all connections
+	ftps_io_init();
+	ftp_pool_init(&ftp_data_pool, sizeof(ftp_data_t), FTP_NBR_CLIENTS);
+
 	// Create the TCP connection handle
 	ftp_srv_conn = netconn_new(NETCONN_TCP);
 
@@ -111,8 +139,15 @@ void ftp_server(void)
 					break;
 			}
 
-			// all connections in use?
-			if (index >= FTP_NBR_CLIENTS)
+			// get memory for the connection state
+			ftp_data_t *ftp_data = NULL;
+			if (index < FTP_NBR_CLIENTS)
+			{
+				ftp_data = ftp_pool_get(&ftp_data_pool);
+			}
+
+			// all connections in use or out of memory?
+			if (ftp_data == NULL)
 			{
 				// tell that no connections are allowed
 				netconn_write(ftp_client_conn, no_conn_allowed, strlen(no_conn_allowed), NETCONN_COPY);
@@ -124,7 +159,7 @@ void ftp_server(void)
 				ftp_client_conn = NULL;
 
 				// feedback
-				FTP_PRINTF("FTP connection denied, all connections in use\r\n");
+				FTP_PRINTF("FTP connection denied, all connections in use or out of memory\r\n");
 
 			}
 			// not all connections in use
@@ -132,6 +167,9 @@ void ftp_server(void)
 			{
 				// copy client connection
 				ftp_links[index].ftp_connection = ftp_client_conn;
+				memset(ftp_data, 0, sizeof(ftp_data_t));
+				ftp_links[index].ftp_data = ftp_data;
+				__atomic_add_fetch(&ftp_connection_count, 1, __ATOMIC_RELAXED);
 
 				// zero out client connection
 				ftp_client_conn = NULL;
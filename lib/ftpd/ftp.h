@@ -37,6 +37,18 @@
 // number of clients we want to serve simultaneously, same as netbuf limit
 #define FTP_NBR_CLIENTS 10
 
+// most memory the connection and file cache pools hold together, given back once the last client disconnects
+#define FTP_POOL_MEMORY_MAX (3 * 1024 * 1024)
+
+// memory the FTP server leaves free for the rest of the dashboard when growing its buffer pools
+#define FTP_POOL_MEMORY_RESERVE (8 * 1024 * 1024)
+
+// a download is aborted once the client hasn't acknowledged any data for this long
+#define FTP_DATA_ACK_TIMEOUT_MS 30000
+
+// longest sleep between checks on how much of a download the client has acknowledged
+#define FTP_DATA_ACK_POLL_MAX_MS 16
+
 #ifdef FTP_DEBUG
 #define FTP_CONN_DEBUG(ftp, f, ...) printf("[%d] " f, ftp->ftp_con_num, ##__VA_ARGS__)
 #define FTP_PRINTF printf
@@ -51,7 +63,8 @@ typedef struct
 	uint8_t number;
 	struct netconn *ftp_connection;
 	sys_thread_t *task_handle;
-	ftp_data_t ftp_data;
+	ftp_data_t *ftp_data; // From ftp_data_pool while connected
+	uint8_t data_port_incremented; // Kept between connections, see ftp_service
 	char task_name[12];
 } server_stru_t;
 
@@ -75,4 +88,17 @@ typedef struct
  */
 void ftp_server(void);
 
+/**
+ * Number of RETR and STOR file transfers in progress over all
+ * connections. Safe to call from any thread.
+ */
+uint32_t ftp_active_transfers(void);
+
+/**
+ * Bytes of memory the FTP server holds for connection state and
+ * file cache buffers. Drops to zero once all clients disconnected.
+ * Safe to call from any thread.
+ */
+size_t ftp_memory_footprint(void);
+
 #endif // _FTPS_H_
@@ -7,6 +7,7 @@
 
 #include "ftp.h"
 #include "ftp_file.h"
+#include "ftp_pool.h"
 #include "ftp_server.h"
 #include <fileapi.h>
 #include <windef.h>
@@ -14,7 +15,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
-#include <stdatomic.h>
 
 #include <nxdk/mount.h>
 
@@ -288,50 +288,168 @@ FRESULT ftps_f_unlink(const char *path)
 	return FR_OK;
 }
 
-typedef struct async_writer_mbox_item {
-	fil_handle_t *fp;
-	void *write_buffer;
-	int write_len;
-} async_writer_mbox_item_t;
-static HANDLE async_writer;
-static HANDLE async_writer_semaphore;
-#define ASYNC_WRITE_MBOX_SIZE 128
-static async_writer_mbox_item_t async_writer_mbox[ASYNC_WRITE_MBOX_SIZE];
-static atomic_size_t async_writer_mbox_head;
-static atomic_size_t async_writer_mbox_tail;
-static int async_writer_init = 1;
-
-static DWORD WINAPI async_writer_thread(LPVOID lpThreadParameter)
+// Reads and writes are queued per file and carried out by a small pool of I/O threads, so the connection threads keep
+// the network busy while the disk works. A file with queued requests waits in the ready list until an I/O thread takes
+// it. The thread carries out one request and puts the file back at the end of the list if it has more, so a busy
+// upload can't starve the other connections. Only one thread works on a file at a time, which keeps its requests in
+// order. The ready list and the queue indices are guarded by io_mutex.
+static HANDLE io_threads[FILE_IO_THREADS];
+static HANDLE io_mutex;
+static HANDLE io_ready_semaphore; // Counts the files in the ready list
+static fil_handle_t *io_ready_head;
+static fil_handle_t *io_ready_tail;
+
+// Cache buffers are only held while a file is open, so idle connections don't tie up memory
+static ftp_pool_t cache_pool;
+
+static BOOL read_at(HANDLE hfile, void *buffer, uint32_t len, uint32_t *read, uint32_t position)
+{
+	SetFilePointer(hfile, position, NULL, FILE_BEGIN);
+	return ReadFile(hfile, (LPVOID)buffer, len, (LPDWORD)read, NULL);
+}
+
+// Caller holds io_mutex
+static void io_ready_push(fil_handle_t *fp)
+{
+	fp->io_next = NULL;
+	if (io_ready_tail != NULL)
+	{
+		io_ready_tail->io_next = fp;
+	}
+	else
+	{
+		io_ready_head = fp;
+	}
+	io_ready_tail = fp;
+	ReleaseSemaphore(io_ready_semaphore, 1, NULL);
+}
+
+// Caller holds io_mutex
+static fil_handle_t *io_ready_pop(void)
+{
+	fil_handle_t *fp = io_ready_head;
+	assert(fp != NULL);
+	io_ready_head = fp->io_next;
+	if (io_ready_head == NULL)
+	{
+		io_ready_tail = NULL;
+	}
+	return fp;
+}
+
+static DWORD WINAPI io_thread(LPVOID lpThreadParameter)
 {
 	(void)lpThreadParameter;
 	while (1)
 	{
-		WaitForSingleObject(async_writer_semaphore, INFINITE);
-		async_writer_mbox_item_t *item = &async_writer_mbox[async_writer_mbox_head];
-		async_writer_mbox_head = (async_writer_mbox_head + 1) % ASYNC_WRITE_MBOX_SIZE;
-
-		HANDLE hfile = item->fp->h;
-		DWORD bw;
-		if (WriteFile(hfile, item->write_buffer, item->write_len, &bw, NULL)) {
-			item->fp->write_total += bw;
+		WaitForSingleObject(io_ready_semaphore, INFINITE);
+		WaitForSingleObject(io_mutex, INFINITE);
+		fil_handle_t *fp = io_ready_pop();
+		file_io_request_t *request = &fp->io_queue[fp->io_head % FILE_IO_QUEUE_SIZE];
+		ReleaseMutex(io_mutex);
+
+		BOOL ok;
+		if (request->write)
+		{
+			DWORD bw;
+			ok = WriteFile(fp->h, request->buffer, request->len, &bw, NULL);
+			if (ok)
+			{
+				fp->write_total += bw;
+			}
 		}
-		SetEvent(item->fp->write_complete);
+		else
+		{
+			fp->read_bytes = 0;
+			ok = read_at(fp->h, request->buffer, request->len, &fp->read_bytes, request->position);
+		}
+		if (!ok)
+		{
+			fp->io_error = TRUE;
+		}
+
+		// The connection thread may close the file once it sees the request completed. Signalling under the mutex
+		// lets ftps_f_close wait for this thread to let go of the file before closing io_event.
+		WaitForSingleObject(io_mutex, INFINITE);
+		fp->io_head++;
+		if (fp->io_head != fp->io_tail)
+		{
+			io_ready_push(fp);
+		}
+		else
+		{
+			fp->io_scheduled = FALSE;
+		}
+		__atomic_fetch_add(&fp->io_completed, 1, __ATOMIC_RELEASE);
+		SetEvent(fp->io_event);
+		ReleaseMutex(io_mutex);
 	}
 	return 0;
 }
 
-FRESULT ftps_f_open(FIL *fp, const char *path, uint8_t mode)
+// Starts the I/O threads, call once before the first file is opened
+void ftps_io_init(void)
+{
+	// FIXME: Have a way to stop the I/O threads
+	io_ready_head = NULL;
+	io_ready_tail = NULL;
+	io_mutex = CreateMutex(NULL, FALSE, NULL);
+	io_ready_semaphore = CreateSemaphore(NULL, 0, FTP_NBR_CLIENTS, NULL);
+	ftp_pool_init(&cache_pool, FILE_CACHE_BUFFER_SIZE, UINT32_MAX); // Only FTP_POOL_MEMORY_MAX limits it
+	for (int i = 0; i < FILE_IO_THREADS; i++)
+	{
+		io_threads[i] = CreateThread(NULL, 0, io_thread, NULL, 0, NULL);
+	}
+}
+
+// Only the connection thread that opened the file queues requests on it
+static void io_queue(fil_handle_t *fp, BOOL write, void *buffer, uint32_t len, uint32_t position)
+{
+	assert(fp->io_tail - __atomic_load_n(&fp->io_completed, __ATOMIC_ACQUIRE) < FILE_IO_QUEUE_SIZE);
+	file_io_request_t *request = &fp->io_queue[fp->io_tail % FILE_IO_QUEUE_SIZE];
+	request->buffer = buffer;
+	request->len = len;
+	request->position = position;
+	request->write = write;
+
+	WaitForSingleObject(io_mutex, INFINITE);
+	fp->io_tail++;
+	if (!fp->io_scheduled)
+	{
+		fp->io_scheduled = TRUE;
+		io_ready_push(fp);
+	}
+	ReleaseMutex(io_mutex);
+}
+
+// Waits until at most max_pending of the file's requests are still queued or in progress
+static void io_wait(fil_handle_t *fp, uint32_t max_pending)
+{
+	while (fp->io_tail - __atomic_load_n(&fp->io_completed, __ATOMIC_ACQUIRE) > max_pending)
+	{
+		WaitForSingleObject(fp->io_event, INFINITE);
+	}
+}
+
+// Gives the cache buffers back to the system, does nothing while a file is open
+void ftps_cache_trim(void)
+{
+	ftp_pool_trim(&cache_pool);
+}
+
+static void cache_release(fil_handle_t *fp)
 {
-	// FIXME: Have a way to close the async writer thread
-	if (async_writer_init) {
-		async_writer_init = 0;
-		memset(async_writer_mbox, 0, sizeof(async_writer_mbox));
-		async_writer_mbox_head = 0;
-		async_writer_mbox_tail = 0;
-		async_writer_semaphore = CreateSemaphore(0, 0, ASYNC_WRITE_MBOX_SIZE, NULL);
-		async_writer = CreateThread(0, 0, async_writer_thread, NULL, 0, NULL);
+	for (int i = 0; i < fp->cache_count; i++)
+	{
+		ftp_pool_put(&cache_pool, fp->cache_buf[i]);
+		fp->cache_buf[i] = NULL;
 	}
+	fp->cache_count = 0;
+}
 
+// Takes up to cache_count cache buffers for the file, fewer when the pool or free memory runs low
+FRESULT ftps_f_open(FIL *fp, const char *path, uint8_t mode, int cache_count)
+{
 	DWORD access = 0, disposition = 0;
 	access |= (mode & FA_READ) ? GENERIC_READ : 0;
 	access |= (mode & FA_WRITE) ? GENERIC_WRITE : 0;
@@ -339,18 +457,36 @@ FRESULT ftps_f_open(FIL *fp, const char *path, uint8_t mode)
 
 	memset(fp, 0, sizeof(FIL));
 
+	// Get the buffers first so an existing file isn't truncated when there's no memory to write it
+	assert(cache_count >= FILE_CACHE_MIN && cache_count <= FILE_CACHE_MAX);
+	while (fp->cache_count < cache_count)
+	{
+		fp->cache_buf[fp->cache_count] = ftp_pool_get(&cache_pool);
+		if (fp->cache_buf[fp->cache_count] == NULL)
+		{
+			break;
+		}
+		fp->cache_count++;
+	}
+	if (fp->cache_count < FILE_CACHE_MIN)
+	{
+		cache_release(fp);
+		return FR_NOT_ENOUGH_CORE;
+	}
+
 	get_win_path(path, fp->path);
-	FILE_DBG("Opening %s\n", fp->path);
+	FILE_DBG("Opening %s with %d cache buffers\n", fp->path, fp->cache_count);
 	HANDLE hfile = CreateFileA(fp->path, access, FILE_SHARE_READ, NULL, disposition, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING, NULL);
 	if (hfile == INVALID_HANDLE_VALUE)
 	{
+		cache_release(fp);
 		return FR_NO_FILE;
 	}
 	fp->h = hfile;
+	fp->io_event = CreateEvent(NULL, FALSE, FALSE, NULL);
 	if (mode & FA_WRITE)
 	{
 		fp->opened_for_write = 1;
-		fp->write_complete = CreateEvent(NULL, FALSE, TRUE, NULL);
 	}
 	return FR_OK;
 }
@@ -372,11 +508,13 @@ FRESULT ftps_f_close(FIL *fp)
 	FRESULT res = FR_OK;
 	DWORD bw;
 
+	// Wait for the queued reads and writes to complete
+	io_wait(fp, 0);
+	res = fp->io_error ? FR_DISK_ERR : FR_OK;
+
 	// Did we have the file opened as write?
 	if (fp->opened_for_write)
 	{
-		// Wait for the last write to complete
-		WaitForSingleObject(fp->write_complete, INFINITE);
 
 		// If we have pending data in cache, write it out.
 		if (fp->bytes_cached > 0)
@@ -384,7 +522,10 @@ FRESULT ftps_f_close(FIL *fp)
 			// Have to write out a full sector even if the remaining bytes is less to maintain
 			// zero buffering. The size if fixed below.
 			int write_len = (fp->bytes_cached + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
-			res = WriteFile(hfile, (LPVOID)fp->cache_buf[fp->cache_index], write_len, &bw, NULL) ? FR_OK : FR_INVALID_PARAMETER;
+			if (!WriteFile(hfile, (LPVOID)fp->cache_buf[fp->cache_index], write_len, &bw, NULL))
+			{
+				res = FR_INVALID_PARAMETER;
+			}
 			fp->write_total += fp->bytes_cached;
 		}
 
@@ -411,8 +552,13 @@ FRESULT ftps_f_close(FIL *fp)
 #endif
 	}
 
+	// The I/O thread that completed the last request may still be signalling io_event
+	WaitForSingleObject(io_mutex, INFINITE);
+	ReleaseMutex(io_mutex);
+
 	CloseHandle(hfile);
-	CloseHandle(fp->write_complete);
+	CloseHandle(fp->io_event);
+	cache_release(fp);
 	return res;
 }
 
@@ -430,28 +576,26 @@ FRESULT ftps_f_write(FIL *fp, struct pbuf *p, uint32_t buflen, uint32_t *written
 	assert(fp->bytes_cached <= FILE_CACHE_SIZE);
 	if (fp->bytes_cached == FILE_CACHE_SIZE)
 	{
-		// Wait for the last write to complete
-		WaitForSingleObject(fp->write_complete, INFINITE);
-
-		// Prepare the write buffer
-		async_writer_mbox_item_t *item = &async_writer_mbox[async_writer_mbox_tail];
-		async_writer_mbox_tail = (async_writer_mbox_tail + 1) % ASYNC_WRITE_MBOX_SIZE;
-		item->fp = fp;
-		item->write_buffer = fp->cache_buf[fp->cache_index];
-		item->write_len = FILE_CACHE_SIZE;
+		// Up to cache_count - 1 writes stay queued while the network fills the remaining buffer. The buffers are
+		// written in ring order, so with fewer writes than that in flight the next buffer is free.
+		io_wait(fp, fp->cache_count - 2);
+		if (fp->io_error)
+		{
+			return FR_DISK_ERR;
+		}
 
-		// Post semaphore to wake up writer thread to handle it
-		ReleaseSemaphore(async_writer_semaphore, 1, NULL);
+		// Queue this cache buffer to be written out
+		io_queue(fp, TRUE, fp->cache_buf[fp->cache_index], FILE_CACHE_SIZE, 0);
 
-		// Flip to the other cache buffer
-		fp->cache_index ^= 1;
+		// Move on to the next cache buffer
+		fp->cache_index = (fp->cache_index + 1) % fp->cache_count;
 
 		// If we have remaining bytes, put them in the now free cache buffer.
 		int remaining = buflen - len;
 		assert(remaining >= 0);
 		if (remaining > 0)
 		{
-			pbuf_copy_partial(p, &fp->cache_buf[fp->cache_index], remaining, len);
+			pbuf_copy_partial(p, fp->cache_buf[fp->cache_index], remaining, len);
 		}
 		fp->bytes_cached = remaining;
 	}
@@ -461,9 +605,22 @@ FRESULT ftps_f_write(FIL *fp, struct pbuf *p, uint32_t buflen, uint32_t *written
 
 FRESULT ftps_f_read(FIL *fp, void *buffer, uint32_t len, uint32_t *read, uint32_t position)
 {
-	HANDLE hfile = fp->h;
-	SetFilePointer(hfile, position, NULL, FILE_BEGIN);
-	return (ReadFile(hfile, (LPVOID)buffer, len, (LPDWORD)read, NULL)) ? FR_OK : FR_INVALID_PARAMETER;
+	return read_at(fp->h, buffer, len, read, position) ? FR_OK : FR_INVALID_PARAMETER;
+}
+
+// Starts reading into buffer on an I/O thread. Collect the read with ftps_f_read_wait before starting the next one or
+// using the buffer.
+FRESULT ftps_f_read_async(FIL *fp, void *buffer, uint32_t len, uint32_t position)
+{
+	io_queue(fp, FALSE, buffer, len, position);
+	return FR_OK;
+}
+
+FRESULT ftps_f_read_wait(FIL *fp, uint32_t *read)
+{
+	io_wait(fp, 0);
+	*read = fp->read_bytes;
+	return fp->io_error ? FR_DISK_ERR : FR_OK;
 }
 
 FRESULT ftps_f_mkdir(const char *path)
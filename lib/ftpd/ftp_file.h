@@ -32,16 +32,53 @@ typedef struct
 
 #define FILE_CACHE_SIZE (128 * 1024)
 
+// A cache buffer holds FILE_CACHE_SIZE bytes plus the overflow of the last received segment
+#define FILE_CACHE_BUFFER_SIZE (FILE_CACHE_SIZE + TCP_MSS)
+
+// Cache buffers an open file takes from the shared pool. Uploads fill one while the others are queued to be written,
+// so the default is what STOR uses unless the client asks for a different depth with SITE BUFFERS.
+#define FILE_CACHE_MIN 2
+#define FILE_CACHE_MAX 8
+#define FILE_CACHE_DEFAULT 4
+
+// Downloads send from one buffer while the client acknowledges the one before it and the next is read from disk
+#define FILE_CACHE_RETR 3
+
+// Requests a file can have queued with the I/O threads at once
+#define FILE_IO_QUEUE_SIZE FILE_CACHE_MAX
+
+// Threads that carry out the queued reads and writes of all connections
+#define FILE_IO_THREADS 2
+
 typedef struct
+{
+    void *buffer;
+    uint32_t len;
+    uint32_t position; // Reads only, a write continues where the previous one ended
+    BOOL write;
+} file_io_request_t;
+
+typedef struct fil_handle
 {
     HANDLE h;
     char path[_MAX_LFN];
     int cache_index;
-    char cache_buf[2][FILE_CACHE_SIZE + TCP_MSS] __attribute__((aligned(PAGE_SIZE)));
+    int cache_count;
+    char *cache_buf[FILE_CACHE_MAX]; // Page aligned, from the shared pool while the file is open
     ULONGLONG write_total;
     ULONGLONG bytes_cached;
-    HANDLE write_complete;
     BOOL opened_for_write;
+
+    // Queued I/O, see ftps_io_init
+    file_io_request_t io_queue[FILE_IO_QUEUE_SIZE];
+    uint32_t io_head;
+    uint32_t io_tail;
+    uint32_t io_completed;
+    BOOL io_scheduled;
+    BOOL io_error;
+    struct fil_handle *io_next;
+    HANDLE io_event; // Set each time a request completes
+    uint32_t read_bytes;
 } fil_handle_t;
 
 #define DIR dir_handle_t
@@ -89,15 +126,19 @@ typedef enum
 #define AM_DIR 0x10 /* Directory */
 #define AM_ARC 0x20 /* Archive */
 
+void ftps_io_init(void);
+void ftps_cache_trim(void);
 FRESULT ftps_f_stat(const char *path, FILINFO *nfo);
 FRESULT ftps_f_opendir(DIR *dp, const char *path);
 FRESULT ftps_f_readdir(DIR *dp, FILINFO *fno);
 FRESULT ftps_f_unlink(const char *path);
-FRESULT ftps_f_open(FIL *fp, const char *path, uint8_t mode);
+FRESULT ftps_f_open(FIL *fp, const char *path, uint8_t mode, int cache_count);
 size_t ftps_f_size(FIL *fp);
 FRESULT ftps_f_close(FIL *fp);
 FRESULT ftps_f_write(FIL *fp, struct pbuf *p, uint32_t buflen, uint32_t *written);
 FRESULT ftps_f_read(FIL *fp, void *buffer, uint32_t len, uint32_t *read, uint32_t position);
+FRESULT ftps_f_read_async(FIL *fp, void *buffer, uint32_t len, uint32_t position);
+FRESULT ftps_f_read_wait(FIL *fp, uint32_t *read);
 FRESULT ftps_f_mkdir(const char *path);
 FRESULT ftps_f_rename(const char *from, const char *to);
 FRESULT ftps_f_utime(const char *path, const FILINFO *fno);
@@ -0,0 +1,169 @@
+/*
+ * ftp_pool.c
+ *
+ * Pools of fixed size memory blocks shared by all FTP connections.
+ */
+
+#include "ftp.h"
+#include "ftp_pool.h"
+#include <assert.h>
+#include <windows.h>
+
+#ifdef NXDK
+#include <xboxkrnl/xboxkrnl.h>
+#endif
+
+// Size of the slabs small blocks are carved from
+#define FTP_POOL_SLAB_SIZE (16 * 1024)
+
+// Bytes held by all pools, updated atomically as each pool has its own mutex
+static size_t pool_footprint;
+
+static BOOL memory_available(size_t size)
+{
+#ifdef NXDK
+	MM_STATISTICS stats;
+	stats.Length = sizeof(stats);
+	if (!NT_SUCCESS(MmQueryStatistics(&stats)))
+	{
+		return FALSE;
+	}
+	return (uint64_t)stats.AvailablePages * PAGE_SIZE >= (uint64_t)size + FTP_POOL_MEMORY_RESERVE;
+#else
+	MEMORYSTATUSEX status;
+	status.dwLength = sizeof(status);
+	return GlobalMemoryStatusEx(&status) && status.ullAvailPhys >= (DWORDLONG)size + FTP_POOL_MEMORY_RESERVE;
+#endif
+}
+
+static void *slab_alloc(size_t size)
+{
+#ifdef NXDK
+	return MmAllocateContiguousMemoryEx(size, 0, 0xFFFFFFFF, 0, PAGE_READWRITE);
+#else
+	return VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#endif
+}
+
+static void slab_free(void *slab)
+{
+#ifdef NXDK
+	MmFreeContiguousMemory(slab);
+#else
+	VirtualFree(slab, 0, MEM_RELEASE);
+#endif
+}
+
+static void **slab_next(ftp_pool_t *pool, void *slab)
+{
+	return (void **)((char *)slab + pool->blocks_per_slab * pool->block_size);
+}
+
+// Caller holds the pool's mutex
+static BOOL pool_grow(ftp_pool_t *pool)
+{
+	if (pool->allocated >= pool->max_blocks || !memory_available(pool->slab_size))
+	{
+		return FALSE;
+	}
+
+	if (__atomic_add_fetch(&pool_footprint, pool->slab_size, __ATOMIC_RELAXED) > FTP_POOL_MEMORY_MAX)
+	{
+		__atomic_sub_fetch(&pool_footprint, pool->slab_size, __ATOMIC_RELAXED);
+		return FALSE;
+	}
+
+	char *slab = slab_alloc(pool->slab_size);
+	if (slab == NULL)
+	{
+		__atomic_sub_fetch(&pool_footprint, pool->slab_size, __ATOMIC_RELAXED);
+		return FALSE;
+	}
+
+	*slab_next(pool, slab) = pool->slabs;
+	pool->slabs = slab;
+	for (uint32_t i = 0; i < pool->blocks_per_slab; i++)
+	{
+		void *block = slab + i * pool->block_size;
+		*(void **)block = pool->free_list;
+		pool->free_list = block;
+	}
+	pool->allocated += pool->blocks_per_slab;
+	return TRUE;
+}
+
+void ftp_pool_init(ftp_pool_t *pool, size_t block_size, uint32_t max_blocks)
+{
+	// Keep every block aligned for any type, a ULONGLONG needs 8 bytes on i386 where pointers only need 4
+	block_size = (block_size + _Alignof(max_align_t) - 1) & ~(_Alignof(max_align_t) - 1);
+
+	pool->block_size = block_size;
+	pool->blocks_per_slab = (block_size > FTP_POOL_SLAB_SIZE / 2) ? 1 : (FTP_POOL_SLAB_SIZE - sizeof(void *)) / block_size;
+	if (pool->blocks_per_slab > max_blocks)
+	{
+		pool->blocks_per_slab = max_blocks;
+	}
+	pool->slab_size = (pool->blocks_per_slab * block_size + sizeof(void *) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+	pool->max_blocks = max_blocks;
+	pool->allocated = 0;
+	pool->in_use = 0;
+	pool->free_list = NULL;
+	pool->slabs = NULL;
+	pool->mutex = CreateMutex(NULL, FALSE, NULL);
+}
+
+void *ftp_pool_get(ftp_pool_t *pool)
+{
+	WaitForSingleObject(pool->mutex, INFINITE);
+
+	// Reuse a free block, the free list is linked through the first word of each block. A slab can hold more blocks
+	// than max_blocks leaves room for, those stay on the free list.
+	void *block = NULL;
+	if (pool->in_use < pool->max_blocks && (pool->free_list != NULL || pool_grow(pool)))
+	{
+		block = pool->free_list;
+		pool->free_list = *(void **)block;
+		pool->in_use++;
+	}
+
+	ReleaseMutex(pool->mutex);
+	return block;
+}
+
+void ftp_pool_put(ftp_pool_t *pool, void *block)
+{
+	if (block == NULL)
+	{
+		return;
+	}
+
+	WaitForSingleObject(pool->mutex, INFINITE);
+	assert(pool->in_use > 0);
+	pool->in_use--;
+	*(void **)block = pool->free_list;
+	pool->free_list = block;
+	ReleaseMutex(pool->mutex);
+}
+
+void ftp_pool_trim(ftp_pool_t *pool)
+{
+	WaitForSingleObject(pool->mutex, INFINITE);
+	if (pool->in_use == 0)
+	{
+		while (pool->slabs != NULL)
+		{
+			void *slab = pool->slabs;
+			pool->slabs = *slab_next(pool, slab);
+			slab_free(slab);
+			__atomic_sub_fetch(&pool_footprint, pool->slab_size, __ATOMIC_RELAXED);
+		}
+		pool->free_list = NULL;
+		pool->allocated = 0;
+	}
+	ReleaseMutex(pool->mutex);
+}
+
+size_t ftp_pool_footprint(void)
+{
+	return __atomic_load_n(&pool_footprint, __ATOMIC_RELAXED);
+}
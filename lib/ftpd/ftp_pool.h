@@ -0,0 +1,44 @@
+/*
+ * ftp_pool.h
+ *
+ * Pools of fixed size memory blocks shared by all FTP connections.
+ */
+
+#ifndef _FTP_POOL_H_
+#define _FTP_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <windows.h>
+
+// Blocks are aligned for any type and carved out of page aligned slabs of about FTP_POOL_SLAB_SIZE, a block larger
+// than half of that gets a slab of its own and so is page aligned too. Slabs are allocated from the system the first
+// time they are needed, and their blocks are kept on a free list for the next user until the pool is trimmed. A pool
+// stops growing once it has max_blocks, when all pools together would hold more than FTP_POOL_MEMORY_MAX bytes, or
+// when growing would leave less than FTP_POOL_MEMORY_RESERVE bytes free for the rest of the dashboard.
+typedef struct
+{
+	size_t block_size;
+	size_t slab_size;
+	uint32_t blocks_per_slab;
+	uint32_t max_blocks;
+	uint32_t allocated;
+	uint32_t in_use;
+	void *free_list;
+	void *slabs; // Linked through a pointer after the last block of each slab
+	HANDLE mutex;
+} ftp_pool_t;
+
+void ftp_pool_init(ftp_pool_t *pool, size_t block_size, uint32_t max_blocks);
+
+// Returns NULL if the pool can't grow any further
+void *ftp_pool_get(ftp_pool_t *pool);
+void ftp_pool_put(ftp_pool_t *pool, void *block);
+
+// Gives the slabs back to the system if none of the pool's blocks are in use
+void ftp_pool_trim(ftp_pool_t *pool);
+
+// Bytes all pools hold from the system, whether their blocks are in use or not
+size_t ftp_pool_footprint(void);
+
+#endif /* _FTP_POOL_H_ */
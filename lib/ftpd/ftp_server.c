@@ -32,6 +32,9 @@
 
 #include "lwip/opt.h"
 #include "lwip/api.h"
+#include "lwip/sys.h"
+#include "lwip/tcp.h"
+#include "lwip/tcpip.h"
 
 static const char *ftp_user_name = FTP_USER_NAME_DEFAULT;
 static const char *ftp_user_pass = FTP_USER_PASS_DEFAULT;
@@ -45,6 +48,14 @@ uint8_t ftp_eth_is_connected(void)
 	return 1;
 }
 
+// number of file transfers in progress over all connections
+static volatile uint32_t ftp_transfer_count = 0;
+
+uint32_t ftp_active_transfers(void)
+{
+	return __atomic_load_n(&ftp_transfer_count, __ATOMIC_RELAXED);
+}
+
 // =========================================================
 //
 //              Send a response to the client
@@ -405,6 +416,76 @@ static void data_con_close(ftp_data_t *ftp)
 	ftp->dataconn = NULL;
 }
 
+// request for the number of bytes queued on a connection the client hasn't acknowledged yet
+typedef struct
+{
+	struct netconn *conn;
+	uint32_t unacked;
+	sys_sem_t done;
+} unacked_query_t;
+
+// runs on the tcpip thread, the only place the pcb can be looked at safely
+static void unacked_query(void *arg)
+{
+	unacked_query_t *query = (unacked_query_t *)arg;
+	struct tcp_pcb *pcb = query->conn->pcb.tcp;
+
+	// a connection that was reset or timed out has already freed all of its segments
+	query->unacked = (pcb != NULL) ? (uint32_t)(pcb->snd_lbb - pcb->lastack) : 0;
+	sys_sem_signal(&query->done);
+}
+
+// returns 0 once at most max_unacked bytes are unacknowledged, or -1 if the client stopped acknowledging data
+static int data_con_wait_acked(unacked_query_t *query, uint32_t max_unacked)
+{
+	uint32_t delay_ms = 1;
+	uint32_t stalled_ms = 0;
+	uint32_t last_unacked = UINT32_MAX;
+	while (1)
+	{
+		// posting only fails when lwIP is out of memory for the message, so just try again later
+		if (tcpip_callback(unacked_query, query) == ERR_OK)
+		{
+			sys_arch_sem_wait(&query->done, 0);
+			if (query->unacked <= max_unacked)
+				return 0;
+
+			// any acknowledged data restarts the timeout
+			if (query->unacked < last_unacked)
+			{
+				last_unacked = query->unacked;
+				stalled_ms = 0;
+			}
+		}
+
+		if (stalled_ms >= FTP_DATA_ACK_TIMEOUT_MS)
+			return -1;
+
+		// a buffer takes a few milliseconds to drain at full speed, so back off instead of polling every tick
+		sys_msleep(delay_ms);
+		stalled_ms += delay_ms;
+		if (delay_ms < FTP_DATA_ACK_POLL_MAX_MS)
+			delay_ms *= 2;
+	}
+}
+
+// runs on the tcpip thread, aborting drops the segments still pointing into the file buffers
+static void unacked_abort(void *arg)
+{
+	unacked_query_t *query = (unacked_query_t *)arg;
+	if (query->conn->pcb.tcp != NULL)
+		tcp_abort(query->conn->pcb.tcp);
+	sys_sem_signal(&query->done);
+}
+
+// resets a connection whose client stopped acknowledging data, so the buffers it was sent from can be released
+static void data_con_abort(unacked_query_t *query)
+{
+	while (tcpip_callback(unacked_abort, query) != ERR_OK)
+		sys_msleep(1);
+	sys_arch_sem_wait(&query->done, 0);
+}
+
 // =========================================================
 //
 //                  Functions on files
@@ -881,14 +962,20 @@ static void ftp_cmd_retr(ftp_data_t *ftp)
 		return;
 	}
 
-	// can we open the file?
-	if (ftps_f_open(&ftp->file, ftp->path, FA_READ) != FR_OK)
+	// can we open the file? a download can make do with two buffers when the pool is short
+	FRESULT open_res = ftps_f_open(&ftp->file, ftp->path, FA_READ, FILE_CACHE_RETR);
+	if (open_res == FR_NOT_ENOUGH_CORE)
+		open_res = ftps_f_open(&ftp->file, ftp->path, FA_READ, FILE_CACHE_MIN);
+	if (open_res != FR_OK)
 	{
 		// go up a level again
 		path_up_a_level(ftp->path);
 
 		// send error to client
-		ftp_send(ftp, "450 Can't open %s\r\n", ftp->parameters);
+		if (open_res == FR_NOT_ENOUGH_CORE)
+			ftp_send(ftp, "451 Out of memory\r\n");
+		else
+			ftp_send(ftp, "450 Can't open %s\r\n", ftp->parameters);
 
 		// go back
 		return;
@@ -910,6 +997,9 @@ static void ftp_cmd_retr(ftp_data_t *ftp)
 		return;
 	}
 
+	// let the dashboard know a transfer is running
+	__atomic_fetch_add(&ftp_transfer_count, 1, __ATOMIC_RELAXED);
+
 	// feedback
 	FTP_CONN_DEBUG(ftp, "Sending %s\r\n", ftp->parameters);
 
@@ -925,49 +1015,86 @@ static void ftp_cmd_retr(ftp_data_t *ftp)
 	// send accept to client
 	ftp_send(ftp, "150 Connected to port %u, %lu bytes to download\r\n", ftp->data_port, ftp->finfo.fsize - restart_position);
 
-	// variables used in loop
+	// lwIP is asked how much sent data is still unacknowledged from its own thread
+	unacked_query_t query;
+	query.conn = ftp->dataconn;
+	if (sys_sem_new(&query.done, 0) != ERR_OK)
+	{
+		ftp_send(ftp, "451 Out of memory\r\n");
+		goto done;
+	}
+
+	// The file cache buffers take turns. The reader thread fills one from disk while lwIP sends the others straight
+	// out of them with NETCONN_NOCOPY, so the data isn't copied into pbufs and the disk and network are busy at the
+	// same time. lwIP keeps pointing into a buffer to retransmit from until its data is acknowledged, so a buffer is
+	// only refilled once the client acknowledged all of it. With three buffers that still leaves the one sent before
+	// in flight while the next is read, so the connection never drains.
+	const int buffer_count = ftp->file.cache_count;
 	uint32_t total_bytes_read = 0;
-	uint32_t bytes_transferred = 0;
+	uint32_t buffer_end[FILE_CACHE_MAX] = {0};
 	uint32_t bytes_read;
+	int buffer_index = 0;
+	bool aborted = false;
+	LARGE_INTEGER start_tick, end_tick, tick_frequency;
+	QueryPerformanceCounter(&start_tick);
+
+	// read ahead the first buffer
+	ftps_f_read_async(&ftp->file, ftp->file.cache_buf[0], FILE_CACHE_SIZE, restart_position);
 
 	// loop while reading is OK
 	while (1)
 	{
-		// read from file ok?
+		// collect the buffer the reader thread was filling
 		bytes_read = 0;
-		if (ftps_f_read(&ftp->file, ftp->file.cache_buf[0], FILE_CACHE_SIZE, &bytes_read, restart_position + total_bytes_read) != FR_OK)
+		char *buffer = ftp->file.cache_buf[buffer_index];
+		if (ftps_f_read_wait(&ftp->file, &bytes_read) != FR_OK)
 		{
 			ftp_send(ftp, "550 File read failure\r\n");
 			break;
 		}
-		total_bytes_read += bytes_read;
 
 		// done with file
-		if(bytes_read == 0)
+		if (bytes_read == 0)
 		{
-			ftp_send(ftp, "226 File successfully transferred\r\n");
+			QueryPerformanceCounter(&end_tick);
+			QueryPerformanceFrequency(&tick_frequency);
+			uint64_t elapsed_ms = (uint64_t)(end_tick.QuadPart - start_tick.QuadPart) * 1000 / tick_frequency.QuadPart;
+			uint64_t kb_per_second = (elapsed_ms > 0) ? (uint64_t)total_bytes_read * 1000 / 1024 / elapsed_ms : 0;
+			FTP_CONN_DEBUG(ftp, "Sent %u bytes in %u ms\r\n", total_bytes_read, (uint32_t)elapsed_ms);
+			ftp_send(ftp, "226 File successfully transferred, %lu KB/s\r\n", (uint32_t)kb_per_second);
 			break;
 		}
 
-		// write data to socket
-		bytes_transferred = 0;
-		while (bytes_transferred < bytes_read)
+		// wait until the client acknowledged everything sent from the next buffer last time round, which leaves the
+		// buffers sent since in flight, then start reading the next block into it while this one is sent
+		int next_index = (buffer_index + 1) % buffer_count;
+		if (data_con_wait_acked(&query, total_bytes_read - buffer_end[next_index]) != 0)
 		{
-			uint32_t xfer_remain = (bytes_read - bytes_transferred);
-			uint32_t xfer_len = (xfer_remain < FTP_BUF_SIZE) ? xfer_remain : FTP_BUF_SIZE;
-			err_t con_err = netconn_write(ftp->dataconn, &ftp->file.cache_buf[0][bytes_transferred], xfer_len, NETCONN_COPY);
-			if (con_err != ERR_OK)
-			{
-				ftp_send(ftp, "426 LWIP network error code %d, transfer aborted\r\n", con_err);
-				goto done;
-			}
-			bytes_transferred += xfer_len;
+			ftp_send(ftp, "426 Client stopped acknowledging data, transfer aborted\r\n");
+			aborted = true;
+			break;
+		}
+		ftps_f_read_async(&ftp->file, ftp->file.cache_buf[next_index], FILE_CACHE_SIZE,
+						  restart_position + total_bytes_read + bytes_read);
+
+		// queue the whole buffer on the socket, lwIP splits it into segments itself
+		err_t con_err = netconn_write(ftp->dataconn, buffer, bytes_read, NETCONN_NOCOPY);
+		if (con_err != ERR_OK)
+		{
+			ftp_send(ftp, "426 LWIP network error code %d, transfer aborted\r\n", con_err);
+			break;
 		}
+		total_bytes_read += bytes_read;
+		buffer_end[buffer_index] = total_bytes_read;
+		buffer_index = next_index;
 	}
-	done:
 
-	// feedback
-	FTP_CONN_DEBUG(ftp, "Sent %u bytes\r\n", bytes_transferred);
+	// the buffers can't be reused or the connection closed while lwIP still references them
+	if (aborted || data_con_wait_acked(&query, 0) != 0)
+		data_con_abort(&query);
+	sys_sem_free(&query.done);
+
+	done:
 
 	// close file
 	ftps_f_close(&ftp->file);
@@ -977,6 +1104,9 @@ static void ftp_cmd_retr(ftp_data_t *ftp)
 
 	// close data socket
 	data_con_close(ftp);
+
+	// transfer over
+	__atomic_fetch_sub(&ftp_transfer_count, 1, __ATOMIC_RELAXED);
 }
 
 static void ftp_cmd_stor(ftp_data_t *ftp)
@@ -1000,13 +1130,17 @@ static void ftp_cmd_stor(ftp_data_t *ftp)
 	}
 
 	// does the path exist?
-	if (ftps_f_open(&ftp->file, ftp->path, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+	FRESULT open_res = ftps_f_open(&ftp->file, ftp->path, FA_CREATE_ALWAYS | FA_WRITE, ftp->file_cache_count);
+	if (open_res != FR_OK)
 	{
 		// go up a level again
 		path_up_a_level(ftp->path);
 
 		// send error to client
-		ftp_send(ftp, "450 Can't open/create %s\r\n", ftp->parameters);
+		if (open_res == FR_NOT_ENOUGH_CORE)
+			ftp_send(ftp, "451 Out of memory\r\n");
+		else
+			ftp_send(ftp, "450 Can't open/create %s\r\n", ftp->parameters);
 
 		// go back
 		return;
@@ -1028,6 +1162,9 @@ static void ftp_cmd_stor(ftp_data_t *ftp)
 		return;
 	}
 
+	// let the dashboard know a transfer is running
+	__atomic_fetch_add(&ftp_transfer_count, 1, __ATOMIC_RELAXED);
+
 	// feedback
 	FTP_CONN_DEBUG(ftp, "Receiving %s\r\n", ftp->parameters);
 
@@ -1039,6 +1176,7 @@ static void ftp_cmd_stor(ftp_data_t *ftp)
 	int8_t file_err = 0;
 	int8_t con_err = 0;
 	uint32_t bytes_written = 0;
+	bool replied = false;
 	while (1)
 	{
 		// receive data from ftp client ok?
@@ -1054,6 +1192,7 @@ static void ftp_cmd_stor(ftp_data_t *ftp)
 		if (con_err != ERR_OK && con_err != ERR_CLSD)
 		{
 			ftp_send(ftp, "426 Error during file transfer: %d\r\n", con_err);
+			replied = true;
 			break;
 		}
 
@@ -1065,15 +1204,17 @@ static void ftp_cmd_stor(ftp_data_t *ftp)
 		if (file_err != FR_OK)
 		{
 			ftp_send(ftp, "451 Communication error during transfer\r\n");
+			replied = true;
 			break;
 		}
 	}
 
-	// close file
+	// close file, a write error the loop already replied to is reported again here
 	file_err = ftps_f_close(&ftp->file);
-	if (file_err != FR_OK)
+	if (file_err != FR_OK && !replied)
 	{
 		ftp_send(ftp, "451 Communication error during transfer\r\n");
+		replied = true;
 	}
 
 	// feedback
@@ -1085,8 +1226,11 @@ static void ftp_cmd_stor(ftp_data_t *ftp)
 	// close data connection
 	data_con_close(ftp);
 
+	// transfer over
+	__atomic_fetch_sub(&ftp_transfer_count, 1, __ATOMIC_RELAXED);
+
 	// all was good
-	if (file_err == FR_OK)
+	if (!replied)
 	{
 		ftp_send(ftp, "226 File successfully transferred\r\n");
 	}
@@ -1389,7 +1533,6 @@ static void ftp_cmd_size(ftp_data_t *ftp)
 	else
 	{
 		ftp_send(ftp, "213 %lu\r\n", ftp->finfo.fsize);
-		ftps_f_close(&ftp->file);
 	}
 
 	// go up a level again
@@ -1402,6 +1545,20 @@ static void ftp_cmd_site(ftp_data_t *ftp)
 	if (!FTP_IS_LOGGED_IN(ftp))
 		return;
 
+	// SITE BUFFERS <n> sets how many cache buffers uploads on this connection use
+	if (!strncmp(ftp->parameters, "BUFFERS ", 8))
+	{
+		int count = atoi(ftp->parameters + 8);
+		if (count < FILE_CACHE_MIN || count > FILE_CACHE_MAX)
+		{
+			ftp_send(ftp, "501 Buffer count must be between %d and %d\r\n", FILE_CACHE_MIN, FILE_CACHE_MAX);
+			return;
+		}
+		ftp->file_cache_count = count;
+		ftp_send(ftp, "200 Uploads use up to %d buffers of %d KB\r\n", count, FILE_CACHE_SIZE / 1024);
+		return;
+	}
+
 	ftp_send(ftp, "550 Unknown SITE command %s\r\n", ftp->parameters);
 	/*
 	if (!strcmp(ftp->parameters, "FREE"))
@@ -1425,7 +1582,8 @@ static void ftp_cmd_stat(ftp_data_t *ftp)
 		return;
 
 	// print status
-	ftp_send(ftp, "221 FTP Server status: you will be disconnected after %d minutes of inactivity\r\n", FTP_TIME_OUT_S / 60);
+	ftp_send(ftp, "221 FTP Server status: you will be disconnected after %d minutes of inactivity, buffers hold %u KB\r\n",
+			 FTP_TIME_OUT_S / 60, (unsigned int)(ftp_memory_footprint() / 1024));
 }
 
 static void ftp_cmd_auth(ftp_data_t *ftp)
@@ -1585,6 +1743,7 @@ void ftp_service(struct netconn *ctrlcn, ftp_data_t *ftp)
 	ftp->data_port = 0;
 	ftp->data_conn_mode = DCM_NOT_SET;
 	ftp->user = FTP_USER_NONE;
+	ftp->file_cache_count = FILE_CACHE_DEFAULT;
 
 	// bugfix which works around ports which are already in use (from a previous connection)
 	ftp->data_port_incremented = (ftp->data_port_incremented + 1) % PORT_INCREMENT_OFFSET;
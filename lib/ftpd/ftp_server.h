@@ -76,7 +76,7 @@ typedef struct {
 	uint8_t data_port_incremented;
 
 	// file variables, not created on stack but static on boot
-	// to avoid overflow and ensure alignment in memory
+	// to avoid overflow, the cache buffers come from a shared pool
 	FIL file;
 	FILINFO finfo;
 	char lfn[_MAX_LFN + 1];
@@ -104,6 +104,9 @@ typedef struct {
 
 	// file restart position
 	uint32_t file_restart_pos;
+
+	// cache buffers STOR opens the file with, set with SITE BUFFERS
+	int file_cache_count;
 } ftp_data_t;
 
 // structure for ftp commands
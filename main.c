@@ -17,6 +17,7 @@
 
 #include "main.h"
 #include "support_renderer.h"
+#include "support_startup.h"
 
 #ifndef GIT_VERSION
 #define GIT_VERSION ""
@@ -40,34 +41,31 @@
 #define STB_TRUETYPE_IMPLEMENTATION
 #include <stb/stb_truetype.h>
 
-#define STB_IMAGE_IMPLEMENTATION
-#define STBI_NO_SIMD
-#define __MSC_VER _MSC_VER
-#undef _MSC_VER
-#include <stb/stb_image.h>
-#define _MSC_VER __MSC_VER
-
-static void render_menu(void);
 static void cleanup(void);
 
 static xgu_texture_t *background_texture;
-static const xgu_texture_tint_t highlight_color = {16, 124, 16, 255};
-static const xgu_texture_tint_t text_color = {255, 255, 255, 255};
-static const xgu_texture_tint_t header_color = {100, 100, 100, 255};
-static const xgu_texture_tint_t info_color = {128, 128, 128, 255};
+
+// The background and header text never change apart from the background scroll, so they are recorded once
+#define CHROME_LIST_MAX_QUADS 16
+#define CHROME_BACKGROUND_QUAD 0
+static renderer_list_t *chrome_list;
+
+// The background scroll animation needs every frame redrawn, it can be toggled off to leave the CPU idle
+static bool background_scroll = true;
 
 static Font body_font;
 static Font header_font;
+#ifdef SDF_FONTS
+// Distance field atlases for each typeface, body_font and header_font are scaled copies that share them
+static Font body_sdf_font;
+static Font header_sdf_font;
+#endif
 
 static SDL_GameController *controller = NULL;
 
 static Menu *menu_stack[64];
 static int menu_stack_top = -1;
 
-// If we are updating visible text from a different thread, use this mutex to synchronise access
-// to the text rendering functions.
-HANDLE text_render_mutex;
-
 void _putc(int c, void *ctx)
 {
     (void)ctx;
@@ -85,15 +83,118 @@ static const unsigned char UbuntuMono_Regular[] = {
 #embed "assets/UbuntuMono-Regular.ttf"
 };
 
-static const unsigned char background_png[] = {
-#embed "assets/background.png"
+// Font atlases pre-baked at build time by tools/font_baker, from the ranges add_baked_font is given in CMakeLists.txt.
+// An atlas baked from other ranges is rejected by text_create_baked and the font is packed at boot instead.
+static const int body_font_ranges[][2] = {{32, 127}};
+static const int body_font_range_count = sizeof(body_font_ranges) / sizeof(body_font_ranges[0]);
+static const int header_font_ranges[][2] = {{32, 127}};
+static const int header_font_range_count = sizeof(header_font_ranges) / sizeof(header_font_ranges[0]);
+
+static const unsigned char RobotoMono_Regular_atlas[] = {
+#embed "RobotoMono-Regular-26.bin"
 };
 
-int main(void)
+static const unsigned char UbuntuMono_Regular_atlas[] = {
+#embed "UbuntuMono-Regular-48.bin"
+};
+
+// Background texture encoded at build time by tools/texture_encoder
+static const unsigned char background_asset[] = {
+#embed "background.bin"
+};
+
+static void startup_sdl(void)
+{
+    SDL_Init(SDL_INIT_GAMECONTROLLER);
+}
+
+static void startup_body_font(void)
+{
+    int result;
+#ifdef SDF_FONTS
+    // One distance field atlas per typeface, any font size can then be drawn from it
+    result = text_create_sdf(RobotoMono_Regular, body_font_ranges, body_font_range_count, &body_sdf_font);
+    assert(result == 0);
+    result = text_create_sdf_scaled(&body_sdf_font, BODY_FONT_SIZE, &body_font);
+#else
+    // Create font texture for body text. Use the pre-baked atlas if it matches, otherwise pack it now
+    result = text_create_baked(RobotoMono_Regular_atlas, sizeof(RobotoMono_Regular_atlas), RobotoMono_Regular, BODY_FONT_SIZE,
+                               body_font_ranges, body_font_range_count, &body_font);
+    if (result != 0) {
+        result = text_create(RobotoMono_Regular, BODY_FONT_SIZE, body_font_ranges, body_font_range_count, &body_font);
+    }
+#endif
+    assert(result == 0);
+}
+
+static void startup_header_font(void)
 {
     int result;
+#ifdef SDF_FONTS
+    result = text_create_sdf(UbuntuMono_Regular, header_font_ranges, header_font_range_count, &header_sdf_font);
+    assert(result == 0);
+    result = text_create_sdf_scaled(&header_sdf_font, HEADER_FONT_SIZE, &header_font);
+#else
+    // Create font texture for header text
+    result = text_create_baked(UbuntuMono_Regular_atlas, sizeof(UbuntuMono_Regular_atlas), UbuntuMono_Regular, HEADER_FONT_SIZE,
+                               header_font_ranges, header_font_range_count, &header_font);
+    if (result != 0) {
+        result = text_create(UbuntuMono_Regular, HEADER_FONT_SIZE, header_font_ranges, header_font_range_count, &header_font);
+    }
+#endif
+    assert(result == 0);
+}
+
+static void startup_background(void)
+{
+    background_texture = texture_create_from_asset(background_asset, sizeof(background_asset));
+    assert(background_texture != NULL);
+}
+
+static void startup_chrome(void)
+{
+    const xgu_texture_boundary_t background_boundary = {0, 640, 0, 480};
+    chrome_list = renderer_list_create(CHROME_LIST_MAX_QUADS);
+    assert(chrome_list != NULL);
+    renderer_list_begin(chrome_list);
+    renderer_draw_textured_rectangle(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, background_texture, NULL, &background_boundary);
+    text_draw(&header_font, "xemu", X_MARGIN, HEADER_Y, &highlight_color);
+    renderer_list_end();
+}
+
+enum
+{
+    STARTUP_SDL,
+    STARTUP_BODY_FONT,
+    STARTUP_HEADER_FONT,
+    STARTUP_BACKGROUND,
+    STARTUP_RENDERER,
+    STARTUP_CHROME,
+    STARTUP_TASK_COUNT
+};
+
+// SDL and the renderer are brought up on the main thread, which goes on to use them
+static startup_task_t startup_tasks[STARTUP_TASK_COUNT] = {
+    [STARTUP_SDL] = {.name = "sdl", .run = startup_sdl, .main_thread = true},
+    [STARTUP_BODY_FONT] = {.name = "body_font", .run = startup_body_font},
+    [STARTUP_HEADER_FONT] = {.name = "header_font", .run = startup_header_font},
+    [STARTUP_BACKGROUND] = {.name = "background", .run = startup_background},
+    [STARTUP_RENDERER] = {.name = "renderer", .run = renderer_initialise, .main_thread = true},
+    [STARTUP_CHROME] = {.name = "chrome",
+                        .run = startup_chrome,
+                        .main_thread = true,
+                        .dependency = {&startup_tasks[STARTUP_HEADER_FONT], &startup_tasks[STARTUP_BACKGROUND],
+                                       &startup_tasks[STARTUP_RENDERER]}},
+};
+
+int main(void)
+{
     XVideoSetMode(WINDOW_WIDTH, WINDOW_HEIGHT, 32, REFRESH_DEFAULT);
 
+    profiler_initialise();
+    pacing_initialise();
+    const uint64_t boot_start = profiler_timestamp();
+
     nxUnmountDrive('D');
     nxMountDrive('D', "\\Device\\CdRom0");
     nxMountDrive('C', "\\Device\\Harddisk0\\Partition2\\");
@@ -114,33 +215,14 @@ int main(void)
     network_initialise();
     autolaunch_dvd_runner();
 
-    SDL_Init(SDL_INIT_GAMECONTROLLER);
-
     // Pseudo-random number generator seed
     LARGE_INTEGER seed;
     KeQuerySystemTime(&seed);
     srand(seed.LowPart);
 
-    // Create font texture for body text
-    result = text_create(RobotoMono_Regular, BODY_FONT_SIZE, (const int[][2]){{32, 127}}, 1, &body_font);
-    assert(result == 0);
-
-    // Create font texture for header text
-    result = text_create(UbuntuMono_Regular, HEADER_FONT_SIZE, (const int[][2]){{32, 127}}, 1, &header_font);
-    assert(result == 0);
-
-    // Create background texture
-    int width, height, channels;
-    unsigned char *background_data = stbi_load_from_memory((const unsigned char *)background_png,
-                                                           sizeof(background_png), &width, &height, &channels, 4);
-    assert(background_data != NULL);
-    background_texture = texture_create(background_data, width, height, XGU_TEXTURE_FORMAT_A8B8G8R8);
-    stbi_image_free(background_data);
-
-    // Text updates can come from worker threads so we protect the rending of the text by a mutex
-    text_render_mutex = CreateMutex(NULL, FALSE, NULL);
-
-    renderer_initialise();
+    // Fonts and the background texture are independent of each other and of the renderer, so they are built on
+    // worker threads while the main thread brings up the renderer
+    startup_tasks_run(startup_tasks, STARTUP_TASK_COUNT);
 
     // Main menu always exists
     main_menu_activate();
@@ -173,11 +255,53 @@ int main(void)
         menu_push(&menu_warning);
     }
 
+    startup_tasks_log(startup_tasks, STARTUP_TASK_COUNT);
+    printf("Startup took %u ms\n", (uint32_t)(profiler_elapsed_us(boot_start) / 1000));
+    bool first_frame = true;
+
+    // State the last drawn frame was built from. The screen is only redrawn when some of it changes
+    bool redraw_pending = true;
+    WORD drawn_second = 0;
+    const char *drawn_tray_status = NULL;
+    char drawn_network_status[32] = "";
+    uint32_t drawn_layout_generation = 0;
+
     // Main running loop
     bool running = true;
     SDL_Event e;
     while (running) {
-        while (SDL_PollEvent(&e)) {
+        SYSTEMTIME systemtime;
+        GetLocalTime(&systemtime);
+        const char *tray_status = dvd_get_tray_status();
+        char network_status[32];
+        network_get_status(network_status, sizeof(network_status));
+        uint32_t layout_generation = text_layouts_generation();
+
+        bool damaged = redraw_pending || background_scroll;
+        damaged |= profiler_overlay_visible(); // Its statistics change every frame
+        damaged |= systemtime.wSecond != drawn_second;
+        damaged |= tray_status != drawn_tray_status;
+        damaged |= strcmp(network_status, drawn_network_status) != 0;
+        damaged |= layout_generation != drawn_layout_generation;
+
+        // With nothing to redraw, sleep until input arrives or it is time to check the state again
+        int have_event;
+        if (damaged) {
+            have_event = SDL_PollEvent(&e);
+        } else {
+            have_event = SDL_WaitEventTimeout(&e, IDLE_WAIT_MS);
+        }
+
+        if (!damaged && !have_event) {
+            profiler_frame_skipped();
+            continue;
+        }
+
+        profiler_frame_begin();
+        const float delta_time = pacing_frame_begin();
+
+        profiler_begin(PROFILER_STAGE_INPUT);
+        while (have_event) {
             if (e.type == SDL_QUIT) {
                 running = false;
             } else if (e.type == SDL_CONTROLLERDEVICEADDED) {
@@ -191,15 +315,16 @@ int main(void)
                     controller = NULL;
                 }
             } else if (e.type == SDL_CONTROLLERBUTTONDOWN) {
+                pacing_activity();
                 Menu *current_menu = menu_peak();
                 assert(current_menu != NULL);
                 if (e.cbutton.button == SDL_CONTROLLER_BUTTON_DPAD_DOWN) {
                     current_menu->selected_index = (current_menu->selected_index + 1) % current_menu->item_count;
 
                     // Skip if not a selectable item on the way down
-                    while (current_menu->item[current_menu->selected_index].callback == NULL) {
+                    while (menu_get_item(current_menu, current_menu->selected_index)->callback == NULL) {
                         current_menu->selected_index = (current_menu->selected_index + 1) % current_menu->item_count;
-                        if (current_menu->item[current_menu->selected_index].callback != NULL) {
+                        if (menu_get_item(current_menu, current_menu->selected_index)->callback != NULL) {
                             break;
                         }
                         if (current_menu->selected_index == 0) {
@@ -211,9 +336,9 @@ int main(void)
                     current_menu->selected_index = (current_menu->selected_index - 1 + current_menu->item_count) % current_menu->item_count;
 
                     // Skip if not a selectable item on the way up
-                    while (current_menu->item[current_menu->selected_index].callback == NULL) {
+                    while (menu_get_item(current_menu, current_menu->selected_index)->callback == NULL) {
                         current_menu->selected_index = (current_menu->selected_index - 1 + current_menu->item_count) % current_menu->item_count;
-                        if (current_menu->item[current_menu->selected_index].callback != NULL) {
+                        if (menu_get_item(current_menu, current_menu->selected_index)->callback != NULL) {
                             break;
                         }
                         if (current_menu->selected_index == 0) {
@@ -222,8 +347,8 @@ int main(void)
                         }
                     }
                 } else if (e.cbutton.button == SDL_CONTROLLER_BUTTON_A || e.cbutton.button == SDL_CONTROLLER_BUTTON_START) {
-                    if (current_menu->item[current_menu->selected_index].callback) {
-                        current_menu->item[current_menu->selected_index].callback();
+                    if (menu_get_item(current_menu, current_menu->selected_index)->callback) {
+                        menu_get_item(current_menu, current_menu->selected_index)->callback();
                     }
                 } else if (e.cbutton.button == SDL_CONTROLLER_BUTTON_B || e.cbutton.button == SDL_CONTROLLER_BUTTON_BACK) {
                     if (menu_stack_top > 0) {
@@ -232,55 +357,91 @@ int main(void)
                             popped_menu->close_callback();
                         }
                     }
+                } else if (e.cbutton.button == SDL_CONTROLLER_BUTTON_LEFTSTICK) {
+                    background_scroll = !background_scroll;
+                } else if (e.cbutton.button == SDL_CONTROLLER_BUTTON_RIGHTSTICK) {
+                    profiler_toggle_overlay();
+                } else if (e.cbutton.button == SDL_CONTROLLER_BUTTON_Y) {
+                    pacing_set_mode((pacing_get_mode() + 1) % PACING_MODE_COUNT);
+                    printf("Frame pacing: %s\n", pacing_mode_name(pacing_get_mode()));
                 }
             } else if (e.type == DVD_LAUNCH_EVENT) {
                 cleanup();
                 XLaunchXBE("\\Device\\CdRom0\\default.xbe");
             }
+            have_event = SDL_PollEvent(&e);
         }
+        profiler_end(PROFILER_STAGE_INPUT);
 
         // Prepare the renderer
         renderer_start();
 
-        // Render the background
+        profiler_begin(PROFILER_STAGE_BACKGROUND);
+
+        // Render the background and header text, only the background scroll offset needs updating. It moves by the
+        // time since the last frame so the speed is the same at any refresh or pacing rate
         static float x_offset = 0;
-        xgu_texture_boundary_t boundary = {
-            0 + x_offset, 640 + x_offset, 0, 480};
-        x_offset += 0.25f;
-        if (x_offset > 127) {
-            x_offset = 0;
+        if (background_scroll) {
+            x_offset += BACKGROUND_SCROLL_SPEED * delta_time;
+            if (x_offset > 127) {
+                x_offset = 0;
+            }
+            xgu_texture_boundary_t boundary = {
+                0 + x_offset, 640 + x_offset, 0, 480};
+            renderer_list_set_boundary(chrome_list, CHROME_BACKGROUND_QUAD, &boundary);
         }
-        renderer_draw_textured_rectangle(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, background_texture, NULL, &boundary);
-
-        // Render the header text
-        text_draw(&header_font, "xemu", X_MARGIN, HEADER_Y, &highlight_color);
+        renderer_list_draw(chrome_list);
+        profiler_end(PROFILER_STAGE_BACKGROUND);
 
+        profiler_begin(PROFILER_STAGE_HEADER);
         char menu_text_buffer[64];
 
         // Render the Xbox system local time
-        SYSTEMTIME systemtime;
-        GetLocalTime(&systemtime);
         snprintf(menu_text_buffer, sizeof(menu_text_buffer), "%04d-%02d-%02d %02d:%02d:%02d", systemtime.wYear, systemtime.wMonth, systemtime.wDay,
                  systemtime.wHour, systemtime.wMinute, systemtime.wSecond);
         text_draw(&body_font, menu_text_buffer, WINDOW_WIDTH - X_MARGIN - text_calculate_width(&body_font, menu_text_buffer),
                   Y_MARGIN + BODY_FONT_SIZE, &info_color);
+        profiler_end(PROFILER_STAGE_HEADER);
 
         // Render footer text
-        snprintf(menu_text_buffer, sizeof(menu_text_buffer), "Tray State: %s", dvd_get_tray_status());
+        profiler_begin(PROFILER_STAGE_FOOTER);
+        snprintf(menu_text_buffer, sizeof(menu_text_buffer), "Tray State: %s", tray_status);
         text_draw(&body_font, menu_text_buffer, WINDOW_WIDTH - X_MARGIN - text_calculate_width(&body_font, menu_text_buffer),
                   FOOTER_Y, &text_color);
 
-        char network_status[32];
-        network_get_status(network_status, sizeof(network_status));
         snprintf(menu_text_buffer, sizeof(menu_text_buffer), "FTP Server - %s", network_status);
         text_draw(&body_font, menu_text_buffer, WINDOW_WIDTH - X_MARGIN - text_calculate_width(&body_font, menu_text_buffer),
                   FOOTER_Y + BODY_FONT_SIZE, &text_color);
+        profiler_end(PROFILER_STAGE_FOOTER);
 
         // Render the actual menu items
-        render_menu();
+        profiler_begin(PROFILER_STAGE_MENU);
+        redraw_pending = menu_render(menu_peak(), &body_font, delta_time);
+        if (redraw_pending) {
+            pacing_activity();
+        }
+        profiler_end(PROFILER_STAGE_MENU);
+
+        if (profiler_overlay_visible()) {
+            profiler_begin(PROFILER_STAGE_OVERLAY);
+            profiler_draw_overlay(&body_font, X_MARGIN, Y_MARGIN);
+            profiler_end(PROFILER_STAGE_OVERLAY);
+        }
 
         // Show me
         renderer_present();
+        profiler_frame_end();
+        pacing_frame_end();
+
+        if (first_frame) {
+            printf("First frame presented %u ms after boot\n", (uint32_t)(profiler_elapsed_us(boot_start) / 1000));
+            first_frame = false;
+        }
+
+        drawn_second = systemtime.wSecond;
+        drawn_tray_status = tray_status;
+        strcpy(drawn_network_status, network_status);
+        drawn_layout_generation = layout_generation;
     }
 
     cleanup();
@@ -315,48 +476,34 @@ Menu *menu_peak(void)
     return current_menu;
 }
 
-static void render_menu(void)
+// Only one thread may publish to a label at a time
+void menu_label_publish(MenuLabel *label, const char *text, void (*callback)(void))
 {
-    Menu *current_menu = menu_peak();
-    assert(current_menu != NULL);
-
-    // The first line of each menu is reserved for the menu title
-    text_draw(&body_font, current_menu->item[0].label, X_MARGIN, MENU_Y, &header_color);
-
-    renderer_set_scissor(0, MENU_Y + ITEM_PADDING, WINDOW_WIDTH, FOOTER_Y - (int)BODY_FONT_SIZE - MENU_Y);
-
-    const int selected_y_bottom = MENU_Y + current_menu->selected_index * (int)body_font.line_height +
-                                  current_menu->scroll_offset + ITEM_PADDING;
-    const int selected_y_top = selected_y_bottom - (int)body_font.line_height;
-
-    // Start at the bottom of the first menu item
-    int y = MENU_Y + (int)body_font.line_height;
-
-    // Scroll the selected item to be in view
-    if (selected_y_top < MENU_Y + ITEM_PADDING) {
-        current_menu->scroll_offset += (MENU_Y + ITEM_PADDING - selected_y_top + 3) >> 2;
-    } else if (selected_y_bottom > FOOTER_Y - (int)BODY_FONT_SIZE) {
-        current_menu->scroll_offset -= (selected_y_bottom - (FOOTER_Y - (int)BODY_FONT_SIZE) + 3) >> 2;
-    }
-
-    for (int i = 1; i < current_menu->item_count; ++i) {
-        xgu_texture_tint_t color;
-        if (current_menu->item[i].callback == NULL) {
-            color = info_color;
-        } else if (i == current_menu->selected_index) {
-            color = highlight_color;
-        } else {
-            color = text_color;
-        }
-
-        WaitForSingleObject(text_render_mutex, INFINITE);
-        text_draw(&body_font, current_menu->item[i].label, X_MARGIN,
-                  y + current_menu->scroll_offset, &color);
-        ReleaseMutex(text_render_mutex);
-        y += body_font.line_height;
-    }
+    const uint32_t sequence = label->sequence + 1;
+    char *buffer = label->text[sequence & 1];
+    strncpy(buffer, text, MENU_LABEL_SIZE - 1);
+    buffer[MENU_LABEL_SIZE - 1] = '\0';
+    label->callback[sequence & 1] = callback;
+    __atomic_store_n(&label->sequence, sequence, __ATOMIC_RELEASE);
+
+    // Lets the render loop know the screen is stale
+    text_invalidate_layouts();
+}
 
-    renderer_set_scissor(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+// Copies the published text and callback into item, with text as its label. The copy is retried if the label was
+// published again meanwhile, as the buffer being copied could have been rewritten.
+void menu_label_read(const MenuLabel *label, char text[MENU_LABEL_SIZE], MenuItem *item)
+{
+    uint32_t sequence;
+    do {
+        sequence = __atomic_load_n(&label->sequence, __ATOMIC_ACQUIRE);
+        memcpy(text, label->text[sequence & 1], MENU_LABEL_SIZE);
+        item->callback = label->callback[sequence & 1];
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&label->sequence, __ATOMIC_RELAXED) != sequence);
+
+    text[MENU_LABEL_SIZE - 1] = '\0';
+    item->label = text;
 }
 
 void usbh_core_deinit();
@@ -366,12 +513,32 @@ static void cleanup(void)
     if (controller) {
         SDL_GameControllerClose(controller);
     }
+#ifdef SDF_FONTS
+    // The scaled fonts don't own their atlas
+    body_font.texture = body_sdf_font.texture;
+    header_font.texture = header_sdf_font.texture;
+    if (body_sdf_font.dynamic_texture) {
+        texture_destroy(body_sdf_font.dynamic_texture);
+    }
+    if (header_sdf_font.dynamic_texture) {
+        texture_destroy(header_sdf_font.dynamic_texture);
+    }
+#endif
     if (body_font.texture) {
         texture_destroy(body_font.texture);
     }
     if (header_font.texture) {
         texture_destroy(header_font.texture);
     }
+    if (body_font.dynamic_texture) {
+        texture_destroy(body_font.dynamic_texture);
+    }
+    if (header_font.dynamic_texture) {
+        texture_destroy(header_font.dynamic_texture);
+    }
+    if (chrome_list) {
+        renderer_list_destroy(chrome_list);
+    }
     if (background_texture) {
         texture_destroy(background_texture);
     }
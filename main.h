@@ -6,20 +6,36 @@
 #include <stb/stb_truetype.h>
 #include <windows.h>
 
+#include "support_pacing.h"
+#include "support_profiler.h"
 #include "support_renderer.h"
 
-#define WINDOW_WIDTH       640
-#define WINDOW_HEIGHT      480
-#define BODY_FONT_SIZE     26.0f
-#define HEADER_FONT_SIZE   48.0f
-#define ITEM_PADDING       10
-#define Y_MARGIN           20
-#define X_MARGIN           20
-#define FONT_BITMAP_WIDTH  128
-#define FONT_BITMAP_HEIGHT 512
-#define HEADER_Y           (Y_MARGIN + (int)HEADER_FONT_SIZE)
-#define MENU_Y             (HEADER_Y + (int)BODY_FONT_SIZE + ITEM_PADDING)
-#define FOOTER_Y           (WINDOW_HEIGHT - Y_MARGIN - (int)BODY_FONT_SIZE)
+#define WINDOW_WIDTH            640
+#define WINDOW_HEIGHT           480
+#define BODY_FONT_SIZE          26.0f
+#define HEADER_FONT_SIZE        48.0f
+#define ITEM_PADDING            10
+#define Y_MARGIN                20
+#define X_MARGIN                20
+#define FONT_BITMAP_WIDTH       128
+#define FONT_BITMAP_HEIGHT      512
+#define HEADER_Y                (Y_MARGIN + (int)HEADER_FONT_SIZE)
+#define MENU_Y                  (HEADER_Y + (int)BODY_FONT_SIZE + ITEM_PADDING)
+#define FOOTER_Y                (WINDOW_HEIGHT - Y_MARGIN - (int)BODY_FONT_SIZE)
+#define IDLE_WAIT_MS            50    // How long the main loop sleeps waiting for input when nothing needs redrawing
+#define BACKGROUND_SCROLL_SPEED 15.0f // Pixels per second
+#define MENU_SCROLL_REMAINING   0.75f // Fraction of the way to the selected item still to scroll after 1/60 s
+#define MENU_LABEL_SIZE         128
+
+#define FONT_ADVANCE_CACHE_SIZE 64 // Must be a power of two
+#define FONT_GLYPH_PAGE_SIZE    256
+#define FONT_GLYPH_PAGE_COUNT   (0x10000 / FONT_GLYPH_PAGE_SIZE) // Covers the Basic Multilingual Plane
+#define FONT_GLYPH_NONE         0xFFFF
+#define FONT_GLYPH_SCAN_RANGES  2 // Fonts with up to this many ranges find glyphs by scanning them, not the page table
+#define FONT_DYNAMIC_ATLAS_SIZE 256
+#define FONT_SDF_SIZE           32.0f // Pixel height distance field atlases are rendered at, any size can be drawn from it
+#define FONT_SDF_PADDING        4     // Pixels of distance kept around each glyph outline
+#define FONT_SDF_ONEDGE         128   // Alpha value on the glyph outline
 
 void _putc(int c, void *ctx);
 
@@ -50,8 +66,33 @@ typedef struct
     int selected_index;
     int scroll_offset;
     void (*close_callback)(void);
+    // Optional, supplies items on demand instead of the item array so long lists don't have to be built up front.
+    // Only rows on screen are requested, and the returned item only needs to stay valid until the next call.
+    const MenuItem *(*get_item)(int index);
 } Menu;
 
+// A label that can be rewritten from a worker thread while the menu is drawn. The writer fills the buffer readers
+// aren't using and then bumps the sequence to publish it, so neither side ever blocks the other.
+typedef struct
+{
+    char text[2][MENU_LABEL_SIZE];
+    void (*callback[2])(void);
+    uint32_t sequence; // The low bit picks the published buffer
+} MenuLabel;
+
+typedef struct font_advance_cache_entry
+{
+    int codepoint;
+    int advance;
+} FontAdvanceCacheEntry;
+
+typedef struct font_dynamic_glyph
+{
+    int codepoint; // -1 if the slot is free
+    uint32_t last_used_frame;
+    stbtt_packedchar packed_char;
+} FontDynamicGlyph;
+
 typedef struct font
 {
     stbtt_fontinfo font_info;
@@ -60,12 +101,41 @@ typedef struct font
     int range_count;
     float line_height;
     float scale;
+
+    // Packed glyph data and unscaled advance widths for every packed codepoint, indexed in range order
+    stbtt_packedchar *packed_chars;
+    int *advance;
+    int packed_count;
+    int fallback_index;
+
+    // Two level lookup from a BMP codepoint to its packed glyph index, only built for fonts with more than
+    // FONT_GLYPH_SCAN_RANGES ranges. Pages without any packed codepoints are left NULL
+    uint16_t *glyph_page[FONT_GLYPH_PAGE_COUNT];
+    // Advance widths for codepoints outside of the packed ranges, filled on first use
+    FontAdvanceCacheEntry advance_cache[FONT_ADVANCE_CACHE_SIZE];
+
+    // Codepoints outside of the packed ranges are rasterised on first use into a grid of equally sized
+    // slots in a separate texture. When all slots are taken the least recently used glyph is evicted.
+    // The texture is only created once the first such codepoint is drawn.
+    xgu_texture_t *dynamic_texture;
+    FontDynamicGlyph *dynamic_glyph;
+    int dynamic_glyph_count;
+    int dynamic_slot_size;
+    uint32_t dynamic_generation;
 } Font;
 
-extern HANDLE text_render_mutex;
+extern const xgu_texture_tint_t highlight_color;
+extern const xgu_texture_tint_t text_color;
+extern const xgu_texture_tint_t header_color;
+extern const xgu_texture_tint_t info_color;
 
 void menu_push(Menu *menu);
 Menu *menu_peak(void);
+const MenuItem *menu_get_item(const Menu *menu, int index);
+int menu_scroll_step(int distance, float delta_time);
+bool menu_render(Menu *menu, Font *font, float delta_time);
+void menu_label_publish(MenuLabel *label, const char *text, void (*callback)(void));
+void menu_label_read(const MenuLabel *label, char text[MENU_LABEL_SIZE], MenuItem *item);
 Menu *menu_pop(void);
 
 void network_initialise(void);
@@ -82,5 +152,11 @@ const char *dvd_get_tray_status();
 void main_menu_activate(void);
 
 int text_create(const unsigned char *ttf_data, float font_size, const int(*range)[2], int range_count, Font *font);
+int text_create_baked(const unsigned char *atlas_data, size_t atlas_size, const unsigned char *ttf_data, float font_size, const int(*range)[2], int range_count, Font *font);
+int text_create_sdf(const unsigned char *ttf_data, const int(*range)[2], int range_count, Font *font);
+int text_create_sdf_scaled(const Font *sdf_font, float font_size, Font *font);
 void text_draw(Font *font, const char *text, int x, int y, const xgu_texture_tint_t *tint);
+void text_draw_cached(Font *font, const char *text, int x, int y, const xgu_texture_tint_t *tint);
+void text_invalidate_layouts(void);
+uint32_t text_layouts_generation(void);
 int text_calculate_width(Font *font, const char *text);
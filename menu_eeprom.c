@@ -439,6 +439,9 @@ static void update_eeprom_text(void)
     push_line(line++, generate_serial_number, "Serial Number: %12s", eeprom.factory.serial_number);
 
     menu.item_count = line;
+
+    // The labels were rewritten in place so any cached layouts are stale
+    text_invalidate_layouts();
 }
 
 void menu_eeprom_activate(void)
@@ -45,12 +45,18 @@ static char *default_online_install_text = "Check online for latest file?";
 #define OFFLINE_INSTALL_LINE 3
 #define ONLINE_INSTALL_LINE  4
 
+// The online install line shows the downloader thread's status, so it is published to the render loop
+static MenuLabel online_install_label;
+static const MenuItem *get_install_item(int index);
+static HANDLE downloader_thread_handle = NULL;
+static HANDLE downloader_semaphore = NULL;
+
 static MenuItem menu_items[] = {
     {"Dashboard Installer (This will replace xboxdash.xbe)", NULL},
     {"Running version: " GIT_VERSION, NULL},
     {"Restore backup", restore_backup},
     {"Install running file?", install_dashboard_from_local},
-    {"Check online for latest file?", install_dashboard_from_online},
+    {NULL, NULL}, // Supplied from online_install_label
     {"Cancel", cancel}};
 
 static Menu menu = {
@@ -58,12 +64,29 @@ static Menu menu = {
     .item_count = sizeof(menu_items) / sizeof(MenuItem),
     .selected_index = 0,
     .scroll_offset = 0,
-    .close_callback = NULL};
+    .close_callback = NULL,
+    .get_item = get_install_item};
+
+static const MenuItem *get_install_item(int index)
+{
+    static char online_install_text[MENU_LABEL_SIZE];
+    static MenuItem online_install_item;
+
+    if (index != ONLINE_INSTALL_LINE) {
+        return &menu_items[index];
+    }
+    menu_label_read(&online_install_label, online_install_text, &online_install_item);
+    return &online_install_item;
+}
 
 void menu_install_dash_activate(void)
 {
     menu_items[OFFLINE_INSTALL_LINE].label = default_offline_install_text;
-    menu_items[ONLINE_INSTALL_LINE].label = default_online_install_text;
+
+    // Labels take one writer at a time. A downloader thread that is still running resets the line itself as it exits.
+    if (downloader_thread_handle == NULL || WaitForSingleObject(downloader_thread_handle, 0) == WAIT_OBJECT_0) {
+        menu_label_publish(&online_install_label, default_online_install_text, install_dashboard_from_online);
+    }
 
     // If this xbe is launched from C:/xboxdash.xbe we disable this installer option
     char target_path[MAX_PATH];
@@ -75,19 +98,15 @@ void menu_install_dash_activate(void)
     menu_push(&menu);
 }
 
-static HANDLE downloader_thread_handle = NULL;
-static HANDLE downloader_semaphore = NULL;
 static void trigger_online_action()
 {
     ReleaseSemaphore(downloader_semaphore, 1, NULL);
 }
 
-static inline void update_downloader_status(char *status, void *callback)
+// The status is copied, so the text buffer can be reused for the next message straight away
+static inline void update_downloader_status(const char *status, void (*callback)(void))
 {
-    WaitForSingleObject(text_render_mutex, INFINITE);
-    menu_items[ONLINE_INSTALL_LINE].label = status;
-    menu_items[ONLINE_INSTALL_LINE].callback = callback;
-    ReleaseMutex(text_render_mutex);
+    menu_label_publish(&online_install_label, status, callback);
 }
 
 static DWORD WINAPI downloader_update_thread(LPVOID lpThreadParameter)
@@ -131,7 +150,13 @@ static DWORD WINAPI downloader_update_thread(LPVOID lpThreadParameter)
         int downloaded_size = 0;
         char downloaded_sha[64 + 1];
         void *mem;
-        if (downloader_download_update(download_url, &mem, &downloaded_data, &downloaded_size, downloaded_sha) == 0) {
+
+        // Frame pacing can drop the dashboard to half rate to leave the CPU to the download
+        pacing_busy_begin();
+        const int download_result = downloader_download_update(download_url, &mem, &downloaded_data, &downloaded_size, downloaded_sha);
+        pacing_busy_end();
+
+        if (download_result == 0) {
             // Compare the downloaded SHA with the expected SHA
             if (strcmp(downloaded_sha, latest_sha) != 0) {
                 update_downloader_status("Hash mismatch! - Aborting download", NULL);
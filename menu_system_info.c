@@ -192,6 +192,9 @@ static void update_system_info(void)
     push_line(line++, callback_stub, "Game Region: %s", game_region_string);
 
     menu.item_count = line;
+
+    // The labels were rewritten in place so any cached layouts are stale
+    text_invalidate_layouts();
 }
 
 void menu_system_info_activate(void)
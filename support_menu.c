@@ -0,0 +1,83 @@
+#include <math.h>
+#include <stdbool.h>
+
+#include "main.h"
+
+// Shared by the dashboard and tools/renderer_bench, so the benchmark draws menus exactly like the dashboard does
+
+const xgu_texture_tint_t highlight_color = {16, 124, 16, 255};
+const xgu_texture_tint_t text_color = {255, 255, 255, 255};
+const xgu_texture_tint_t header_color = {100, 100, 100, 255};
+const xgu_texture_tint_t info_color = {128, 128, 128, 255};
+
+const MenuItem *menu_get_item(const Menu *menu, int index)
+{
+    assert(index >= 0 && index < menu->item_count);
+    return (menu->get_item) ? menu->get_item(index) : &menu->item[index];
+}
+
+// Pixels to scroll this frame to ease towards the selected item. The menu closes on it by the same fraction per 1/60 s
+// whatever rate frames are drawn at, and always moves at least a pixel so it settles.
+int menu_scroll_step(int distance, float delta_time)
+{
+    const float fraction = 1.0f - powf(MENU_SCROLL_REMAINING, delta_time * 60.0f);
+    const int step = (int)(distance * fraction + 0.999f);
+    return (step > 0) ? step : 1;
+}
+
+// Supplied labels may be written into reused buffers, so they can't be cached by their address
+static void draw_label(const Menu *menu, Font *font, const char *label, int x, int y, const xgu_texture_tint_t *color)
+{
+    if (menu->get_item) {
+        text_draw(font, label, x, y, color);
+    } else {
+        text_draw_cached(font, label, x, y, color);
+    }
+}
+
+// Returns true if the menu is still scrolling towards the selected item and needs another frame
+bool menu_render(Menu *menu, Font *font, float delta_time)
+{
+    // The first line of each menu is reserved for the menu title
+    draw_label(menu, font, menu_get_item(menu, 0)->label, X_MARGIN, MENU_Y, &header_color);
+
+    const int clip_top = MENU_Y + ITEM_PADDING;
+    const int clip_height = FOOTER_Y - (int)BODY_FONT_SIZE - MENU_Y;
+    renderer_set_scissor(0, clip_top, WINDOW_WIDTH, clip_height);
+
+    const int line_height = (int)font->line_height;
+    const int selected_y_bottom = MENU_Y + menu->selected_index * line_height + menu->scroll_offset + ITEM_PADDING;
+    const int selected_y_top = selected_y_bottom - line_height;
+
+    // Scroll the selected item to be in view
+    const int scroll_offset = menu->scroll_offset;
+    if (selected_y_top < MENU_Y + ITEM_PADDING) {
+        menu->scroll_offset += menu_scroll_step(MENU_Y + ITEM_PADDING - selected_y_top, delta_time);
+    } else if (selected_y_bottom > FOOTER_Y - (int)BODY_FONT_SIZE) {
+        menu->scroll_offset -= menu_scroll_step(selected_y_bottom - (FOOTER_Y - (int)BODY_FONT_SIZE), delta_time);
+    }
+
+    // Item i sits on the line with its baseline at MENU_Y + i * line_height + scroll_offset. Only the items that can
+    // reach into the scissor are drawn, with a line to spare either side for ascenders and descenders.
+    int first_visible = (clip_top - MENU_Y - menu->scroll_offset) / line_height - 1;
+    int last_visible = (clip_top + clip_height - MENU_Y - menu->scroll_offset) / line_height + 1;
+    first_visible = (first_visible < 1) ? 1 : first_visible;
+    last_visible = (last_visible > menu->item_count - 1) ? menu->item_count - 1 : last_visible;
+
+    for (int i = first_visible; i <= last_visible; ++i) {
+        const MenuItem *item = menu_get_item(menu, i);
+        const xgu_texture_tint_t *color;
+        if (item->callback == NULL) {
+            color = &info_color;
+        } else if (i == menu->selected_index) {
+            color = &highlight_color;
+        } else {
+            color = &text_color;
+        }
+        draw_label(menu, font, item->label, X_MARGIN, MENU_Y + i * line_height + menu->scroll_offset, color);
+    }
+
+    renderer_set_scissor(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+
+    return menu->scroll_offset != scroll_offset;
+}
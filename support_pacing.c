@@ -0,0 +1,103 @@
+#include <ftpd/ftp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <windows.h>
+
+#include "main.h"
+#include "support_pacing.h"
+
+static const char *const mode_names[PACING_MODE_COUNT] = {
+    [PACING_MODE_FULL] = "full",
+    [PACING_MODE_HALF] = "half",
+    [PACING_MODE_ADAPTIVE] = "adaptive",
+};
+
+static pacing_mode_t mode = PACING_MODE_ADAPTIVE;
+static volatile LONG busy_count;
+static uint64_t last_frame_tick;
+static uint64_t last_activity_tick;
+static uint64_t idle_ticks;
+
+void pacing_initialise(void)
+{
+    busy_count = 0;
+    last_frame_tick = profiler_timestamp();
+    last_activity_tick = last_frame_tick;
+    idle_ticks = profiler_us_to_ticks(PACING_IDLE_MS * 1000ULL);
+}
+
+void pacing_set_mode(pacing_mode_t new_mode)
+{
+    assert(new_mode < PACING_MODE_COUNT);
+    mode = new_mode;
+}
+
+pacing_mode_t pacing_get_mode(void)
+{
+    return mode;
+}
+
+const char *pacing_mode_name(pacing_mode_t pacing_mode)
+{
+    assert(pacing_mode < PACING_MODE_COUNT);
+    return mode_names[pacing_mode];
+}
+
+void pacing_busy_begin(void)
+{
+    InterlockedIncrement(&busy_count);
+}
+
+void pacing_busy_end(void)
+{
+    LONG count = InterlockedDecrement(&busy_count);
+    assert(count >= 0);
+    (void)count;
+}
+
+// Input or a running animation keeps adaptive pacing at full rate for another PACING_IDLE_MS
+void pacing_activity(void)
+{
+    last_activity_tick = profiler_timestamp();
+}
+
+// True once PACING_IDLE_MS have passed without input or animation
+bool pacing_idle(void)
+{
+    return profiler_timestamp() - last_activity_tick >= idle_ticks;
+}
+
+// Number of vertical blanks each frame stays on screen for
+uint32_t pacing_interval(void)
+{
+    const bool busy = busy_count > 0 || ftp_active_transfers() > 0;
+    switch (mode) {
+        case PACING_MODE_HALF:
+            return busy ? 2 : 1;
+        case PACING_MODE_ADAPTIVE:
+            return (busy || pacing_idle()) ? 2 : 1;
+        default:
+            return 1;
+    }
+}
+
+// Returns the seconds since the previous frame began, which animations should advance by
+float pacing_frame_begin(void)
+{
+    const uint64_t now = profiler_timestamp();
+    const float delta_time = profiler_elapsed_us(last_frame_tick) / 1000000.0f;
+    last_frame_tick = now;
+    return (delta_time < PACING_MAX_DELTA_TIME) ? delta_time : PACING_MAX_DELTA_TIME;
+}
+
+void pacing_frame_end(void)
+{
+    // The swap renderer_present queued retires on the next vertical blank, and the next frame's swap on the first
+    // vertical blank after it is queued. Sitting out interval vertical blanks here puts the two interval apart.
+    const uint32_t interval = pacing_interval();
+    if (interval > 1) {
+        for (uint32_t i = 0; i < interval; i++) {
+            renderer_wait_for_vblank();
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PACING_IDLE_MS        2000 // Time without input or animation after which adaptive pacing drops to half rate
+#define PACING_MAX_DELTA_TIME 0.1f // Longest step animations take in one frame, so a stall doesn't make them jump
+
+typedef enum pacing_mode
+{
+    PACING_MODE_FULL,     // A frame every vertical blank
+    PACING_MODE_HALF,     // Every other vertical blank while an FTP transfer or update download is active
+    PACING_MODE_ADAPTIVE, // As half, and also every other vertical blank while the dashboard is idle
+    PACING_MODE_COUNT
+} pacing_mode_t;
+
+void pacing_initialise(void);
+void pacing_set_mode(pacing_mode_t mode);
+pacing_mode_t pacing_get_mode(void);
+const char *pacing_mode_name(pacing_mode_t mode);
+
+// Thread safe, calls nest so overlapping transfers keep the dashboard at the lower rate until the last one ends
+void pacing_busy_begin(void);
+void pacing_busy_end(void);
+
+void pacing_activity(void);
+bool pacing_idle(void);
+float pacing_frame_begin(void);
+void pacing_frame_end(void);
+uint32_t pacing_interval(void);
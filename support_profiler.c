@@ -0,0 +1,225 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef NXDK
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "main.h"
+#include "support_profiler.h"
+
+static const char *const stage_names[PROFILER_STAGE_COUNT] = {
+    [PROFILER_STAGE_INPUT] = "input",
+    [PROFILER_STAGE_BACKGROUND] = "background",
+    [PROFILER_STAGE_HEADER] = "header",
+    [PROFILER_STAGE_FOOTER] = "footer",
+    [PROFILER_STAGE_MENU] = "menu",
+    [PROFILER_STAGE_OVERLAY] = "overlay",
+    [PROFILER_STAGE_SUBMIT] = "submit",
+    [PROFILER_STAGE_CPU_WAIT] = "cpu_wait",
+    [PROFILER_STAGE_GPU_WAIT] = "gpu_wait",
+};
+
+typedef struct profiler_frame
+{
+    uint32_t frame_us;
+    uint32_t stage_us[PROFILER_STAGE_COUNT];
+} profiler_frame_t;
+
+static uint64_t tick_frequency;
+static uint64_t frame_start_tick;
+static uint64_t stage_start_tick[PROFILER_STAGE_COUNT];
+static uint64_t stage_ticks[PROFILER_STAGE_COUNT];
+
+// Ring buffer of the last PROFILER_HISTORY_FRAMES completed frames
+static profiler_frame_t history[PROFILER_HISTORY_FRAMES];
+static uint32_t history_head;
+static uint32_t history_count;
+static uint32_t frames_recorded;
+static uint32_t frames_skipped;
+
+static bool overlay_visible = false;
+
+uint64_t profiler_timestamp(void)
+{
+#ifdef NXDK
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)counter.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// Whole seconds are converted separately so the multiply can't overflow, however long the dashboard has been running
+static inline uint64_t ticks_to_us(uint64_t ticks)
+{
+    return (ticks / tick_frequency) * 1000000ULL + (ticks % tick_frequency) * 1000000ULL / tick_frequency;
+}
+
+// Microseconds since a timestamp taken with profiler_timestamp, for one off measurements outside of the frame loop
+uint64_t profiler_elapsed_us(uint64_t since)
+{
+    return ticks_to_us(profiler_timestamp() - since);
+}
+
+// For comparing against timestamp differences directly, so a fixed interval is only converted once
+uint64_t profiler_us_to_ticks(uint64_t us)
+{
+    return (us / 1000000ULL) * tick_frequency + (us % 1000000ULL) * tick_frequency / 1000000ULL;
+}
+
+void profiler_initialise(void)
+{
+#ifdef NXDK
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    tick_frequency = (uint64_t)frequency.QuadPart;
+#else
+    tick_frequency = 1000000000ULL;
+#endif
+
+    memset(stage_ticks, 0, sizeof(stage_ticks));
+    history_head = 0;
+    history_count = 0;
+    frames_recorded = 0;
+    frames_skipped = 0;
+}
+
+void profiler_frame_begin(void)
+{
+    memset(stage_ticks, 0, sizeof(stage_ticks));
+    frame_start_tick = profiler_timestamp();
+}
+
+// Records the frame started by profiler_frame_begin into the history
+void profiler_frame_end(void)
+{
+    profiler_frame_t *frame = &history[history_head];
+    frame->frame_us = (uint32_t)ticks_to_us(profiler_timestamp() - frame_start_tick);
+    for (int i = 0; i < PROFILER_STAGE_COUNT; i++) {
+        frame->stage_us[i] = (uint32_t)ticks_to_us(stage_ticks[i]);
+    }
+
+    history_head = (history_head + 1) % PROFILER_HISTORY_FRAMES;
+    if (history_count < PROFILER_HISTORY_FRAMES) {
+        history_count++;
+    }
+    frames_recorded++;
+}
+
+// Counts a pass of the main loop that had nothing to redraw
+void profiler_frame_skipped(void)
+{
+    frames_skipped++;
+}
+
+void profiler_begin(profiler_stage_t stage)
+{
+    assert(stage < PROFILER_STAGE_COUNT);
+    stage_start_tick[stage] = profiler_timestamp();
+}
+
+// A stage may be entered several times per frame, the time spent in each is summed
+void profiler_end(profiler_stage_t stage)
+{
+    assert(stage < PROFILER_STAGE_COUNT);
+    stage_ticks[stage] += profiler_timestamp() - stage_start_tick[stage];
+}
+
+void profiler_toggle_overlay(void)
+{
+    overlay_visible = !overlay_visible;
+}
+
+bool profiler_overlay_visible(void)
+{
+    return overlay_visible;
+}
+
+static void draw_stat_line(Font *font, const char *name, const uint32_t *values, size_t stride, int x, int y)
+{
+    static const xgu_texture_tint_t stat_color = {255, 255, 255, 255};
+    uint32_t min = UINT32_MAX, max = 0;
+    uint64_t sum = 0;
+
+    for (uint32_t i = 0; i < history_count; i++) {
+        uint32_t value = *(const uint32_t *)((const uint8_t *)values + i * stride);
+        min = (value < min) ? value : min;
+        max = (value > max) ? value : max;
+        sum += value;
+    }
+
+    char line[64];
+    snprintf(line, sizeof(line), "%-10s%7.2f%7.2f%7.2f", name, min / 1000.0f, (float)sum / history_count / 1000.0f,
+             max / 1000.0f);
+    text_draw(font, line, x, y, &stat_color);
+}
+
+void profiler_draw_overlay(Font *font, int x, int y)
+{
+    static const xgu_texture_tint_t backdrop_color = {0, 0, 0, 192};
+    static const xgu_texture_tint_t title_color = {16, 124, 16, 255};
+
+    if (history_count == 0) {
+        return;
+    }
+
+    char title[64];
+    snprintf(title, sizeof(title), "%-10s%7s%7s%7s", "ms", "min", "avg", "max");
+
+    // Title, total frame time, one line per stage, the redraw counters and the renderer state methods
+    const int line_height = (int)font->line_height;
+    const int line_count = PROFILER_STAGE_COUNT + 4;
+    renderer_draw_rectangle(x, y, text_calculate_width(font, title) + ITEM_PADDING * 2,
+                            line_height * line_count + ITEM_PADDING, &backdrop_color);
+
+    x += ITEM_PADDING;
+    y += line_height;
+    text_draw(font, title, x, y, &title_color);
+    y += line_height;
+
+    draw_stat_line(font, "frame", &history[0].frame_us, sizeof(profiler_frame_t), x, y);
+    for (int i = 0; i < PROFILER_STAGE_COUNT; i++) {
+        y += line_height;
+        draw_stat_line(font, stage_names[i], &history[0].stage_us[i], sizeof(profiler_frame_t), x, y);
+    }
+
+    char line[64];
+    snprintf(line, sizeof(line), "drawn %u skipped %u", frames_recorded, frames_skipped);
+    y += line_height;
+    text_draw(font, line, x, y, &title_color);
+
+    renderer_state_stats_t state_stats;
+    renderer_get_state_stats(&state_stats);
+    snprintf(line, sizeof(line), "state sent %u dropped %u", state_stats.methods_emitted, state_stats.methods_suppressed);
+    y += line_height;
+    text_draw(font, line, x, y, &title_color);
+}
+
+void profiler_dump_csv(FILE *file)
+{
+    fprintf(file, "frame,frame_us");
+    for (int i = 0; i < PROFILER_STAGE_COUNT; i++) {
+        fprintf(file, ",%s_us", stage_names[i]);
+    }
+    fprintf(file, "\n");
+
+    // Oldest frame first
+    uint32_t first_frame = frames_recorded - history_count;
+    uint32_t index = (history_head + PROFILER_HISTORY_FRAMES - history_count) % PROFILER_HISTORY_FRAMES;
+    for (uint32_t i = 0; i < history_count; i++) {
+        const profiler_frame_t *frame = &history[index];
+        fprintf(file, "%u,%u", first_frame + i, frame->frame_us);
+        for (int j = 0; j < PROFILER_STAGE_COUNT; j++) {
+            fprintf(file, ",%u", frame->stage_us[j]);
+        }
+        fprintf(file, "\n");
+        index = (index + 1) % PROFILER_HISTORY_FRAMES;
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Number of frames kept for the min/avg/max statistics and the CSV dump
+#define PROFILER_HISTORY_FRAMES 128
+
+typedef enum profiler_stage
+{
+    PROFILER_STAGE_INPUT,
+    PROFILER_STAGE_BACKGROUND,
+    PROFILER_STAGE_HEADER,
+    PROFILER_STAGE_FOOTER,
+    PROFILER_STAGE_MENU,
+    PROFILER_STAGE_OVERLAY,
+    PROFILER_STAGE_SUBMIT,   // Flushing the last batch in renderer_present
+    PROFILER_STAGE_CPU_WAIT, // Waiting to queue the back buffer swap in renderer_present
+    PROFILER_STAGE_GPU_WAIT, // Waiting on the frame's fence in renderer_present
+    PROFILER_STAGE_COUNT
+} profiler_stage_t;
+
+struct font;
+
+void profiler_initialise(void);
+uint64_t profiler_timestamp(void);
+uint64_t profiler_elapsed_us(uint64_t since);
+uint64_t profiler_us_to_ticks(uint64_t us);
+void profiler_frame_begin(void);
+void profiler_frame_end(void);
+void profiler_frame_skipped(void);
+void profiler_begin(profiler_stage_t stage);
+void profiler_end(profiler_stage_t stage);
+
+void profiler_toggle_overlay(void);
+bool profiler_overlay_visible(void);
+void profiler_draw_overlay(struct font *font, int x, int y);
+void profiler_dump_csv(FILE *file);
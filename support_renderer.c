@@ -1,56 +1,220 @@
+#include <stddef.h>
 #include <stdlib.h>
 #include <windows.h>
 #include <hal/video.h>
 
+#include "support_profiler.h"
 #include "support_renderer.h"
+#include "support_texture_asset.h"
 
 static inline void shader_init();
 static inline void unlit_shader_apply();
 static inline void texture_shader_apply();
+static inline void distance_field_shader_apply();
+static inline void combiner_output_apply(bool distance_field);
 static inline uint32_t npot2pot(uint32_t num);
+static inline size_t texture_data_size(const xgu_texture_t *texture);
+
+// Quads are accumulated in this vertex buffer and submitted with a single draw arrays call per batch.
+// The buffer is reused every frame as renderer_present waits for the GPU to finish before returning.
+#define BATCH_MAX_QUADS      2048
+#define BATCH_QUADS_PER_DRAW 64 // NV097_DRAW_ARRAYS can only draw 256 vertices at once
+
+// Recorded lists keep their vertices in a region after the per frame batch quads, so they are written only once
+#define LIST_MAX_QUADS 256
+#define LIST_MAX_DRAWS 16
+
+// DMA channel for the context the GPU writes fence semaphores through, one pbkit doesn't use for its own contexts
+#define FENCE_DMA_CHANNEL 14
+
+typedef struct batch_vertex
+{
+    float position[4];
+    float texcoord[3];
+} batch_vertex_t;
 
 static uint32_t *p;
-static int texture_combiner_active = 0;
-static const xgu_texture_t *active_texture = NULL;
+static uint32_t frame_count = 0;
+static renderer_fence_t fence_submitted = 0;
+static volatile uint32_t *fence_semaphore; // The GPU writes the last fence it passed here
+static struct s_CtxDma fence_dma;
+
+static batch_vertex_t *batch_vertices;
+static uint32_t batch_vertices_physical_address;
+static int batch_start;
+static int batch_count;
+static const xgu_texture_t *batch_texture = NULL;
+static xgu_texture_tint_t batch_tint;
+static float batch_s_scale;
+static float batch_t_scale;
+
+typedef struct renderer_list_draw
+{
+    const xgu_texture_t *texture;
+    xgu_texture_tint_t tint;
+    int first_quad;
+    int quad_count;
+} renderer_list_draw_t;
 
-xgu_texture_t *texture_create(const void *texture_data, uint32_t width, uint32_t height, XguTexFormatColor format)
+struct renderer_list
+{
+    int first_quad; // Index of the list's region in batch_vertices, in quads
+    int max_quads;
+    int quad_count;
+    int draw_count;
+    renderer_list_draw_t draw[LIST_MAX_DRAWS];
+};
+
+static renderer_list_t *list_recording = NULL;
+static int list_quads_allocated = 0;
+static int list_saved_batch_start;
+
+// Shadow copy of the NV2A registers the renderer sets, so methods that would write the value a register already
+// holds never reach the push buffer. The GPU keeps its registers across frames, so this is only reset on initialise.
+typedef enum renderer_state_register
+{
+    STATE_COMBINER, // Not a register, selects which of the *_shader_apply functions was last pushed
+    STATE_COMBINER_ALPHA_OCW0,
+    STATE_COMBINER_CONTROL,
+    STATE_TEXTURE_OFFSET,
+    STATE_TEXTURE_FORMAT,
+    STATE_TEXTURE_PALETTE,
+    STATE_TEXTURE_ADDRESS,
+    STATE_TEXTURE_CONTROL0,
+    STATE_TEXTURE_CONTROL1,
+    STATE_TEXTURE_IMAGE_RECT,
+    STATE_TEXTURE_FILTER,
+    STATE_DIFFUSE_COLOR,
+    STATE_WINDOW_CLIP_HORIZONTAL,
+    STATE_WINDOW_CLIP_VERTICAL,
+    STATE_BLEND_ENABLE,
+    STATE_BLEND_SFACTOR,
+    STATE_BLEND_DFACTOR,
+    STATE_COUNT
+} renderer_state_register_t;
+
+#define COMBINER_UNLIT          0
+#define COMBINER_TEXTURED       1
+#define COMBINER_DISTANCE_FIELD 2
+#define COMBINER_METHODS        4 // Methods pushed by each of the *_shader_apply functions
+
+static uint32_t state_value[STATE_COUNT];
+static uint32_t state_valid;
+static renderer_state_stats_t state_stats;
+static renderer_state_stats_t state_stats_presented;
+
+// Returns true if the register doesn't hold the value yet, in which case the caller pushes the methods to set it.
+// Values that xgu encodes from several arguments are keyed on those arguments instead of the register contents.
+static inline bool state_update(renderer_state_register_t reg, uint32_t value, uint32_t methods)
+{
+    if ((state_valid & (1u << reg)) && state_value[reg] == value) {
+        state_stats.methods_suppressed += methods;
+        return false;
+    }
+    state_value[reg] = value;
+    state_valid |= 1u << reg;
+    state_stats.methods_emitted += methods;
+    return true;
+}
+
+// xgu doesn't expose the paletted format yet
+#define XGU_TEXTURE_FORMAT_I8_A8R8G8B8_SWIZZLED ((XguTexFormatColor)NV097_SET_TEXTURE_FORMAT_COLOR_SZ_I8_A8R8G8B8)
+
+// Linear formats are sampled with texel coordinates, swizzled and compressed formats with normalised coordinates
+static bool texture_format_is_linear(XguTexFormatColor format)
+{
+    switch (format) {
+        case XGU_TEXTURE_FORMAT_A8:
+        case XGU_TEXTURE_FORMAT_R5G6B5:
+        case XGU_TEXTURE_FORMAT_R8G8B8A8:
+        case XGU_TEXTURE_FORMAT_A8B8G8R8:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static xgu_texture_t *texture_allocate(uint32_t width, uint32_t height, XguTexFormatColor format, uint32_t palette_length)
 {
     xgu_texture_t *xgu_texture = malloc(sizeof(xgu_texture_t));
     xgu_texture->tex_height = height;
     xgu_texture->tex_width = width;
     xgu_texture->data_height = npot2pot(height);
     xgu_texture->data_width = npot2pot(width);
+    xgu_texture->palette_length = palette_length;
+    xgu_texture->palette_physical_address = NULL;
+    xgu_texture->distance_field = false;
 
     xgu_texture->format = format;
-    switch (format) {
+    switch ((uint32_t)format) { // The paletted format isn't part of XguTexFormatColor
         case XGU_TEXTURE_FORMAT_A8:
+        case XGU_TEXTURE_FORMAT_A8_SWIZZLED:
+        case XGU_TEXTURE_FORMAT_I8_A8R8G8B8_SWIZZLED:
             xgu_texture->bytes_per_pixel = 1;
             break;
         case XGU_TEXTURE_FORMAT_R5G6B5:
+        case XGU_TEXTURE_FORMAT_R5G6B5_SWIZZLED:
             xgu_texture->bytes_per_pixel = 2;
             break;
         case XGU_TEXTURE_FORMAT_R8G8B8A8:
         case XGU_TEXTURE_FORMAT_A8B8G8R8:
+        case XGU_TEXTURE_FORMAT_R8G8B8A8_SWIZZLED:
+        case XGU_TEXTURE_FORMAT_A8B8G8R8_SWIZZLED:
             xgu_texture->bytes_per_pixel = 4;
             break;
+        case XGU_TEXTURE_FORMAT_DXT1:
+        case XGU_TEXTURE_FORMAT_DXT5:
+            // Compressed formats are stored as 4x4 blocks, so are at least one block in each direction
+            xgu_texture->bytes_per_pixel = 0;
+            xgu_texture->data_width = (xgu_texture->data_width < 4) ? 4 : xgu_texture->data_width;
+            xgu_texture->data_height = (xgu_texture->data_height < 4) ? 4 : xgu_texture->data_height;
+            break;
         default:
             free(xgu_texture);
             return NULL;
     }
 
-    size_t allocation_size = xgu_texture->data_height * xgu_texture->data_width * xgu_texture->bytes_per_pixel;
+    // The palette follows the texel data, its offset needs to be 64 byte aligned
+    size_t palette_offset = (texture_data_size(xgu_texture) + 63) & ~63;
+    size_t allocation_size = palette_offset + palette_length * sizeof(uint32_t);
     xgu_texture->data = MmAllocateContiguousMemoryEx(allocation_size, 0, 0xFFFFFFFF, 0, PAGE_WRITECOMBINE | PAGE_READWRITE);
     if (xgu_texture->data == NULL) {
         free(xgu_texture);
         return NULL;
     }
     xgu_texture->data_physical_address = (uint8_t *)MmGetPhysicalAddress(xgu_texture->data);
+    if (palette_length > 0) {
+        xgu_texture->palette_physical_address = xgu_texture->data_physical_address + palette_offset;
+    }
+    return xgu_texture;
+}
 
-    const uint8_t *source8 = (const uint8_t *)texture_data;
-    const uint32_t data_stride = xgu_texture->data_width * xgu_texture->bytes_per_pixel;
-    const uint32_t texture_stride = width * xgu_texture->bytes_per_pixel;
-    for (uint32_t i = 0; i < height; i++) {
-        memcpy(&xgu_texture->data[i * data_stride], &source8[i * texture_stride], texture_stride);
+// Linear formats take tightly packed rows of width * height texels. Any other format takes data already
+// in the layout the GPU samples, padded to the power of two dimensions, as generated by tools/texture_encoder.
+xgu_texture_t *texture_create(const void *texture_data, uint32_t width, uint32_t height, XguTexFormatColor format)
+{
+    xgu_texture_t *xgu_texture = texture_allocate(width, height, format, 0);
+    if (xgu_texture == NULL) {
+        return NULL;
+    }
+
+    size_t allocation_size = texture_data_size(xgu_texture);
+
+    // Without initial data the texture is left writable so it can be filled in later with texture_update
+    if (texture_data == NULL) {
+        memset(xgu_texture->data, 0, allocation_size);
+        return xgu_texture;
+    }
+
+    if (texture_format_is_linear(format)) {
+        const uint8_t *source8 = (const uint8_t *)texture_data;
+        const uint32_t data_stride = xgu_texture->data_width * xgu_texture->bytes_per_pixel;
+        const uint32_t texture_stride = width * xgu_texture->bytes_per_pixel;
+        for (uint32_t i = 0; i < height; i++) {
+            memcpy(&xgu_texture->data[i * data_stride], &source8[i * texture_stride], texture_stride);
+        }
+    } else {
+        memcpy(xgu_texture->data, texture_data, allocation_size);
     }
 
     // Maybe faster? Don't know
@@ -58,12 +222,203 @@ xgu_texture_t *texture_create(const void *texture_data, uint32_t width, uint32_t
     return xgu_texture;
 }
 
+xgu_texture_t *texture_create_from_asset(const void *asset_data, size_t asset_size)
+{
+    const texture_asset_header_t *header = (const texture_asset_header_t *)asset_data;
+    if (asset_size < sizeof(texture_asset_header_t) || header->magic != TEXTURE_ASSET_MAGIC ||
+        header->version != TEXTURE_ASSET_VERSION) {
+        return NULL;
+    }
+
+    const uint32_t *palette = (const uint32_t *)(header + 1);
+    const uint8_t *texel_data = (const uint8_t *)(palette + header->palette_count);
+    if ((const uint8_t *)asset_data + asset_size < texel_data + header->data_size) {
+        return NULL;
+    }
+
+    XguTexFormatColor format;
+    switch (header->format) {
+        case TEXTURE_ASSET_FORMAT_A8B8G8R8:
+            format = XGU_TEXTURE_FORMAT_A8B8G8R8;
+            break;
+        case TEXTURE_ASSET_FORMAT_A8B8G8R8_SWIZZLED:
+            format = XGU_TEXTURE_FORMAT_A8B8G8R8_SWIZZLED;
+            break;
+        case TEXTURE_ASSET_FORMAT_P8_SWIZZLED:
+            format = XGU_TEXTURE_FORMAT_I8_A8R8G8B8_SWIZZLED;
+            break;
+        case TEXTURE_ASSET_FORMAT_DXT1:
+            format = XGU_TEXTURE_FORMAT_DXT1;
+            break;
+        case TEXTURE_ASSET_FORMAT_DXT5:
+            format = XGU_TEXTURE_FORMAT_DXT5;
+            break;
+        default:
+            return NULL;
+    }
+
+    // Only full length palettes are supported
+    if (header->palette_count != ((format == XGU_TEXTURE_FORMAT_I8_A8R8G8B8_SWIZZLED) ? 256 : 0)) {
+        return NULL;
+    }
+
+    xgu_texture_t *xgu_texture = texture_allocate(header->width, header->height, format, header->palette_count);
+    if (xgu_texture == NULL) {
+        return NULL;
+    }
+
+    // The encoder pads to the same dimensions we allocate, so the texels can be copied in one go
+    size_t data_size = texture_data_size(xgu_texture);
+    if (xgu_texture->data_width != header->data_width || xgu_texture->data_height != header->data_height ||
+        data_size != header->data_size) {
+        texture_destroy(xgu_texture);
+        return NULL;
+    }
+    memcpy(xgu_texture->data, texel_data, data_size);
+
+    size_t allocation_size = data_size;
+    if (header->palette_count > 0) {
+        size_t palette_offset = xgu_texture->palette_physical_address - xgu_texture->data_physical_address;
+        memcpy(xgu_texture->data + palette_offset, palette, header->palette_count * sizeof(uint32_t));
+        allocation_size = palette_offset + header->palette_count * sizeof(uint32_t);
+    }
+
+    MmSetAddressProtect(xgu_texture->data, allocation_size, PAGE_READONLY);
+    return xgu_texture;
+}
+
+void texture_update(xgu_texture_t *texture, uint32_t x, uint32_t y, uint32_t width, uint32_t height, const void *texture_data)
+{
+    assert(texture_format_is_linear(texture->format));
+    assert(x + width <= texture->tex_width && y + height <= texture->tex_height);
+
+    // Only copy the dirty rectangle, the rest of the texture is left untouched
+    const uint8_t *source8 = (const uint8_t *)texture_data;
+    const uint32_t data_stride = texture->data_width * texture->bytes_per_pixel;
+    const uint32_t texture_stride = width * texture->bytes_per_pixel;
+    uint8_t *destination8 = &texture->data[y * data_stride + x * texture->bytes_per_pixel];
+    for (uint32_t i = 0; i < height; i++) {
+        memcpy(&destination8[i * data_stride], &source8[i * texture_stride], texture_stride);
+    }
+}
+
 void texture_destroy(xgu_texture_t *texture)
 {
     MmFreeContiguousMemory(texture->data);
     free(texture);
 }
 
+// Each texture register is compared on its own, so textures sharing a format or size only push what differs
+static void texture_apply(const xgu_texture_t *texture)
+{
+    const uint32_t width_log2 = __builtin_ctz(texture->data_width);
+    const uint32_t height_log2 = __builtin_ctz(texture->data_height);
+
+    if (state_update(STATE_TEXTURE_OFFSET, (uint32_t)texture->data_physical_address, 1)) {
+        p = xgu_set_texture_offset(p, 0, texture->data_physical_address);
+    }
+    if (state_update(STATE_TEXTURE_FORMAT, (uint32_t)texture->format << 16 | width_log2 << 8 | height_log2, 1)) {
+        p = xgu_set_texture_format(p, 0, 2, false, XGU_SOURCE_COLOR, 2, texture->format, 1, width_log2, height_log2, 0);
+    }
+    if (texture->palette_length > 0 && state_update(STATE_TEXTURE_PALETTE, (uint32_t)texture->palette_physical_address, 1)) {
+        // xgu_set_texture_palette shifts the offset, so push the method directly
+        p = pb_push1(p, NV097_SET_TEXTURE_PALETTE,
+                     XGU_MASK(NV097_SET_TEXTURE_PALETTE_CONTEXT_DMA, 1) |
+                         XGU_MASK(NV097_SET_TEXTURE_PALETTE_LENGTH, NV097_SET_TEXTURE_PALETTE_LENGTH_256) |
+                         ((uint32_t)texture->palette_physical_address & NV097_SET_TEXTURE_PALETTE_OFFSET));
+    }
+    if (state_update(STATE_TEXTURE_ADDRESS, XGU_CLAMP_TO_EDGE, 1)) {
+        p = xgu_set_texture_address(p, 0, XGU_CLAMP_TO_EDGE, false, XGU_CLAMP_TO_EDGE, false, XGU_CLAMP_TO_EDGE, false, false);
+    }
+    if (state_update(STATE_TEXTURE_CONTROL0, true, 1)) {
+        p = xgu_set_texture_control0(p, 0, true, 0, 0);
+    }
+    if (state_update(STATE_TEXTURE_CONTROL1, texture->data_width * texture->bytes_per_pixel, 1)) {
+        p = xgu_set_texture_control1(p, 0, texture->data_width * texture->bytes_per_pixel);
+    }
+    if (state_update(STATE_TEXTURE_IMAGE_RECT, texture->data_width << 16 | texture->data_height, 1)) {
+        p = xgu_set_texture_image_rect(p, 0, texture->data_width, texture->data_height);
+    }
+    if (state_update(STATE_TEXTURE_FILTER, XGU_TEXTURE_CONVOLUTION_GAUSSIAN, 1)) {
+        p = xgu_set_texture_filter(p, 0, 0, XGU_TEXTURE_CONVOLUTION_GAUSSIAN, 2, 2, false, false, false, false);
+    }
+}
+
+static void diffuse_color_apply(const xgu_texture_tint_t *tint)
+{
+    const uint32_t color = tint->r | tint->g << 8 | tint->b << 16 | (uint32_t)tint->a << 24;
+    if (state_update(STATE_DIFFUSE_COLOR, color, 1)) {
+        p = xgux_set_color4ub(p, tint->r, tint->g, tint->b, tint->a);
+    }
+}
+
+// Boundaries are always given in texels, normalise them for textures that aren't linear
+static void texture_coordinate_scale(const xgu_texture_t *texture, float *s_scale, float *t_scale)
+{
+    if (texture_format_is_linear(texture->format)) {
+        *s_scale = 1.0f;
+        *t_scale = 1.0f;
+    } else {
+        *s_scale = 1.0f / texture->data_width;
+        *t_scale = 1.0f / texture->data_height;
+    }
+}
+
+static void batch_vertex_texcoords(batch_vertex_t *v, const xgu_texture_boundary_t *boundary, float s_scale, float t_scale)
+{
+    const float s0 = boundary->s0 * s_scale;
+    const float s1 = boundary->s1 * s_scale;
+    const float t0 = boundary->t0 * t_scale;
+    const float t1 = boundary->t1 * t_scale;
+
+    v[0].texcoord[0] = s0;
+    v[0].texcoord[1] = t0;
+    v[1].texcoord[0] = s1;
+    v[1].texcoord[1] = t0;
+    v[2].texcoord[0] = s1;
+    v[2].texcoord[1] = t1;
+    v[3].texcoord[0] = s0;
+    v[3].texcoord[1] = t1;
+}
+
+static void combiner_apply(uint32_t combiner)
+{
+    if (state_update(STATE_COMBINER, combiner, COMBINER_METHODS)) {
+        switch (combiner) {
+            case COMBINER_UNLIT:
+                unlit_shader_apply();
+                break;
+            case COMBINER_TEXTURED:
+                texture_shader_apply();
+                break;
+            case COMBINER_DISTANCE_FIELD:
+                distance_field_shader_apply();
+                break;
+        }
+    }
+    combiner_output_apply(combiner == COMBINER_DISTANCE_FIELD);
+}
+
+// Pushes the state and draw calls for quads already in batch_vertices. Must be called between pb_begin and pb_end
+static void draw_quads(const xgu_texture_t *texture, const xgu_texture_tint_t *tint, int first_quad, int quad_count)
+{
+    combiner_apply(texture->distance_field ? COMBINER_DISTANCE_FIELD : COMBINER_TEXTURED);
+    texture_apply(texture);
+    diffuse_color_apply(tint);
+
+    p = xgu_begin(p, XGU_QUADS);
+    for (int i = 0; i < quad_count; i += BATCH_QUADS_PER_DRAW) {
+        int quads = (quad_count - i < BATCH_QUADS_PER_DRAW) ? quad_count - i : BATCH_QUADS_PER_DRAW;
+        p = xgu_draw_arrays(p, (first_quad + i) * 4, quads * 4);
+    }
+    p = xgu_end(p);
+}
+
+void renderer_get_state_stats(renderer_state_stats_t *stats)
+{
+    *stats = state_stats_presented;
+}
+
 void renderer_deinit(void)
 {
 }
@@ -85,16 +440,32 @@ void renderer_initialise(void)
         0.0f, 0.0f, 1.0f, 0.0f,
         0.0f, 0.0f, 0.0f, 1.0f};
 
+    // Fences are semaphore releases in the push buffer, written through a DMA context covering all of RAM
+    fence_semaphore = MmAllocateContiguousMemoryEx(PAGE_SIZE, 0, 0xFFFFFFFF, 0, PAGE_WRITECOMBINE | PAGE_READWRITE);
+    assert(fence_semaphore != NULL);
+    *fence_semaphore = fence_submitted;
+    pb_create_dma_ctx(FENCE_DMA_CHANNEL, DMA_CLASS_3D, 0, MAXRAM, &fence_dma);
+    pb_bind_channel(&fence_dma);
+
     p = pb_begin();
 
+    p = pb_push1(p, NV097_SET_CONTEXT_DMA_SEMAPHORE, fence_dma.ChannelID);
+    p = pb_push1(p, NV097_SET_SEMAPHORE_OFFSET, (uint32_t)MmGetPhysicalAddress((void *)fence_semaphore));
+
+    state_valid = 0;
     shader_init();
-    unlit_shader_apply();
-    texture_combiner_active = false;
+    combiner_apply(COMBINER_UNLIT);
 
-    p = xgu_set_blend_enable(p, true);
+    if (state_update(STATE_BLEND_ENABLE, true, 1)) {
+        p = xgu_set_blend_enable(p, true);
+    }
+    if (state_update(STATE_BLEND_SFACTOR, XGU_FACTOR_SRC_ALPHA, 1)) {
+        p = xgu_set_blend_func_sfactor(p, XGU_FACTOR_SRC_ALPHA);
+    }
+    if (state_update(STATE_BLEND_DFACTOR, XGU_FACTOR_ONE_MINUS_SRC_ALPHA, 1)) {
+        p = xgu_set_blend_func_dfactor(p, XGU_FACTOR_ONE_MINUS_SRC_ALPHA);
+    }
     p = xgu_set_depth_test_enable(p, false);
-    p = xgu_set_blend_func_sfactor(p, XGU_FACTOR_SRC_ALPHA);
-    p = xgu_set_blend_func_dfactor(p, XGU_FACTOR_ONE_MINUS_SRC_ALPHA);
     p = xgu_set_depth_func(p, XGU_FUNC_LESS_OR_EQUAL);
 
     p = xgu_set_skin_mode(p, XGU_SKIN_MODE_OFF);
@@ -124,37 +495,80 @@ void renderer_initialise(void)
     p = xgu_set_viewport_scale(p, 1.0f, 1.0f, 1.0f, 1.0f);
 
     p = xgu_set_scissor_rect(p, false, 0, 0, pb_back_buffer_width() - 1, pb_back_buffer_height() - 1);
+    state_update(STATE_WINDOW_CLIP_HORIZONTAL, (pb_back_buffer_width() - 1) << 16, 1);
+    state_update(STATE_WINDOW_CLIP_VERTICAL, (pb_back_buffer_height() - 1) << 16, 1);
+
+    // Only position and texture coordinates are read from the batch vertex buffer, everything else is constant
+    batch_vertices = MmAllocateContiguousMemoryEx((BATCH_MAX_QUADS + LIST_MAX_QUADS) * 4 * sizeof(batch_vertex_t), 0, 0xFFFFFFFF, 0, PAGE_WRITECOMBINE | PAGE_READWRITE);
+    assert(batch_vertices != NULL);
+    batch_vertices_physical_address = (uint32_t)MmGetPhysicalAddress(batch_vertices);
+
+    for (int i = 0; i < 16; i++) {
+        p = xgu_set_vertex_data_array_format(p, i, XGU_FLOAT, 0, 0);
+    }
+    p = xgu_set_vertex_data_array_format(p, XGU_VERTEX_ARRAY, XGU_FLOAT, 4, sizeof(batch_vertex_t));
+    p = xgu_set_vertex_data_array_offset(p, XGU_VERTEX_ARRAY, (void *)(batch_vertices_physical_address + offsetof(batch_vertex_t, position)));
+    p = xgu_set_vertex_data_array_format(p, XGU_TEXCOORD0_ARRAY, XGU_FLOAT, 3, sizeof(batch_vertex_t));
+    p = xgu_set_vertex_data_array_offset(p, XGU_TEXCOORD0_ARRAY, (void *)(batch_vertices_physical_address + offsetof(batch_vertex_t, texcoord)));
 
     pb_end(p);
 }
 
+uint32_t renderer_frame_count(void)
+{
+    return frame_count;
+}
+
 void renderer_start(void)
 {
+    frame_count++;
     pb_reset();
     pb_target_back_buffer();
     p = pb_begin();
     p = xgu_set_color_clear_value(p, 0xff000000);
     p = xgu_clear_surface(p, XGU_CLEAR_Z | XGU_CLEAR_STENCIL | XGU_CLEAR_COLOR);
     pb_end(p);
+
+    batch_start = 0;
+    batch_count = 0;
+    batch_texture = NULL;
+    memset(&state_stats, 0, sizeof(state_stats));
 }
 
 void renderer_set_scissor(int x, int y, int width, int height)
 {
+    assert(list_recording == NULL);
+
+    // The clip type never changes after initialise, so only the two extents are pushed
+    const uint32_t horizontal = ((uint32_t)(x + width) << 16) | (uint32_t)x;
+    const uint32_t vertical = ((uint32_t)(y + height) << 16) | (uint32_t)y;
+    if (state_value[STATE_WINDOW_CLIP_HORIZONTAL] == horizontal && state_value[STATE_WINDOW_CLIP_VERTICAL] == vertical) {
+        // Nothing changes, so the pending batch can keep accumulating
+        state_stats.methods_suppressed += 2;
+        return;
+    }
+
+    renderer_batch_flush();
+
     p = pb_begin();
-    p = xgu_set_scissor_rect(p, false, x, y, width, height);
+    if (state_update(STATE_WINDOW_CLIP_HORIZONTAL, horizontal, 1)) {
+        p = pb_push1(p, NV097_SET_WINDOW_CLIP_HORIZONTAL, horizontal);
+    }
+    if (state_update(STATE_WINDOW_CLIP_VERTICAL, vertical, 1)) {
+        p = pb_push1(p, NV097_SET_WINDOW_CLIP_VERTICAL, vertical);
+    }
     pb_end(p);
 }
 
 void renderer_draw_rectangle(int x, int y, int width, int height, const xgu_texture_tint_t *tint)
 {
-    p = pb_begin();
+    assert(list_recording == NULL);
+    renderer_batch_flush();
 
-    if (texture_combiner_active == 1) {
-        unlit_shader_apply();
-        texture_combiner_active = 0;
-    }
+    p = pb_begin();
 
-    p = xgux_set_color4ub(p, tint->r, tint->g, tint->b, tint->a);
+    combiner_apply(COMBINER_UNLIT);
+    diffuse_color_apply(tint);
 
     p = xgu_begin(p, XGU_QUADS);
     p = xgu_vertex4f(p, x, y, 1, 1);
@@ -168,67 +582,227 @@ void renderer_draw_rectangle(int x, int y, int width, int height, const xgu_text
 
 void renderer_draw_textured_rectangle(int x, int y, int width, int height, const xgu_texture_t *texture, const xgu_texture_tint_t *tint, const xgu_texture_boundary_t *boundary)
 {
-    p = pb_begin();
+    const xgu_texture_boundary_t full_texture = {0.0f, (float)texture->tex_width, 0.0f, (float)texture->tex_height};
+
+    renderer_batch_begin(texture, tint);
+    renderer_batch_add_quad(x, y, width, height, (boundary) ? boundary : &full_texture);
+}
 
-    if (texture_combiner_active == 0) {
-        texture_shader_apply();
-        texture_combiner_active = 1;
+void renderer_batch_begin(const xgu_texture_t *texture, const xgu_texture_tint_t *tint)
+{
+    const xgu_texture_tint_t white = {255, 255, 255, 255};
+    if (tint == NULL) {
+        tint = &white;
     }
 
-    if (active_texture != texture) {
-        p = xgu_set_texture_offset(p, 0, texture->data_physical_address);
-        p = xgu_set_texture_format(p, 0, 2, false, XGU_SOURCE_COLOR, 2, texture->format, 1,
-                                   __builtin_ctz(texture->data_width), __builtin_ctz(texture->data_height), 0);
-        p = xgu_set_texture_address(p, 0, XGU_CLAMP_TO_EDGE, false, XGU_CLAMP_TO_EDGE, false, XGU_CLAMP_TO_EDGE, false, false);
-        p = xgu_set_texture_control0(p, 0, true, 0, 0);
-        p = xgu_set_texture_control1(p, 0, texture->data_width * texture->bytes_per_pixel);
-        p = xgu_set_texture_image_rect(p, 0, texture->data_width, texture->data_height);
-        p = xgu_set_texture_filter(p, 0, 0, XGU_TEXTURE_CONVOLUTION_GAUSSIAN, 2, 2, false, false, false, false);
-        active_texture = texture;
+    // Quads can only share a draw call if they use the same texture and tint
+    if (batch_count > 0 && batch_texture == texture && memcmp(&batch_tint, tint, sizeof(batch_tint)) == 0) {
+        return;
     }
 
-    if (tint) {
-        p = xgux_set_color4ub(p, tint->r, tint->g, tint->b, tint->a);
+    renderer_batch_flush();
+    batch_texture = texture;
+    batch_tint = *tint;
+
+    texture_coordinate_scale(texture, &batch_s_scale, &batch_t_scale);
+}
+
+void renderer_batch_add_quad(int x, int y, int width, int height, const xgu_texture_boundary_t *boundary)
+{
+    assert(batch_texture != NULL);
+
+    // If the vertex buffer is full, wait for the GPU to consume what we have queued so far and start over
+    if (list_recording != NULL) {
+        assert(batch_start + batch_count < list_recording->first_quad + list_recording->max_quads);
+    } else if (batch_start + batch_count == BATCH_MAX_QUADS) {
+        renderer_batch_flush();
+        renderer_fence_wait(renderer_fence_insert());
+        batch_start = 0;
+    }
+
+    const float x0 = (float)x;
+    const float y0 = (float)y;
+    const float x1 = (float)(x + width);
+    const float y1 = (float)(y + height);
+    const float s0 = boundary->s0 * batch_s_scale;
+    const float s1 = boundary->s1 * batch_s_scale;
+    const float t0 = boundary->t0 * batch_t_scale;
+    const float t1 = boundary->t1 * batch_t_scale;
+
+    batch_vertex_t *v = &batch_vertices[(batch_start + batch_count) * 4];
+    v[0] = (batch_vertex_t){{x0, y0, 1, 1}, {s0, t0, 1}};
+    v[1] = (batch_vertex_t){{x1, y0, 1, 1}, {s1, t0, 1}};
+    v[2] = (batch_vertex_t){{x1, y1, 1, 1}, {s1, t1, 1}};
+    v[3] = (batch_vertex_t){{x0, y1, 1, 1}, {s0, t1, 1}};
+    batch_count++;
+}
+
+void renderer_batch_flush(void)
+{
+    if (batch_count == 0) {
+        return;
+    }
+
+    if (list_recording != NULL) {
+        assert(list_recording->draw_count < LIST_MAX_DRAWS);
+        list_recording->draw[list_recording->draw_count++] = (renderer_list_draw_t){
+            .texture = batch_texture,
+            .tint = batch_tint,
+            .first_quad = batch_start,
+            .quad_count = batch_count};
     } else {
-        p = xgux_set_color4ub(p, 255, 255, 255, 255);
+        p = pb_begin();
+        draw_quads(batch_texture, &batch_tint, batch_start, batch_count);
+        pb_end(p);
     }
 
-    const float dest_x = (float)x;
-    const float dest_y = (float)y;
-    const float dest_w = (float)width;
-    const float dest_h = (float)height;
+    batch_start += batch_count;
+    batch_count = 0;
+}
 
-    const float s0 = (boundary) ? boundary->s0 : 0.0f;
-    const float s1 = (boundary) ? boundary->s1 : texture->tex_width;
-    const float t0 = (boundary) ? boundary->t0 : 0.0f;
-    const float t1 = (boundary) ? boundary->t1 : texture->tex_height;
+renderer_list_t *renderer_list_create(int max_quads)
+{
+    if (list_quads_allocated + max_quads > LIST_MAX_QUADS) {
+        return NULL;
+    }
 
-    p = xgu_begin(p, XGU_TRIANGLE_STRIP);
+    renderer_list_t *list = malloc(sizeof(renderer_list_t));
+    if (list == NULL) {
+        return NULL;
+    }
+    list->first_quad = BATCH_MAX_QUADS + list_quads_allocated;
+    list->max_quads = max_quads;
+    list->quad_count = 0;
+    list->draw_count = 0;
+    list_quads_allocated += max_quads;
+    return list;
+}
 
-    p = xgux_set_texcoord3f(p, 0, s0, t0, 1);
-    p = xgu_vertex4f(p, dest_x, dest_y, 1, 1);
-    p = xgux_set_texcoord3f(p, 0, s1, t0, 1);
-    p = xgu_vertex4f(p, dest_x + dest_w, dest_y, 1, 1);
-    p = xgux_set_texcoord3f(p, 0, s0, t1, 1);
-    p = xgu_vertex4f(p, dest_x, dest_y + dest_h, 1, 1);
-    p = xgux_set_texcoord3f(p, 0, s1, t1, 1);
-    p = xgu_vertex4f(p, dest_x + dest_w, dest_y + dest_h, 1, 1);
+// List regions are handed out in order, so only the most recently created list gives its quads back
+void renderer_list_destroy(renderer_list_t *list)
+{
+    if (list->first_quad + list->max_quads == BATCH_MAX_QUADS + list_quads_allocated) {
+        list_quads_allocated -= list->max_quads;
+    }
+    free(list);
+}
 
-    p = xgu_end(p);
+void renderer_list_begin(renderer_list_t *list)
+{
+    assert(list_recording == NULL);
+    renderer_batch_flush();
 
+    // The list's vertices may still be read by a frame in flight
+    renderer_fence_wait(renderer_fence_insert());
+
+    list->quad_count = 0;
+    list->draw_count = 0;
+    list_recording = list;
+    list_saved_batch_start = batch_start;
+    batch_start = list->first_quad;
+}
+
+void renderer_list_end(void)
+{
+    assert(list_recording != NULL);
+    renderer_batch_flush();
+
+    list_recording->quad_count = batch_start - list_recording->first_quad;
+    list_recording = NULL;
+    batch_start = list_saved_batch_start;
+}
+
+void renderer_list_draw(const renderer_list_t *list)
+{
+    assert(list_recording == NULL);
+    renderer_batch_flush();
+
+    p = pb_begin();
+    for (int i = 0; i < list->draw_count; i++) {
+        const renderer_list_draw_t *draw = &list->draw[i];
+        draw_quads(draw->texture, &draw->tint, draw->first_quad, draw->quad_count);
+    }
     pb_end(p);
 }
 
-void renderer_present(void)
+void renderer_list_set_boundary(renderer_list_t *list, int quad_index, const xgu_texture_boundary_t *boundary)
 {
-    pb_wait_for_vbl();
+    assert(quad_index >= 0 && quad_index < list->quad_count);
+
+    const int quad = list->first_quad + quad_index;
+    for (int i = 0; i < list->draw_count; i++) {
+        const renderer_list_draw_t *draw = &list->draw[i];
+        if (quad >= draw->first_quad && quad < draw->first_quad + draw->quad_count) {
+            float s_scale, t_scale;
+            texture_coordinate_scale(draw->texture, &s_scale, &t_scale);
+            batch_vertex_texcoords(&batch_vertices[quad * 4], boundary, s_scale, t_scale);
+            return;
+        }
+    }
+}
+
+// The GPU writes a fence's sequence number to fence_semaphore once it has consumed every method pushed before it
+renderer_fence_t renderer_fence_insert(void)
+{
+    assert(list_recording == NULL);
+
+    p = pb_begin();
+    p = pb_push1(p, NV097_BACK_END_WRITE_SEMAPHORE_RELEASE, ++fence_submitted);
+    pb_end(p);
+    return fence_submitted;
+}
+
+bool renderer_fence_signalled(renderer_fence_t fence)
+{
+    return (int32_t)(*fence_semaphore - fence) >= 0;
+}
 
-    while (pb_busy()) {
-        Sleep(0);
+// The GPU only ever waits on a swap until vertical blank, so a fence that hasn't passed yet is checked again on each
+// vertical blank interrupt rather than polled
+void renderer_fence_wait(renderer_fence_t fence)
+{
+    while (!renderer_fence_signalled(fence)) {
+        pb_wait_for_vbl();
     }
+}
 
+void renderer_present(void)
+{
+    profiler_begin(PROFILER_STAGE_SUBMIT);
+    renderer_batch_flush();
+    const renderer_fence_t fence = renderer_fence_insert();
+    state_stats_presented = state_stats;
+    profiler_end(PROFILER_STAGE_SUBMIT);
+
+    // Time spent blocked until a back buffer swap could be queued. Pending swaps only retire on vertical blank
+    profiler_begin(PROFILER_STAGE_CPU_WAIT);
     while (pb_finished()) {
-        Sleep(0);
+        pb_wait_for_vbl();
+    }
+    profiler_end(PROFILER_STAGE_CPU_WAIT);
+
+    // Time spent blocked until the GPU has worked through this frame, so the next one can reuse the vertex buffer.
+    // The swap queued above comes after the fence, so this doesn't wait for it to retire.
+    profiler_begin(PROFILER_STAGE_GPU_WAIT);
+    renderer_fence_wait(fence);
+    profiler_end(PROFILER_STAGE_GPU_WAIT);
+}
+
+// Blocks until the next vertical blank, for frame pacing below the refresh rate
+void renderer_wait_for_vblank(void)
+{
+    pb_wait_for_vbl();
+}
+
+static inline size_t texture_data_size(const xgu_texture_t *texture)
+{
+    switch (texture->format) {
+        case XGU_TEXTURE_FORMAT_DXT1:
+            return (texture->data_width / 4) * (texture->data_height / 4) * 8;
+        case XGU_TEXTURE_FORMAT_DXT5:
+            return (texture->data_width / 4) * (texture->data_height / 4) * 16;
+        default:
+            return texture->data_width * texture->data_height * texture->bytes_per_pixel;
     }
 }
 
@@ -284,17 +858,39 @@ static inline void shader_init()
         | MASK(NV097_SET_COMBINER_ALPHA_ICW_C_SOURCE, 0x0) | MASK(NV097_SET_COMBINER_ALPHA_ICW_C_ALPHA, 1) | MASK(NV097_SET_COMBINER_ALPHA_ICW_C_MAP, 0x0)
         | MASK(NV097_SET_COMBINER_ALPHA_ICW_D_SOURCE, 0x0) | MASK(NV097_SET_COMBINER_ALPHA_ICW_D_ALPHA, 1) | MASK(NV097_SET_COMBINER_ALPHA_ICW_D_MAP, 0x0));
     p += 2;
-    pb_push1(p, NV097_SET_COMBINER_ALPHA_OCW + 0 * 4,
+
+    // The second stage is only enabled for distance field textures. It clamps the thresholded distance that the first
+    // stage left in spare0 and multiplies it with the diffuse alpha, colour passes straight through
+    pb_push1(p, NV097_SET_COMBINER_COLOR_ICW + 1 * 4,
+    MASK(NV097_SET_COMBINER_COLOR_ICW_A_SOURCE, 0x4) | MASK(NV097_SET_COMBINER_COLOR_ICW_A_ALPHA, 0) | MASK(NV097_SET_COMBINER_COLOR_ICW_A_MAP, 0x6)
+    | MASK(NV097_SET_COMBINER_COLOR_ICW_B_SOURCE, 0x0) | MASK(NV097_SET_COMBINER_COLOR_ICW_B_ALPHA, 0) | MASK(NV097_SET_COMBINER_COLOR_ICW_B_MAP, 0x1)
+    | MASK(NV097_SET_COMBINER_COLOR_ICW_C_SOURCE, 0x0) | MASK(NV097_SET_COMBINER_COLOR_ICW_C_ALPHA, 0) | MASK(NV097_SET_COMBINER_COLOR_ICW_C_MAP, 0x0)
+    | MASK(NV097_SET_COMBINER_COLOR_ICW_D_SOURCE, 0x0) | MASK(NV097_SET_COMBINER_COLOR_ICW_D_ALPHA, 0) | MASK(NV097_SET_COMBINER_COLOR_ICW_D_MAP, 0x0));
+    p += 2;
+    pb_push1(p, NV097_SET_COMBINER_COLOR_OCW + 1 * 4,
+        MASK(NV097_SET_COMBINER_COLOR_OCW_AB_DST, 0x4)
+        | MASK(NV097_SET_COMBINER_COLOR_OCW_CD_DST, 0x0)
+        | MASK(NV097_SET_COMBINER_COLOR_OCW_SUM_DST, 0x0)
+        | MASK(NV097_SET_COMBINER_COLOR_OCW_MUX_ENABLE, 0)
+        | MASK(NV097_SET_COMBINER_COLOR_OCW_AB_DOT_ENABLE, 0)
+        | MASK(NV097_SET_COMBINER_COLOR_OCW_CD_DOT_ENABLE, 0)
+        | MASK(NV097_SET_COMBINER_COLOR_OCW_OP, NV097_SET_COMBINER_COLOR_OCW_OP_NOSHIFT));
+    p += 2;
+    pb_push1(p, NV097_SET_COMBINER_ALPHA_ICW + 1 * 4,
+        MASK(NV097_SET_COMBINER_ALPHA_ICW_A_SOURCE, 0xC) | MASK(NV097_SET_COMBINER_ALPHA_ICW_A_ALPHA, 1) | MASK(NV097_SET_COMBINER_ALPHA_ICW_A_MAP, 0x0)
+        | MASK(NV097_SET_COMBINER_ALPHA_ICW_B_SOURCE, 0x4) | MASK(NV097_SET_COMBINER_ALPHA_ICW_B_ALPHA, 1) | MASK(NV097_SET_COMBINER_ALPHA_ICW_B_MAP, 0x6)
+        | MASK(NV097_SET_COMBINER_ALPHA_ICW_C_SOURCE, 0x0) | MASK(NV097_SET_COMBINER_ALPHA_ICW_C_ALPHA, 1) | MASK(NV097_SET_COMBINER_ALPHA_ICW_C_MAP, 0x0)
+        | MASK(NV097_SET_COMBINER_ALPHA_ICW_D_SOURCE, 0x0) | MASK(NV097_SET_COMBINER_ALPHA_ICW_D_ALPHA, 1) | MASK(NV097_SET_COMBINER_ALPHA_ICW_D_MAP, 0x0));
+    p += 2;
+    pb_push1(p, NV097_SET_COMBINER_ALPHA_OCW + 1 * 4,
         MASK(NV097_SET_COMBINER_ALPHA_OCW_AB_DST, 0x4)
         | MASK(NV097_SET_COMBINER_ALPHA_OCW_CD_DST, 0x0)
         | MASK(NV097_SET_COMBINER_ALPHA_OCW_SUM_DST, 0x0)
         | MASK(NV097_SET_COMBINER_ALPHA_OCW_MUX_ENABLE, 0)
         | MASK(NV097_SET_COMBINER_ALPHA_OCW_OP, NV097_SET_COMBINER_ALPHA_OCW_OP_NOSHIFT));
     p += 2;
-    pb_push1(p, NV097_SET_COMBINER_CONTROL,
-        MASK(NV097_SET_COMBINER_CONTROL_FACTOR0, NV097_SET_COMBINER_CONTROL_FACTOR0_SAME_FACTOR_ALL)
-        | MASK(NV097_SET_COMBINER_CONTROL_FACTOR1, NV097_SET_COMBINER_CONTROL_FACTOR1_SAME_FACTOR_ALL)
-        | MASK(NV097_SET_COMBINER_CONTROL_ITERATION_COUNT, 1));
+    // Bias that puts the distance field outline at 0.5 after the first stage's shift, see distance_field_shader_apply
+    pb_push1(p, NV097_SET_COMBINER_FACTOR0 + 0 * 4, 0x1F000000);
     p += 2;
     pb_push1(p, NV097_SET_COMBINER_SPECULAR_FOG_CW0,
         MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW0_A_SOURCE, 0x0) | MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW0_A_ALPHA, 0) | MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW0_A_INVERSE, 0)
@@ -345,4 +941,43 @@ static inline void texture_shader_apply ()
         | MASK(NV097_SET_COMBINER_ALPHA_ICW_C_SOURCE, 0x0) | MASK(NV097_SET_COMBINER_ALPHA_ICW_C_ALPHA, 1) | MASK(NV097_SET_COMBINER_ALPHA_ICW_C_MAP, 0x0)
         | MASK(NV097_SET_COMBINER_ALPHA_ICW_D_SOURCE, 0x0) | MASK(NV097_SET_COMBINER_ALPHA_ICW_D_ALPHA, 1) | MASK(NV097_SET_COMBINER_ALPHA_ICW_D_MAP, 0x0));
 }
+
+// Distance field alpha is expanded to [-1, 1] so the outline is at 0, then (a * 1 + c0 * 1) << 2 scales the edge to be
+// about one pixel wide at the atlas size and moves the outline back to 0.5. The result goes to spare0 for the second stage.
+static inline void distance_field_shader_apply ()
+{
+    p = pb_push1(p, NV097_SET_SHADER_OTHER_STAGE_INPUT, 0);
+    p = pb_push1(p, NV097_SET_SHADER_STAGE_PROGRAM, MASK(NV097_SET_SHADER_STAGE_PROGRAM_STAGE0, NV097_SET_SHADER_STAGE_PROGRAM_STAGE0_2D_PROJECTIVE));
+
+    p = pb_push1(p, NV097_SET_COMBINER_COLOR_ICW + 0 * 4,
+    MASK(NV097_SET_COMBINER_COLOR_ICW_A_SOURCE, 0x4) | MASK(NV097_SET_COMBINER_COLOR_ICW_A_ALPHA, 0) | MASK(NV097_SET_COMBINER_COLOR_ICW_A_MAP, 0x6)
+    | MASK(NV097_SET_COMBINER_COLOR_ICW_B_SOURCE, 0x0) | MASK(NV097_SET_COMBINER_COLOR_ICW_B_ALPHA, 0) | MASK(NV097_SET_COMBINER_COLOR_ICW_B_MAP, 0x1)
+    | MASK(NV097_SET_COMBINER_COLOR_ICW_C_SOURCE, 0x0) | MASK(NV097_SET_COMBINER_COLOR_ICW_C_ALPHA, 0) | MASK(NV097_SET_COMBINER_COLOR_ICW_C_MAP, 0x0)
+    | MASK(NV097_SET_COMBINER_COLOR_ICW_D_SOURCE, 0x0) | MASK(NV097_SET_COMBINER_COLOR_ICW_D_ALPHA, 0) | MASK(NV097_SET_COMBINER_COLOR_ICW_D_MAP, 0x0));
+
+    p = pb_push1(p, NV097_SET_COMBINER_ALPHA_ICW + 0 * 4,
+        MASK(NV097_SET_COMBINER_ALPHA_ICW_A_SOURCE, 0x8) | MASK(NV097_SET_COMBINER_ALPHA_ICW_A_ALPHA, 1) | MASK(NV097_SET_COMBINER_ALPHA_ICW_A_MAP, 0x2)
+        | MASK(NV097_SET_COMBINER_ALPHA_ICW_B_SOURCE, 0x0) | MASK(NV097_SET_COMBINER_ALPHA_ICW_B_ALPHA, 1) | MASK(NV097_SET_COMBINER_ALPHA_ICW_B_MAP, 0x1)
+        | MASK(NV097_SET_COMBINER_ALPHA_ICW_C_SOURCE, 0x1) | MASK(NV097_SET_COMBINER_ALPHA_ICW_C_ALPHA, 1) | MASK(NV097_SET_COMBINER_ALPHA_ICW_C_MAP, 0x0)
+        | MASK(NV097_SET_COMBINER_ALPHA_ICW_D_SOURCE, 0x0) | MASK(NV097_SET_COMBINER_ALPHA_ICW_D_ALPHA, 1) | MASK(NV097_SET_COMBINER_ALPHA_ICW_D_MAP, 0x1));
+}
+
+// The first stage's alpha output and the number of stages differ between distance field textures and everything else
+static inline void combiner_output_apply(bool distance_field)
+{
+    const uint32_t alpha_ocw = (distance_field) ?
+        MASK(NV097_SET_COMBINER_ALPHA_OCW_SUM_DST, 0xC) | MASK(NV097_SET_COMBINER_ALPHA_OCW_OP, NV097_SET_COMBINER_ALPHA_OCW_OP_SHIFTLEFTBY2) :
+        MASK(NV097_SET_COMBINER_ALPHA_OCW_AB_DST, 0x4) | MASK(NV097_SET_COMBINER_ALPHA_OCW_OP, NV097_SET_COMBINER_ALPHA_OCW_OP_NOSHIFT);
+    if (state_update(STATE_COMBINER_ALPHA_OCW0, alpha_ocw, 1)) {
+        p = pb_push1(p, NV097_SET_COMBINER_ALPHA_OCW + 0 * 4, alpha_ocw);
+    }
+
+    const uint32_t control =
+        MASK(NV097_SET_COMBINER_CONTROL_FACTOR0, NV097_SET_COMBINER_CONTROL_FACTOR0_SAME_FACTOR_ALL)
+        | MASK(NV097_SET_COMBINER_CONTROL_FACTOR1, NV097_SET_COMBINER_CONTROL_FACTOR1_SAME_FACTOR_ALL)
+        | MASK(NV097_SET_COMBINER_CONTROL_ITERATION_COUNT, (distance_field) ? 2 : 1);
+    if (state_update(STATE_COMBINER_CONTROL, control, 1)) {
+        p = pb_push1(p, NV097_SET_COMBINER_CONTROL, control);
+    }
+}
 // clang-format on
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <xgu/xgu.h>
 #include <xgu/xgux.h>
@@ -10,10 +12,13 @@ typedef struct xgu_texture
     uint32_t data_height;
     uint32_t tex_width;
     uint32_t tex_height;
-    uint32_t bytes_per_pixel;
+    uint32_t bytes_per_pixel; // 0 for block compressed formats
     XguTexFormatColor format;
     uint8_t *data;
     uint8_t *data_physical_address;
+    uint32_t palette_length;
+    uint8_t *palette_physical_address;
+    bool distance_field; // A8 signed distance field, alpha is thresholded at 0.5 when drawn
 } xgu_texture_t;
 
 typedef struct xgu_texture_boundary
@@ -32,6 +37,16 @@ typedef struct xgu_texture_tint
     uint8_t a;
 } xgu_texture_tint_t;
 
+// Sequence number of a point in the push buffer. It is signalled once the GPU has consumed everything before it.
+typedef uint32_t renderer_fence_t;
+
+// Methods setting renderer state over one frame. Suppressed methods would have written a value the register already held.
+typedef struct renderer_state_stats
+{
+    uint32_t methods_emitted;
+    uint32_t methods_suppressed;
+} renderer_state_stats_t;
+
 void renderer_initialise(void);
 void renderer_start(void);
 void renderer_set_scissor(int x, int y, int width, int height);
@@ -39,6 +54,35 @@ void renderer_draw_rectangle(int x, int y, int width, int height, const xgu_text
 void renderer_draw_textured_rectangle(int x, int y, int width, int height,
                                       const xgu_texture_t *texture, const xgu_texture_tint_t *tint, const xgu_texture_boundary_t *boundary);
 void renderer_present(void);
+void renderer_wait_for_vblank(void);
+uint32_t renderer_frame_count(void);
+
+renderer_fence_t renderer_fence_insert(void);
+bool renderer_fence_signalled(renderer_fence_t fence);
+void renderer_fence_wait(renderer_fence_t fence);
+
+// Statistics of the last frame passed to renderer_present
+void renderer_get_state_stats(renderer_state_stats_t *stats);
+
+// Textured quads sharing the same texture and tint are accumulated and submitted in a single draw call.
+// The batch is flushed automatically on texture, tint, combiner or scissor changes and at present.
+void renderer_batch_begin(const xgu_texture_t *texture, const xgu_texture_tint_t *tint);
+void renderer_batch_add_quad(int x, int y, int width, int height, const xgu_texture_boundary_t *boundary);
+void renderer_batch_flush(void);
+
+// A list records textured quads once so drawing it again only costs its state changes and draw calls, for screen
+// content that rarely changes. Recorded textures must outlive the list and glyphs must not come from a dynamic atlas.
+// A quad's texture boundary can be patched in place, but not after the list has been drawn in the current frame.
+typedef struct renderer_list renderer_list_t;
+
+renderer_list_t *renderer_list_create(int max_quads);
+void renderer_list_destroy(renderer_list_t *list);
+void renderer_list_begin(renderer_list_t *list);
+void renderer_list_end(void);
+void renderer_list_draw(const renderer_list_t *list);
+void renderer_list_set_boundary(renderer_list_t *list, int quad_index, const xgu_texture_boundary_t *boundary);
 
 xgu_texture_t *texture_create(const void *texture_data, uint32_t width, uint32_t height, XguTexFormatColor format);
+xgu_texture_t *texture_create_from_asset(const void *asset_data, size_t asset_size);
+void texture_update(xgu_texture_t *texture, uint32_t x, uint32_t y, uint32_t width, uint32_t height, const void *texture_data);
 void texture_destroy(xgu_texture_t *texture);
\ No newline at end of file
@@ -0,0 +1,650 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "support_renderer_soft.h"
+#include "support_texture_asset.h"
+
+// Pixels are packed as R8G8B8A8 bytes, so red is in the low byte of a little endian uint32_t
+#define PACK_RGBA(r, g, b, a) ((uint32_t)(r) | (uint32_t)(g) << 8 | (uint32_t)(b) << 16 | (uint32_t)(a) << 24)
+
+static uint32_t framebuffer[RENDERER_SOFT_WIDTH * RENDERER_SOFT_HEIGHT];
+static uint32_t frame_count = 0;
+static renderer_fence_t fence_submitted = 0;
+static renderer_soft_stats_t stats;
+
+static int scissor_x0 = 0;
+static int scissor_y0 = 0;
+static int scissor_x1 = RENDERER_SOFT_WIDTH;
+static int scissor_y1 = RENDERER_SOFT_HEIGHT;
+
+// Quads are rasterised as soon as they are added, the batch state is only kept to count draw calls the same
+// way support_renderer.c would submit them.
+static const xgu_texture_t *batch_texture = NULL;
+static xgu_texture_tint_t batch_tint;
+static int batch_count;
+
+// Lists store their quads and rasterise them again each time they are drawn
+typedef struct renderer_list_quad
+{
+    const xgu_texture_t *texture;
+    xgu_texture_tint_t tint;
+    int x;
+    int y;
+    int width;
+    int height;
+    xgu_texture_boundary_t boundary;
+} renderer_list_quad_t;
+
+struct renderer_list
+{
+    int max_quads;
+    int quad_count;
+    int draw_count;
+    renderer_list_quad_t *quad;
+};
+
+static renderer_list_t *list_recording = NULL;
+
+static inline uint32_t npot2pot(uint32_t num)
+{
+    uint32_t pot = 1;
+    while (pot < num) {
+        pot <<= 1;
+    }
+    return pot;
+}
+
+// Matches the swizzle used by tools/texture_encoder
+static uint32_t swizzle_offset(uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+    uint32_t offset = 0, bit = 0;
+    for (uint32_t mask = 1; mask < width || mask < height; mask <<= 1) {
+        if (mask < width) {
+            offset |= ((x & mask) ? 1u : 0u) << bit++;
+        }
+        if (mask < height) {
+            offset |= ((y & mask) ? 1u : 0u) << bit++;
+        }
+    }
+    return offset;
+}
+
+static void rgb_from_565(uint16_t v, uint32_t *c)
+{
+    c[0] = ((v >> 11) & 0x1F) * 255 / 31;
+    c[1] = ((v >> 5) & 0x3F) * 255 / 63;
+    c[2] = (v & 0x1F) * 255 / 31;
+}
+
+static void decode_dxt_block(const uint8_t *block, bool dxt5, uint32_t out[16])
+{
+    uint8_t alpha[16];
+    if (dxt5) {
+        uint32_t a[8] = {block[0], block[1]};
+        if (a[0] > a[1]) {
+            for (int k = 1; k < 7; k++) {
+                a[k + 1] = ((7 - k) * a[0] + k * a[1]) / 7;
+            }
+        } else {
+            for (int k = 1; k < 5; k++) {
+                a[k + 1] = ((5 - k) * a[0] + k * a[1]) / 5;
+            }
+            a[6] = 0;
+            a[7] = 255;
+        }
+
+        uint64_t indices = 0;
+        for (int i = 0; i < 6; i++) {
+            indices |= (uint64_t)block[2 + i] << (i * 8);
+        }
+        for (int i = 0; i < 16; i++) {
+            alpha[i] = (uint8_t)a[(indices >> (i * 3)) & 0x7];
+        }
+        block += 8;
+    } else {
+        memset(alpha, 255, sizeof(alpha));
+    }
+
+    const uint16_t c0 = block[0] | block[1] << 8;
+    const uint16_t c1 = block[2] | block[3] << 8;
+    uint32_t colour[4][4];
+    rgb_from_565(c0, colour[0]);
+    rgb_from_565(c1, colour[1]);
+    colour[0][3] = colour[1][3] = colour[2][3] = colour[3][3] = 255;
+    for (int k = 0; k < 3; k++) {
+        // Colour blocks of DXT5 textures are always decoded in four colour mode
+        if (dxt5 || c0 > c1) {
+            colour[2][k] = (2 * colour[0][k] + colour[1][k]) / 3;
+            colour[3][k] = (colour[0][k] + 2 * colour[1][k]) / 3;
+        } else {
+            colour[2][k] = (colour[0][k] + colour[1][k]) / 2;
+            colour[3][k] = 0;
+        }
+    }
+    if (!dxt5 && c0 <= c1) {
+        colour[3][3] = 0;
+    }
+
+    uint32_t indices;
+    memcpy(&indices, &block[4], 4);
+    for (int i = 0; i < 16; i++) {
+        const uint32_t *c = colour[(indices >> (i * 2)) & 0x3];
+        out[i] = PACK_RGBA(c[0], c[1], c[2], dxt5 ? alpha[i] : c[3]);
+    }
+}
+
+static xgu_texture_t *texture_allocate(uint32_t width, uint32_t height, XguTexFormatColor format, uint32_t bytes_per_pixel)
+{
+    xgu_texture_t *xgu_texture = malloc(sizeof(xgu_texture_t));
+    xgu_texture->tex_width = width;
+    xgu_texture->tex_height = height;
+    xgu_texture->data_width = npot2pot(width);
+    xgu_texture->data_height = npot2pot(height);
+    xgu_texture->bytes_per_pixel = bytes_per_pixel;
+    xgu_texture->format = format;
+    xgu_texture->data = calloc(xgu_texture->data_width * xgu_texture->data_height, bytes_per_pixel);
+    xgu_texture->data_physical_address = xgu_texture->data;
+    xgu_texture->palette_length = 0;
+    xgu_texture->palette_physical_address = NULL;
+    xgu_texture->distance_field = false;
+    return xgu_texture;
+}
+
+// Every texture is kept in one of the linear formats so sampling only has to deal with those. Swizzled and
+// compressed data is converted to linear on creation.
+xgu_texture_t *texture_create(const void *texture_data, uint32_t width, uint32_t height, XguTexFormatColor format)
+{
+    XguTexFormatColor linear_format;
+    uint32_t bytes_per_pixel;
+    switch (format) {
+        case XGU_TEXTURE_FORMAT_A8:
+        case XGU_TEXTURE_FORMAT_A8_SWIZZLED:
+            linear_format = XGU_TEXTURE_FORMAT_A8;
+            bytes_per_pixel = 1;
+            break;
+        case XGU_TEXTURE_FORMAT_R5G6B5:
+        case XGU_TEXTURE_FORMAT_R5G6B5_SWIZZLED:
+            linear_format = XGU_TEXTURE_FORMAT_R5G6B5;
+            bytes_per_pixel = 2;
+            break;
+        case XGU_TEXTURE_FORMAT_R8G8B8A8:
+        case XGU_TEXTURE_FORMAT_R8G8B8A8_SWIZZLED:
+            linear_format = XGU_TEXTURE_FORMAT_R8G8B8A8;
+            bytes_per_pixel = 4;
+            break;
+        case XGU_TEXTURE_FORMAT_A8B8G8R8:
+        case XGU_TEXTURE_FORMAT_A8B8G8R8_SWIZZLED:
+        case XGU_TEXTURE_FORMAT_DXT1:
+        case XGU_TEXTURE_FORMAT_DXT5:
+            linear_format = XGU_TEXTURE_FORMAT_A8B8G8R8;
+            bytes_per_pixel = 4;
+            break;
+        default:
+            return NULL;
+    }
+
+    xgu_texture_t *xgu_texture = texture_allocate(width, height, linear_format, bytes_per_pixel);
+    if (texture_data == NULL) {
+        return xgu_texture;
+    }
+
+    const uint8_t *source8 = (const uint8_t *)texture_data;
+    const uint32_t data_width = xgu_texture->data_width;
+    const uint32_t data_height = xgu_texture->data_height;
+    uint8_t *destination8 = xgu_texture->data;
+
+    if (format == XGU_TEXTURE_FORMAT_DXT1 || format == XGU_TEXTURE_FORMAT_DXT5) {
+        const bool dxt5 = (format == XGU_TEXTURE_FORMAT_DXT5);
+        const uint32_t block_width = (data_width < 4) ? 1 : data_width / 4;
+        const uint32_t block_height = (data_height < 4) ? 1 : data_height / 4;
+        for (uint32_t by = 0; by < block_height; by++) {
+            for (uint32_t bx = 0; bx < block_width; bx++) {
+                uint32_t texels[16];
+                decode_dxt_block(&source8[(by * block_width + bx) * (dxt5 ? 16 : 8)], dxt5, texels);
+                for (int i = 0; i < 16; i++) {
+                    uint32_t x = bx * 4 + (i & 3), y = by * 4 + (i >> 2);
+                    if (x < data_width && y < data_height) {
+                        memcpy(&destination8[(y * data_width + x) * 4], &texels[i], 4);
+                    }
+                }
+            }
+        }
+    } else if (format != linear_format) {
+        for (uint32_t y = 0; y < data_height; y++) {
+            for (uint32_t x = 0; x < data_width; x++) {
+                memcpy(&destination8[(y * data_width + x) * bytes_per_pixel],
+                       &source8[swizzle_offset(x, y, data_width, data_height) * bytes_per_pixel], bytes_per_pixel);
+            }
+        }
+    } else {
+        const uint32_t data_stride = data_width * bytes_per_pixel;
+        const uint32_t texture_stride = width * bytes_per_pixel;
+        for (uint32_t i = 0; i < height; i++) {
+            memcpy(&destination8[i * data_stride], &source8[i * texture_stride], texture_stride);
+        }
+    }
+    return xgu_texture;
+}
+
+xgu_texture_t *texture_create_from_asset(const void *asset_data, size_t asset_size)
+{
+    const texture_asset_header_t *header = (const texture_asset_header_t *)asset_data;
+    if (asset_size < sizeof(texture_asset_header_t) || header->magic != TEXTURE_ASSET_MAGIC ||
+        header->version != TEXTURE_ASSET_VERSION) {
+        return NULL;
+    }
+
+    const uint32_t *palette = (const uint32_t *)(header + 1);
+    const uint8_t *texel_data = (const uint8_t *)(palette + header->palette_count);
+    if ((const uint8_t *)asset_data + asset_size < texel_data + header->data_size) {
+        return NULL;
+    }
+
+    switch (header->format) {
+        case TEXTURE_ASSET_FORMAT_A8B8G8R8:
+            return texture_create(texel_data, header->width, header->height, XGU_TEXTURE_FORMAT_A8B8G8R8);
+        case TEXTURE_ASSET_FORMAT_A8B8G8R8_SWIZZLED:
+            return texture_create(texel_data, header->width, header->height, XGU_TEXTURE_FORMAT_A8B8G8R8_SWIZZLED);
+        case TEXTURE_ASSET_FORMAT_DXT1:
+            return texture_create(texel_data, header->width, header->height, XGU_TEXTURE_FORMAT_DXT1);
+        case TEXTURE_ASSET_FORMAT_DXT5:
+            return texture_create(texel_data, header->width, header->height, XGU_TEXTURE_FORMAT_DXT5);
+        case TEXTURE_ASSET_FORMAT_P8_SWIZZLED:
+            break;
+        default:
+            return NULL;
+    }
+
+    // Paletted textures are expanded to A8B8G8R8, the palette entries are A8R8G8B8
+    if (header->palette_count != 256) {
+        return NULL;
+    }
+    xgu_texture_t *xgu_texture = texture_allocate(header->width, header->height, XGU_TEXTURE_FORMAT_A8B8G8R8, 4);
+    uint32_t *destination32 = (uint32_t *)xgu_texture->data;
+    for (uint32_t y = 0; y < xgu_texture->data_height; y++) {
+        for (uint32_t x = 0; x < xgu_texture->data_width; x++) {
+            const uint32_t argb = palette[texel_data[swizzle_offset(x, y, xgu_texture->data_width, xgu_texture->data_height)]];
+            destination32[y * xgu_texture->data_width + x] =
+                PACK_RGBA((argb >> 16) & 0xFF, (argb >> 8) & 0xFF, argb & 0xFF, argb >> 24);
+        }
+    }
+    return xgu_texture;
+}
+
+void texture_update(xgu_texture_t *texture, uint32_t x, uint32_t y, uint32_t width, uint32_t height, const void *texture_data)
+{
+    assert(x + width <= texture->tex_width && y + height <= texture->tex_height);
+
+    const uint8_t *source8 = (const uint8_t *)texture_data;
+    const uint32_t data_stride = texture->data_width * texture->bytes_per_pixel;
+    const uint32_t texture_stride = width * texture->bytes_per_pixel;
+    uint8_t *destination8 = &texture->data[y * data_stride + x * texture->bytes_per_pixel];
+    for (uint32_t i = 0; i < height; i++) {
+        memcpy(&destination8[i * data_stride], &source8[i * texture_stride], texture_stride);
+    }
+}
+
+void texture_destroy(xgu_texture_t *texture)
+{
+    free(texture->data);
+    free(texture);
+}
+
+static inline uint32_t texel_fetch(const xgu_texture_t *texture, uint32_t x, uint32_t y)
+{
+    const uint8_t *texel = &texture->data[(y * texture->data_width + x) * texture->bytes_per_pixel];
+    switch (texture->format) {
+        case XGU_TEXTURE_FORMAT_A8:
+            // Alpha only textures sample as white so the tint sets the colour
+            return PACK_RGBA(255, 255, 255, texel[0]);
+        case XGU_TEXTURE_FORMAT_R5G6B5: {
+            uint32_t c[3];
+            rgb_from_565(texel[0] | texel[1] << 8, c);
+            return PACK_RGBA(c[0], c[1], c[2], 255);
+        }
+        case XGU_TEXTURE_FORMAT_R8G8B8A8:
+            return PACK_RGBA(texel[3], texel[2], texel[1], texel[0]);
+        default: {
+            uint32_t rgba;
+            memcpy(&rgba, texel, 4);
+            return rgba;
+        }
+    }
+}
+
+// Distance fields are bilinear filtered as on the hardware, point sampling would leave magnified outlines stepped.
+// The threshold matches the combiner in support_renderer.c, clamp((a - 112) * 8) keeps the outline at 128.
+static uint32_t distance_field_fetch(const xgu_texture_t *texture, float s, float t)
+{
+    const int max_x = (int)texture->data_width - 1;
+    const int max_y = (int)texture->data_height - 1;
+    s -= 0.5f;
+    t -= 0.5f;
+    const int sx = (int)floorf(s);
+    const int sy = (int)floorf(t);
+    const float fx = s - sx;
+    const float fy = t - sy;
+    const int x0 = (sx < 0) ? 0 : (sx > max_x) ? max_x : sx;
+    const int y0 = (sy < 0) ? 0 : (sy > max_y) ? max_y : sy;
+    const int x1 = (sx + 1 < 0) ? 0 : (sx + 1 > max_x) ? max_x : sx + 1;
+    const int y1 = (sy + 1 < 0) ? 0 : (sy + 1 > max_y) ? max_y : sy + 1;
+
+    const uint8_t *data = texture->data;
+    const float top = data[y0 * texture->data_width + x0] * (1.0f - fx) + data[y0 * texture->data_width + x1] * fx;
+    const float bottom = data[y1 * texture->data_width + x0] * (1.0f - fx) + data[y1 * texture->data_width + x1] * fx;
+    const int a = (int)((top * (1.0f - fy) + bottom * fy - 112.0f) * 8.0f);
+    return PACK_RGBA(255, 255, 255, (a < 0) ? 0 : (a > 255) ? 255 : a);
+}
+
+// x / 255 rounded to nearest, exact for every product of two 8-bit values
+static inline uint32_t div255(uint32_t x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+// Modulates each source pixel by the tint then blends it over the destination with
+// src * src_alpha + dst * (1 - src_alpha), the same as the blend state set up in support_renderer.c.
+// The SIMD and scalar paths produce identical results so golden images match on any host.
+static void blend_span(uint32_t *destination, const uint32_t *source, int count, const xgu_texture_tint_t *tint)
+{
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128i full = _mm_set1_epi16(255);
+    const __m128i tint16 = _mm_set_epi16(tint->a, tint->b, tint->g, tint->r, tint->a, tint->b, tint->g, tint->r);
+
+#define DIV255_EPI16(x) _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16((x), bias), _mm_srli_epi16(_mm_add_epi16((x), bias), 8)), 8)
+
+    for (; i + 4 <= count; i += 4) {
+        const __m128i s = _mm_loadu_si128((const __m128i *)&source[i]);
+        const __m128i d = _mm_loadu_si128((const __m128i *)&destination[i]);
+
+        __m128i s_lo = _mm_unpacklo_epi8(s, zero);
+        __m128i s_hi = _mm_unpackhi_epi8(s, zero);
+        s_lo = DIV255_EPI16(_mm_mullo_epi16(s_lo, tint16));
+        s_hi = DIV255_EPI16(_mm_mullo_epi16(s_hi, tint16));
+
+        // Broadcast each pixel's alpha across its four channels
+        const __m128i a_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        const __m128i a_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+        const __m128i d_lo = _mm_unpacklo_epi8(d, zero);
+        const __m128i d_hi = _mm_unpackhi_epi8(d, zero);
+        const __m128i o_lo = _mm_add_epi16(_mm_mullo_epi16(s_lo, a_lo), _mm_mullo_epi16(d_lo, _mm_sub_epi16(full, a_lo)));
+        const __m128i o_hi = _mm_add_epi16(_mm_mullo_epi16(s_hi, a_hi), _mm_mullo_epi16(d_hi, _mm_sub_epi16(full, a_hi)));
+
+        _mm_storeu_si128((__m128i *)&destination[i], _mm_packus_epi16(DIV255_EPI16(o_lo), DIV255_EPI16(o_hi)));
+    }
+
+#undef DIV255_EPI16
+#endif
+
+    const uint32_t t[4] = {tint->r, tint->g, tint->b, tint->a};
+    for (; i < count; i++) {
+        uint32_t s[4], out = 0;
+        for (int c = 0; c < 4; c++) {
+            s[c] = div255(((source[i] >> (c * 8)) & 0xFF) * t[c]);
+        }
+        for (int c = 0; c < 4; c++) {
+            const uint32_t d = (destination[i] >> (c * 8)) & 0xFF;
+            out |= div255(s[c] * s[3] + d * (255 - s[3])) << (c * 8);
+        }
+        destination[i] = out;
+    }
+}
+
+// Rectangles are always axis aligned, so each row is a single span. Textures are point sampled at pixel centres,
+// except distance fields which need filtering to keep their edges smooth.
+static void rasterise_quad(int x, int y, int width, int height, const xgu_texture_t *texture,
+                           const xgu_texture_boundary_t *boundary, const xgu_texture_tint_t *tint)
+{
+    stats.quads++;
+
+    const int x0 = (x > scissor_x0) ? x : scissor_x0;
+    const int y0 = (y > scissor_y0) ? y : scissor_y0;
+    const int x1 = (x + width < scissor_x1) ? x + width : scissor_x1;
+    const int y1 = (y + height < scissor_y1) ? y + height : scissor_y1;
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    uint32_t span[RENDERER_SOFT_WIDTH];
+    const int span_length = x1 - x0;
+    if (texture == NULL) {
+        for (int i = 0; i < span_length; i++) {
+            span[i] = 0xFFFFFFFF;
+        }
+    }
+
+    const float ds = (texture) ? (boundary->s1 - boundary->s0) / width : 0.0f;
+    const float dt = (texture) ? (boundary->t1 - boundary->t0) / height : 0.0f;
+    for (int row = y0; row < y1; row++) {
+        if (texture && texture->distance_field) {
+            const float t = boundary->t0 + (row + 0.5f - y) * dt;
+            for (int i = 0; i < span_length; i++) {
+                span[i] = distance_field_fetch(texture, boundary->s0 + (x0 + i + 0.5f - x) * ds, t);
+            }
+        } else if (texture) {
+            int ty = (int)floorf(boundary->t0 + (row + 0.5f - y) * dt);
+            ty = (ty < 0) ? 0 : (ty >= (int)texture->data_height) ? (int)texture->data_height - 1 : ty;
+            for (int i = 0; i < span_length; i++) {
+                int tx = (int)floorf(boundary->s0 + (x0 + i + 0.5f - x) * ds);
+                tx = (tx < 0) ? 0 : (tx >= (int)texture->data_width) ? (int)texture->data_width - 1 : tx;
+                span[i] = texel_fetch(texture, tx, ty);
+            }
+        }
+        blend_span(&framebuffer[row * RENDERER_SOFT_WIDTH + x0], span, span_length, tint);
+    }
+    stats.pixels_blended += (uint64_t)span_length * (y1 - y0);
+}
+
+void renderer_initialise(void)
+{
+    memset(framebuffer, 0, sizeof(framebuffer));
+    renderer_set_scissor(0, 0, RENDERER_SOFT_WIDTH, RENDERER_SOFT_HEIGHT);
+}
+
+uint32_t renderer_frame_count(void)
+{
+    return frame_count;
+}
+
+void renderer_start(void)
+{
+    frame_count++;
+    for (int i = 0; i < RENDERER_SOFT_WIDTH * RENDERER_SOFT_HEIGHT; i++) {
+        framebuffer[i] = PACK_RGBA(0, 0, 0, 255);
+    }
+    batch_count = 0;
+    batch_texture = NULL;
+}
+
+void renderer_set_scissor(int x, int y, int width, int height)
+{
+    assert(list_recording == NULL);
+
+    const int x0 = (x < 0) ? 0 : x;
+    const int y0 = (y < 0) ? 0 : y;
+    const int x1 = (x + width > RENDERER_SOFT_WIDTH) ? RENDERER_SOFT_WIDTH : x + width;
+    const int y1 = (y + height > RENDERER_SOFT_HEIGHT) ? RENDERER_SOFT_HEIGHT : y + height;
+
+    // Like support_renderer.c, an unchanged scissor doesn't break the batch
+    if (x0 == scissor_x0 && y0 == scissor_y0 && x1 == scissor_x1 && y1 == scissor_y1) {
+        return;
+    }
+
+    renderer_batch_flush();
+    scissor_x0 = x0;
+    scissor_y0 = y0;
+    scissor_x1 = x1;
+    scissor_y1 = y1;
+}
+
+void renderer_draw_rectangle(int x, int y, int width, int height, const xgu_texture_tint_t *tint)
+{
+    assert(list_recording == NULL);
+    renderer_batch_flush();
+    rasterise_quad(x, y, width, height, NULL, NULL, tint);
+    stats.draw_calls++;
+}
+
+void renderer_draw_textured_rectangle(int x, int y, int width, int height, const xgu_texture_t *texture, const xgu_texture_tint_t *tint, const xgu_texture_boundary_t *boundary)
+{
+    const xgu_texture_boundary_t full_texture = {0.0f, (float)texture->tex_width, 0.0f, (float)texture->tex_height};
+
+    renderer_batch_begin(texture, tint);
+    renderer_batch_add_quad(x, y, width, height, (boundary) ? boundary : &full_texture);
+}
+
+void renderer_batch_begin(const xgu_texture_t *texture, const xgu_texture_tint_t *tint)
+{
+    const xgu_texture_tint_t white = {255, 255, 255, 255};
+    if (tint == NULL) {
+        tint = &white;
+    }
+
+    if (batch_count > 0 && batch_texture == texture && memcmp(&batch_tint, tint, sizeof(batch_tint)) == 0) {
+        return;
+    }
+
+    renderer_batch_flush();
+    batch_texture = texture;
+    batch_tint = *tint;
+}
+
+void renderer_batch_add_quad(int x, int y, int width, int height, const xgu_texture_boundary_t *boundary)
+{
+    assert(batch_texture != NULL);
+    if (list_recording != NULL) {
+        assert(list_recording->quad_count < list_recording->max_quads);
+        list_recording->quad[list_recording->quad_count++] = (renderer_list_quad_t){
+            batch_texture, batch_tint, x, y, width, height, *boundary};
+    } else {
+        rasterise_quad(x, y, width, height, batch_texture, boundary, &batch_tint);
+    }
+    batch_count++;
+}
+
+void renderer_batch_flush(void)
+{
+    if (batch_count == 0) {
+        return;
+    }
+    if (list_recording != NULL) {
+        list_recording->draw_count++;
+    } else {
+        stats.draw_calls++;
+    }
+    batch_count = 0;
+}
+
+renderer_list_t *renderer_list_create(int max_quads)
+{
+    renderer_list_t *list = malloc(sizeof(renderer_list_t));
+    if (list == NULL) {
+        return NULL;
+    }
+    list->quad = malloc(sizeof(renderer_list_quad_t) * max_quads);
+    if (list->quad == NULL) {
+        free(list);
+        return NULL;
+    }
+    list->max_quads = max_quads;
+    list->quad_count = 0;
+    list->draw_count = 0;
+    return list;
+}
+
+void renderer_list_destroy(renderer_list_t *list)
+{
+    free(list->quad);
+    free(list);
+}
+
+void renderer_list_begin(renderer_list_t *list)
+{
+    assert(list_recording == NULL);
+    renderer_batch_flush();
+    list->quad_count = 0;
+    list->draw_count = 0;
+    list_recording = list;
+}
+
+void renderer_list_end(void)
+{
+    assert(list_recording != NULL);
+    renderer_batch_flush();
+    list_recording = NULL;
+}
+
+void renderer_list_draw(const renderer_list_t *list)
+{
+    assert(list_recording == NULL);
+    renderer_batch_flush();
+    for (int i = 0; i < list->quad_count; i++) {
+        const renderer_list_quad_t *quad = &list->quad[i];
+        rasterise_quad(quad->x, quad->y, quad->width, quad->height, quad->texture, &quad->boundary, &quad->tint);
+    }
+    stats.draw_calls += list->draw_count;
+}
+
+void renderer_list_set_boundary(renderer_list_t *list, int quad_index, const xgu_texture_boundary_t *boundary)
+{
+    assert(quad_index >= 0 && quad_index < list->quad_count);
+    list->quad[quad_index].boundary = *boundary;
+}
+
+// Quads are rasterised synchronously, so a fence is already passed by the time it is inserted
+renderer_fence_t renderer_fence_insert(void)
+{
+    return ++fence_submitted;
+}
+
+bool renderer_fence_signalled(renderer_fence_t fence)
+{
+    (void)fence;
+    return true;
+}
+
+void renderer_fence_wait(renderer_fence_t fence)
+{
+    (void)fence;
+}
+
+void renderer_present(void)
+{
+    renderer_batch_flush();
+    renderer_fence_wait(renderer_fence_insert());
+}
+
+// There is no display to wait for
+void renderer_wait_for_vblank(void)
+{
+}
+
+// There is no push buffer, so nothing is emitted or suppressed
+void renderer_get_state_stats(renderer_state_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+}
+
+const uint32_t *renderer_soft_framebuffer(void)
+{
+    return framebuffer;
+}
+
+void renderer_soft_get_stats(renderer_soft_stats_t *out)
+{
+    *out = stats;
+}
+
+void renderer_soft_reset_stats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
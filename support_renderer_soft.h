@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "support_renderer.h"
+
+// Host only software implementation of support_renderer.h, used to measure rendering changes without NV2A hardware.
+// It rasterises into a CPU framebuffer of R8G8B8A8 bytes, the same layout as XGU_TEXTURE_FORMAT_A8B8G8R8.
+#define RENDERER_SOFT_WIDTH  640
+#define RENDERER_SOFT_HEIGHT 480
+
+typedef struct renderer_soft_stats
+{
+    uint64_t draw_calls;     // Batches that would have been submitted to the GPU
+    uint64_t quads;          // Rectangles drawn, textured or not
+    uint64_t pixels_blended; // Pixels that went through alpha blending after clipping
+} renderer_soft_stats_t;
+
+const uint32_t *renderer_soft_framebuffer(void);
+void renderer_soft_get_stats(renderer_soft_stats_t *stats);
+void renderer_soft_reset_stats(void);
@@ -0,0 +1,77 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <windows.h>
+
+#include "main.h"
+#include "support_startup.h"
+
+static uint64_t run_start_tick;
+
+static void task_execute(startup_task_t *task)
+{
+    for (int i = 0; i < STARTUP_TASK_MAX_DEPENDENCIES && task->dependency[i] != NULL; i++) {
+        WaitForSingleObject(task->dependency[i]->done_event, INFINITE);
+    }
+
+    const uint64_t start_tick = profiler_timestamp();
+    task->start_us = (uint32_t)profiler_elapsed_us(run_start_tick);
+    task->run();
+    task->duration_us = (uint32_t)profiler_elapsed_us(start_tick);
+
+    SetEvent(task->done_event);
+}
+
+static DWORD WINAPI task_thread(LPVOID lpParameter)
+{
+    task_execute((startup_task_t *)lpParameter);
+    return 0;
+}
+
+// Returns once every task has finished
+void startup_tasks_run(startup_task_t *tasks, int task_count)
+{
+    run_start_tick = profiler_timestamp();
+
+    for (int i = 0; i < task_count; i++) {
+        tasks[i].done_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+        assert(tasks[i].done_event != NULL);
+    }
+
+    // A task that can't get a worker thread falls back to running on this thread along with the main thread tasks
+    for (int i = 0; i < task_count; i++) {
+        tasks[i].thread = NULL;
+        if (!tasks[i].main_thread) {
+            tasks[i].thread = CreateThread(NULL, 0, task_thread, &tasks[i], 0, NULL);
+        }
+    }
+
+    for (int i = 0; i < task_count; i++) {
+        if (tasks[i].thread == NULL) {
+            task_execute(&tasks[i]);
+        }
+    }
+
+    for (int i = 0; i < task_count; i++) {
+        if (tasks[i].thread != NULL) {
+            WaitForSingleObject(tasks[i].thread, INFINITE);
+            CloseHandle(tasks[i].thread);
+            tasks[i].thread = NULL;
+        }
+        CloseHandle(tasks[i].done_event);
+        tasks[i].done_event = NULL;
+    }
+}
+
+void startup_tasks_log(const startup_task_t *tasks, int task_count)
+{
+    uint32_t end_us = 0;
+    for (int i = 0; i < task_count; i++) {
+        const startup_task_t *task = &tasks[i];
+        printf("Startup task %-12s started at %6u us, took %6u us%s\n", task->name, task->start_us, task->duration_us,
+               task->main_thread ? " (main thread)" : "");
+        if (task->start_us + task->duration_us > end_us) {
+            end_us = task->start_us + task->duration_us;
+        }
+    }
+    printf("Startup tasks finished after %u us\n", end_us);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <windows.h>
+
+#define STARTUP_TASK_MAX_DEPENDENCIES 4
+
+// One step of startup. Each task runs on its own worker thread once all of its dependencies have finished. Tasks
+// marked main_thread run on the thread that called startup_tasks_run instead, in array order, for work that has to
+// stay on the main thread.
+typedef struct startup_task
+{
+    const char *name;
+    void (*run)(void);
+    bool main_thread;
+    struct startup_task *dependency[STARTUP_TASK_MAX_DEPENDENCIES]; // Unused entries are NULL
+
+    // Filled in by startup_tasks_run
+    HANDLE thread;
+    HANDLE done_event;
+    uint32_t start_us; // Since startup_tasks_run was called
+    uint32_t duration_us;
+} startup_task_t;
+
+void startup_tasks_run(startup_task_t *tasks, int task_count);
+void startup_tasks_log(const startup_task_t *tasks, int task_count);
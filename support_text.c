@@ -1,88 +1,221 @@
 #include <SDL.h>
+#include <stb/stb_rect_pack.h>
 #include <stb/stb_truetype.h>
+#include <stdlib.h>
+#include <string.h>
 #include <xgu/xgu.h>
 #include <xgu/xgux.h>
 
 #include "main.h"
 #include "support_renderer.h"
+#include "support_text_atlas.h"
+#include "support_utf8.h"
 
-#define UTF8_IS_CONT(b)         (((b) & 0xC0) == 0x80)
-#define UTF8_MASK(b)            ((b) & 0x3F)
-#define UTF8_C2(b0, b1)         (((b0) & 0x1F) << 6 | UTF8_MASK(b1))
-#define UTF8_C3(b0, b1, b2)     (((b0) & 0x0F) << 12 | UTF8_MASK(b1) << 6 | UTF8_MASK(b2))
-#define UTF8_C4(b0, b1, b2, b3) (((b0) & 0x07) << 18 | UTF8_MASK(b1) << 12 | UTF8_MASK(b2) << 6 | UTF8_MASK(b3))
+// Text is decoded this many codepoints at a time into a buffer on the stack
+#define TEXT_DECODE_CHUNK 64
 
-static int utf8_decode(const char *s, int *len)
+// Returns the position of the codepoint in the font's packed glyph order, or -1 if it was not packed
+static int get_packed_char_index(Font *font, int unicode_codepoint)
 {
-    const unsigned char *p = (const unsigned char *)s;
-
-    if (p[0] < 0x80) {
-        *len = 1;
-        return p[0];
+    if (unicode_codepoint < 0x10000 && font->range_count > FONT_GLYPH_SCAN_RANGES) {
+        const uint16_t *page = font->glyph_page[unicode_codepoint / FONT_GLYPH_PAGE_SIZE];
+        if (page == NULL || page[unicode_codepoint % FONT_GLYPH_PAGE_SIZE] == FONT_GLYPH_NONE) {
+            return -1;
+        }
+        return page[unicode_codepoint % FONT_GLYPH_PAGE_SIZE];
     }
 
-    if ((p[0] & 0xE0) == 0xC0) {
-        if (!UTF8_IS_CONT(p[1])) {
-            return 0;
+    // Scanning a few ranges is quicker than the page table, which only fonts with more ranges get. Codepoints outside
+    // of the BMP are never in it
+    int offset = 0;
+    for (int i = 0; i < font->range_count; i++) {
+        stbtt_pack_range *range = &font->range[i];
+        if (unicode_codepoint >= range->first_unicode_codepoint_in_range &&
+            unicode_codepoint < range->first_unicode_codepoint_in_range + range->num_chars) {
+            return offset + unicode_codepoint - range->first_unicode_codepoint_in_range;
         }
-        *len = 2;
-        return UTF8_C2(p[0], p[1]);
+        offset += range->num_chars;
     }
+    return -1;
+}
 
-    if ((p[0] & 0xF0) == 0xE0) {
-        if (!UTF8_IS_CONT(p[1]) || !UTF8_IS_CONT(p[2])) {
-            return 0;
-        }
-        *len = 3;
-        return UTF8_C3(p[0], p[1], p[2]);
+static int get_glyph_advance(Font *font, int unicode_codepoint)
+{
+    int advance_width = 0;
+
+    int index = stbtt_FindGlyphIndex(&font->font_info, unicode_codepoint);
+    if (index == 0) {
+        // Subset fonts may not have the fallback either, then the advance of the missing glyph is used
+        index = stbtt_FindGlyphIndex(&font->font_info, '-');
     }
+    stbtt_GetGlyphHMetrics(&font->font_info, index, &advance_width, NULL);
+    return advance_width;
+}
 
-    if ((p[0] & 0xF8) == 0xF0) {
-        if (!UTF8_IS_CONT(p[1]) || !UTF8_IS_CONT(p[2]) || !UTF8_IS_CONT(p[3])) {
-            return 0;
+int text_calculate_width(Font *font, const char *text)
+{
+    int codepoint[TEXT_DECODE_CHUNK];
+    int xadvance = 0;
+    size_t length = strlen(text);
+    while (length > 0) {
+        size_t consumed;
+        const int count = utf8_decode(text, length, codepoint, TEXT_DECODE_CHUNK, &consumed);
+        text += consumed;
+        length -= consumed;
+
+        for (int i = 0; i < count; i++) {
+            const int unicode_codepoint = codepoint[i];
+            int packed_index = get_packed_char_index(font, unicode_codepoint);
+            if (packed_index >= 0) {
+                xadvance += font->advance[packed_index];
+            } else {
+                // Codepoints outside of the packed ranges are rare so we keep a small direct mapped cache for them
+                FontAdvanceCacheEntry *entry = &font->advance_cache[unicode_codepoint & (FONT_ADVANCE_CACHE_SIZE - 1)];
+                if (entry->codepoint != unicode_codepoint) {
+                    entry->codepoint = unicode_codepoint;
+                    entry->advance = get_glyph_advance(font, unicode_codepoint);
+                }
+                xadvance += entry->advance;
+            }
         }
-        *len = 4;
-        return UTF8_C4(p[0], p[1], p[2], p[3]);
+    }
+    return (int)((float)xadvance * font->scale);
+}
+
+static int dynamic_atlas_create(Font *font)
+{
+    font->dynamic_texture = texture_create(NULL, FONT_DYNAMIC_ATLAS_SIZE, FONT_DYNAMIC_ATLAS_SIZE, XGU_TEXTURE_FORMAT_A8);
+    if (font->dynamic_texture == NULL) {
+        return -1;
+    }
+
+    const int slots_per_row = FONT_DYNAMIC_ATLAS_SIZE / font->dynamic_slot_size;
+    font->dynamic_glyph_count = slots_per_row * slots_per_row;
+    font->dynamic_glyph = malloc(sizeof(FontDynamicGlyph) * font->dynamic_glyph_count);
+    if (font->dynamic_glyph == NULL) {
+        texture_destroy(font->dynamic_texture);
+        font->dynamic_texture = NULL;
+        return -1;
     }
 
+    for (int i = 0; i < font->dynamic_glyph_count; i++) {
+        font->dynamic_glyph[i].codepoint = -1;
+        font->dynamic_glyph[i].last_used_frame = 0;
+    }
     return 0;
 }
 
-int text_calculate_width(Font *font, const char *text)
+// Returns the dynamic atlas slot holding the codepoint, rasterising it if required. Returns NULL if the
+// font doesn't have this glyph or every slot is already in use this frame.
+static FontDynamicGlyph *get_dynamic_glyph(Font *font, int unicode_codepoint)
 {
-    float xadvance = 0.0f;
-    int len;
-    for (const char *p = text; *p && *p != '\0'; p++) {
-        int unicode_codepoint = utf8_decode(p, &len);
-        assert(len > 0);
+    const uint32_t frame = renderer_frame_count();
 
-        int advance_width = 0;
+    if (font->dynamic_texture == NULL && dynamic_atlas_create(font) != 0) {
+        return NULL;
+    }
 
-        int index = stbtt_FindGlyphIndex(&font->font_info, unicode_codepoint);
-        if (index == 0) {
-            index = stbtt_FindGlyphIndex(&font->font_info, '-');
-            assert(index != 0);
+    FontDynamicGlyph *lru_glyph = &font->dynamic_glyph[0];
+    for (int i = 0; i < font->dynamic_glyph_count; i++) {
+        FontDynamicGlyph *glyph = &font->dynamic_glyph[i];
+        if (glyph->codepoint == unicode_codepoint) {
+            glyph->last_used_frame = frame;
+            return glyph;
+        }
+        if (glyph->last_used_frame < lru_glyph->last_used_frame) {
+            lru_glyph = glyph;
         }
-        stbtt_GetGlyphHMetrics(&font->font_info, index, &advance_width, NULL);
+    }
 
-        xadvance += advance_width;
+    if (stbtt_FindGlyphIndex(&font->font_info, unicode_codepoint) == 0) {
+        return NULL;
+    }
 
-        p += len - 1;
+    // The GPU may still read slots that were drawn earlier in this frame, so never evict those
+    if (lru_glyph->codepoint != -1 && lru_glyph->last_used_frame == frame) {
+        return NULL;
     }
-    return (int)(xadvance * font->scale);
+
+    int x0, y0, x1, y1;
+    stbtt_GetCodepointBitmapBox(&font->font_info, unicode_codepoint, font->scale, font->scale, &x0, &y0, &x1, &y1);
+
+    // Leave one pixel of padding between slots so bilinear filtering doesn't bleed into neighbours
+    const int max_size = font->dynamic_slot_size - 1;
+    const int w = (x1 - x0 < max_size) ? x1 - x0 : max_size;
+    const int h = (y1 - y0 < max_size) ? y1 - y0 : max_size;
+
+    const int slots_per_row = FONT_DYNAMIC_ATLAS_SIZE / font->dynamic_slot_size;
+    const int slot = lru_glyph - font->dynamic_glyph;
+    const int slot_x = (slot % slots_per_row) * font->dynamic_slot_size;
+    const int slot_y = (slot / slots_per_row) * font->dynamic_slot_size;
+
+    if (w > 0 && h > 0) {
+        unsigned char *bitmap = malloc(w * h);
+        if (bitmap == NULL) {
+            return NULL;
+        }
+        stbtt_MakeCodepointBitmap(&font->font_info, bitmap, w, h, w, font->scale, font->scale, unicode_codepoint);
+        texture_update(font->dynamic_texture, slot_x, slot_y, w, h, bitmap);
+        free(bitmap);
+    }
+
+    int advance_width;
+    stbtt_GetCodepointHMetrics(&font->font_info, unicode_codepoint, &advance_width, NULL);
+
+    // Cached layouts may still reference the evicted glyph
+    if (lru_glyph->codepoint != -1) {
+        font->dynamic_generation++;
+    }
+
+    lru_glyph->codepoint = unicode_codepoint;
+    lru_glyph->last_used_frame = frame;
+    lru_glyph->packed_char = (stbtt_packedchar){
+        .x0 = slot_x,
+        .y0 = slot_y,
+        .x1 = slot_x + w,
+        .y1 = slot_y + h,
+        .xoff = (float)x0,
+        .yoff = (float)y0,
+        .xadvance = (float)advance_width * font->scale,
+        .xoff2 = (float)(x0 + w),
+        .yoff2 = (float)(y0 + h)};
+    return lru_glyph;
 }
 
-static const stbtt_packedchar *get_packed_char_range(Font *font, int unicode_codepoint, int *character_index)
+// Resolves the quad for a codepoint at the current pen position and advances the pen. Looks in the packed data
+// first, then the dynamic atlas. If the font doesn't have the glyph at all a placeholder is used.
+static void get_glyph_quad(Font *font, int unicode_codepoint, float *x_offset, float *y_offset,
+                           const xgu_texture_t **texture, int *dynamic_slot, stbtt_aligned_quad *quad)
 {
-    for (int i = 0; i < font->range_count; i++) {
-        stbtt_pack_range *range = &font->range[i];
-        if (unicode_codepoint >= range->first_unicode_codepoint_in_range &&
-            unicode_codepoint < range->first_unicode_codepoint_in_range + range->num_chars) {
-            *character_index = unicode_codepoint - range->first_unicode_codepoint_in_range;
-            return range->chardata_for_range;
+    const stbtt_packedchar *packed_char = NULL;
+    *texture = font->texture;
+    *dynamic_slot = -1;
+
+    int index = get_packed_char_index(font, unicode_codepoint);
+    if (index >= 0) {
+        packed_char = &font->packed_chars[index];
+    } else {
+        FontDynamicGlyph *glyph = get_dynamic_glyph(font, unicode_codepoint);
+        if (glyph != NULL) {
+            *texture = font->dynamic_texture;
+            *dynamic_slot = glyph - font->dynamic_glyph;
+            packed_char = &glyph->packed_char;
+        } else {
+            packed_char = &font->packed_chars[font->fallback_index];
         }
     }
-    return NULL;
+
+    stbtt_GetPackedQuad(packed_char, (*texture)->data_width, (*texture)->data_height, 0,
+                        x_offset, y_offset, quad, 1);
+}
+
+static xgu_texture_boundary_t get_quad_boundary(const xgu_texture_t *texture, const stbtt_aligned_quad *b)
+{
+    return (xgu_texture_boundary_t){
+        .s0 = b->s0 * (float)texture->data_width,
+        .s1 = b->s1 * (float)texture->data_width,
+        .t0 = b->t0 * (float)texture->data_height,
+        .t1 = b->t1 * (float)texture->data_height};
 }
 
 void text_draw(Font *font, const char *text, int x, int y, const xgu_texture_tint_t *tint)
@@ -91,64 +224,241 @@ void text_draw(Font *font, const char *text, int x, int y, const xgu_texture_tin
     float y_offset = (float)y;
     float base_x = x_offset;
 
-    int len, index, unicode_codepoint;
-    for (const char *p = text; *p && *p != '\0'; p++) {
-
-        if (*p == '\n') {
-            x_offset = base_x;
-            y_offset += font->line_height;
-            continue;
-        }
-
-        if (*p == '\r') {
-            x_offset = base_x;
-            continue;
+    int codepoint[TEXT_DECODE_CHUNK];
+    size_t length = strlen(text);
+    while (length > 0) {
+        size_t consumed;
+        const int count = utf8_decode(text, length, codepoint, TEXT_DECODE_CHUNK, &consumed);
+        text += consumed;
+        length -= consumed;
+
+        for (int i = 0; i < count; i++) {
+            if (codepoint[i] == '\n') {
+                x_offset = base_x;
+                y_offset += font->line_height;
+                continue;
+            }
+
+            if (codepoint[i] == '\r') {
+                x_offset = base_x;
+                continue;
+            }
+
+            const xgu_texture_t *texture;
+            int dynamic_slot;
+            stbtt_aligned_quad b;
+            get_glyph_quad(font, codepoint[i], &x_offset, &y_offset, &texture, &dynamic_slot, &b);
+
+            xgu_texture_boundary_t xgu_texture_boundary = get_quad_boundary(texture, &b);
+            renderer_batch_begin(texture, tint);
+            renderer_batch_add_quad((int)b.x0, (int)b.y0, (int)(b.x1 - b.x0), (int)(b.y1 - b.y0), &xgu_texture_boundary);
         }
+    }
+}
 
-        unicode_codepoint = utf8_decode(p, &len);
-        assert(len > 0);
+typedef struct text_layout_quad
+{
+    const xgu_texture_t *texture;
+    int dynamic_slot; // -1 if the glyph is in the packed data
+    int x;
+    int y;
+    int width;
+    int height;
+    xgu_texture_boundary_t boundary;
+} text_layout_quad_t;
+
+typedef struct text_layout
+{
+    const Font *font;
+    const char *text;
+    uint32_t generation;
+    uint32_t dynamic_generation;
+    int quad_count;
+    int quad_capacity;
+    text_layout_quad_t *quad;
+} text_layout_t;
+
+#define TEXT_LAYOUT_CACHE_SIZE 128 // Must be a power of two
+static text_layout_t text_layout_cache[TEXT_LAYOUT_CACHE_SIZE];
+static volatile uint32_t text_layout_generation = 1;
+
+// Safe to call from any thread, the layouts themselves are only rebuilt by the render loop
+void text_invalidate_layouts(void)
+{
+    __atomic_fetch_add(&text_layout_generation, 1, __ATOMIC_RELEASE);
+}
 
-        const stbtt_packedchar *packed_char = get_packed_char_range(font, unicode_codepoint, &index);
-        // If the character is not found in the packed data, draw a placeholder
-        if (packed_char == NULL) {
-            packed_char = get_packed_char_range(font, '-', &index);
+// Changes whenever a label that was laid out may have been rewritten, so callers can tell if the screen is stale
+uint32_t text_layouts_generation(void)
+{
+    return text_layout_generation;
+}
 
-            // Every font should have a basic ASCII character fallback
-            assert(packed_char != NULL);
+static int text_layout_build(Font *font, const char *text, text_layout_t *layout)
+{
+    // Quads are stored relative to the text origin so the layout can be reused at any position
+    float x_offset = 0.0f;
+    float y_offset = 0.0f;
+
+    layout->quad_count = 0;
+
+    int codepoint[TEXT_DECODE_CHUNK];
+    const char *p = text;
+    size_t length = strlen(text);
+    while (length > 0) {
+        size_t consumed;
+        const int count = utf8_decode(p, length, codepoint, TEXT_DECODE_CHUNK, &consumed);
+        p += consumed;
+        length -= consumed;
+
+        for (int i = 0; i < count; i++) {
+            if (codepoint[i] == '\n') {
+                x_offset = 0.0f;
+                y_offset += font->line_height;
+                continue;
+            }
+
+            if (codepoint[i] == '\r') {
+                x_offset = 0.0f;
+                continue;
+            }
+
+            if (layout->quad_count == layout->quad_capacity) {
+                int capacity = (layout->quad_capacity) ? layout->quad_capacity * 2 : 32;
+                text_layout_quad_t *quad = realloc(layout->quad, sizeof(text_layout_quad_t) * capacity);
+                if (quad == NULL) {
+                    return -1;
+                }
+                layout->quad = quad;
+                layout->quad_capacity = capacity;
+            }
+
+            text_layout_quad_t *quad = &layout->quad[layout->quad_count++];
+            stbtt_aligned_quad b;
+            get_glyph_quad(font, codepoint[i], &x_offset, &y_offset, &quad->texture, &quad->dynamic_slot, &b);
+
+            quad->x = (int)b.x0;
+            quad->y = (int)b.y0;
+            quad->width = (int)(b.x1 - b.x0);
+            quad->height = (int)(b.y1 - b.y0);
+            quad->boundary = get_quad_boundary(quad->texture, &b);
         }
+    }
+
+    layout->font = font;
+    layout->text = text;
+    layout->generation = text_layout_generation;
+    layout->dynamic_generation = font->dynamic_generation;
+    return 0;
+}
 
-        stbtt_aligned_quad b;
-        stbtt_GetPackedQuad(packed_char, font->texture->data_width, font->texture->data_height, index,
-                            &x_offset, &y_offset, &b, 1);
+void text_draw_cached(Font *font, const char *text, int x, int y, const xgu_texture_tint_t *tint)
+{
+    const uintptr_t key = ((uintptr_t)text >> 2) ^ ((uintptr_t)font >> 4);
+    text_layout_t *layout = &text_layout_cache[key & (TEXT_LAYOUT_CACHE_SIZE - 1)];
+
+    if (layout->font != font || layout->text != text || layout->generation != text_layout_generation ||
+        layout->dynamic_generation != font->dynamic_generation) {
+        if (text_layout_build(font, text, layout) != 0) {
+            layout->font = NULL;
+            text_draw(font, text, x, y, tint);
+            return;
+        }
+    }
 
-        xgu_texture_boundary_t xgu_texture_boundary = {
-            .s0 = b.s0 * (float)font->texture->data_width,
-            .s1 = b.s1 * (float)font->texture->data_width,
-            .t0 = b.t0 * (float)font->texture->data_height,
-            .t1 = b.t1 * (float)font->texture->data_height};
+    const uint32_t frame = renderer_frame_count();
+    for (int i = 0; i < layout->quad_count; i++) {
+        const text_layout_quad_t *quad = &layout->quad[i];
 
-        renderer_draw_textured_rectangle(
-            (int)b.x0, (int)b.y0,
-            (int)(b.x1 - b.x0), (int)(b.y1 - b.y0),
-            font->texture, tint, &xgu_texture_boundary);
+        // Keep dynamic glyphs referenced by this layout from being evicted while the GPU uses them
+        if (quad->dynamic_slot >= 0) {
+            font->dynamic_glyph[quad->dynamic_slot].last_used_frame = frame;
+        }
 
-        p += len - 1;
+        renderer_batch_begin(quad->texture, tint);
+        renderer_batch_add_quad(x + quad->x, y + quad->y, quad->width, quad->height, &quad->boundary);
     }
 }
 
-int text_create(const unsigned char *ttf_data, float font_size, const int (*range)[2], int range_count, Font *font)
+static int font_setup_ranges(Font *font, float font_size, const int (*range)[2], int range_count)
 {
-    unsigned char *font_texture_bitmap = NULL;
-
-    font->range = malloc(sizeof(stbtt_pack_range) * range_count);
+    font->range = calloc(range_count, sizeof(stbtt_pack_range));
     font->range_count = range_count;
 
+    font->packed_count = 0;
     for (int i = 0; i < range_count; i++) {
+        font->packed_count += range[i][1] - range[i][0] + 1;
+    }
+    assert(font->packed_count < FONT_GLYPH_NONE);
+
+    // All ranges share one packed char array so a glyph can be referenced by a single index
+    font->packed_chars = calloc(font->packed_count, sizeof(stbtt_packedchar));
+    if (font->range == NULL || font->packed_chars == NULL) {
+        return -1;
+    }
+
+    for (int i = 0, packed_index = 0; i < range_count; i++) {
         font->range[i].font_size = font_size;
         font->range[i].first_unicode_codepoint_in_range = range[i][0];
         font->range[i].num_chars = range[i][1] - range[i][0] + 1;
-        font->range[i].chardata_for_range = malloc(sizeof(stbtt_packedchar) * font->range[i].num_chars);
-        memset(font->range[i].chardata_for_range, 0, sizeof(stbtt_packedchar) * font->range[i].num_chars);
+        font->range[i].chardata_for_range = &font->packed_chars[packed_index];
+
+        for (int j = 0; j < font->range[i].num_chars; j++, packed_index++) {
+            int codepoint = range[i][0] + j;
+            if (codepoint >= 0x10000 || range_count <= FONT_GLYPH_SCAN_RANGES) {
+                continue;
+            }
+
+            uint16_t **page = &font->glyph_page[codepoint / FONT_GLYPH_PAGE_SIZE];
+            if (*page == NULL) {
+                *page = malloc(sizeof(uint16_t) * FONT_GLYPH_PAGE_SIZE);
+                if (*page == NULL) {
+                    return -1;
+                }
+                memset(*page, 0xFF, sizeof(uint16_t) * FONT_GLYPH_PAGE_SIZE);
+            }
+            (*page)[codepoint % FONT_GLYPH_PAGE_SIZE] = packed_index;
+        }
+    }
+
+    // Every font should have a basic ASCII character fallback
+    font->fallback_index = get_packed_char_index(font, '-');
+    assert(font->fallback_index >= 0);
+    return 0;
+}
+
+static int font_setup_metrics(Font *font, const unsigned char *ttf_data, float font_size)
+{
+    stbtt_InitFont(&font->font_info, ttf_data, stbtt_GetFontOffsetForIndex(ttf_data, 0));
+    font->scale = stbtt_ScaleForPixelHeight(&font->font_info, font_size);
+    int ascent, descent, line_gap;
+    stbtt_GetFontVMetrics(&font->font_info, &ascent, &descent, &line_gap);
+
+    font->line_height = (float)(ascent - descent + line_gap) * font->scale;
+    font->dynamic_slot_size = (int)font->line_height + 2;
+
+    // Precompute the advance widths so text_calculate_width doesn't need to walk the font tables
+    font->advance = malloc(sizeof(int) * font->packed_count);
+    if (font->advance == NULL) {
+        return -1;
+    }
+    for (int i = 0, packed_index = 0; i < font->range_count; i++) {
+        for (int j = 0; j < font->range[i].num_chars; j++) {
+            font->advance[packed_index++] = get_glyph_advance(font, font->range[i].first_unicode_codepoint_in_range + j);
+        }
+    }
+    for (int i = 0; i < FONT_ADVANCE_CACHE_SIZE; i++) {
+        font->advance_cache[i].codepoint = -1;
+    }
+    return 0;
+}
+
+int text_create(const unsigned char *ttf_data, float font_size, const int (*range)[2], int range_count, Font *font)
+{
+    unsigned char *font_texture_bitmap = NULL;
+
+    if (font_setup_ranges(font, font_size, range, range_count) != 0) {
+        return -1;
     }
 
     int w = 32, h = 32, ret = 0;
@@ -169,12 +479,10 @@ int text_create(const unsigned char *ttf_data, float font_size, const int (*rang
             continue;
         }
 
-        stbtt_InitFont(&font->font_info, ttf_data, stbtt_GetFontOffsetForIndex(ttf_data, 0));
-        font->scale = stbtt_ScaleForPixelHeight(&font->font_info, font_size);
-        int ascent, descent, line_gap;
-        stbtt_GetFontVMetrics(&font->font_info, &ascent, &descent, &line_gap);
-
-        font->line_height = (float)(ascent - descent + line_gap) * font->scale;
+        if (font_setup_metrics(font, ttf_data, font_size) != 0) {
+            free(font_texture_bitmap);
+            return -1;
+        }
 
         font->texture = texture_create(font_texture_bitmap, w, h, XGU_TEXTURE_FORMAT_A8);
         if (font->texture == NULL) {
@@ -186,3 +494,202 @@ int text_create(const unsigned char *ttf_data, float font_size, const int (*rang
 
     return 0;
 }
+
+int text_create_baked(const unsigned char *atlas_data, size_t atlas_size, const unsigned char *ttf_data, float font_size, const int (*range)[2], int range_count, Font *font)
+{
+    text_atlas_header_t header;
+    if (atlas_size < sizeof(header)) {
+        return -1;
+    }
+    memcpy(&header, atlas_data, sizeof(header));
+
+    // The atlas must have been baked from the same font size and ranges we are asking for, otherwise the caller
+    // should fall back to packing at runtime
+    if (header.magic != TEXT_ATLAS_MAGIC || header.version != TEXT_ATLAS_VERSION || header.font_size != font_size ||
+        header.range_count != (uint32_t)range_count) {
+        return -1;
+    }
+
+    const size_t range_size = sizeof(int32_t[2]) * header.range_count;
+    if (atlas_size < sizeof(header) + range_size) {
+        return -1;
+    }
+    for (int i = 0; i < range_count; i++) {
+        int32_t baked_range[2];
+        memcpy(baked_range, atlas_data + sizeof(header) + sizeof(baked_range) * i, sizeof(baked_range));
+        if (baked_range[0] != range[i][0] || baked_range[1] != range[i][1]) {
+            return -1;
+        }
+    }
+
+    if (font_setup_ranges(font, font_size, range, range_count) != 0) {
+        return -1;
+    }
+
+    const size_t packed_size = sizeof(stbtt_packedchar) * font->packed_count;
+    const unsigned char *packed_chars = atlas_data + sizeof(header) + range_size;
+    const unsigned char *bitmap = packed_chars + packed_size;
+    if (atlas_size < sizeof(header) + range_size + packed_size + header.width * header.height) {
+        return -1;
+    }
+    memcpy(font->packed_chars, packed_chars, packed_size);
+
+    if (font_setup_metrics(font, ttf_data, font_size) != 0) {
+        return -1;
+    }
+
+    font->texture = texture_create(bitmap, header.width, header.height, XGU_TEXTURE_FORMAT_A8);
+    if (font->texture == NULL) {
+        return -1;
+    }
+    return 0;
+}
+
+int text_create_sdf(const unsigned char *ttf_data, const int (*range)[2], int range_count, Font *font)
+{
+    if (font_setup_ranges(font, FONT_SDF_SIZE, range, range_count) != 0 ||
+        font_setup_metrics(font, ttf_data, FONT_SDF_SIZE) != 0) {
+        return -1;
+    }
+
+    // Render the distance field of every glyph up front so they can be packed together
+    typedef struct
+    {
+        unsigned char *bitmap;
+        int xoff, yoff;
+        int notdef_index; // Codepoints the font doesn't have share one copy of the missing glyph outline
+    } sdf_glyph_t;
+    sdf_glyph_t *glyph = calloc(font->packed_count, sizeof(sdf_glyph_t));
+    stbrp_rect *rect = calloc(font->packed_count, sizeof(stbrp_rect));
+    stbrp_node *node = NULL;
+    unsigned char *bitmap = NULL;
+    int ret = -1;
+    if (glyph == NULL || rect == NULL) {
+        goto cleanup;
+    }
+
+    int notdef_index = -1;
+    for (int i = 0, packed_index = 0; i < font->range_count; i++) {
+        for (int j = 0; j < font->range[i].num_chars; j++, packed_index++) {
+            const int glyph_index = stbtt_FindGlyphIndex(&font->font_info, font->range[i].first_unicode_codepoint_in_range + j);
+            glyph[packed_index].notdef_index = (glyph_index == 0) ? notdef_index : -1;
+            if (glyph_index == 0 && notdef_index < 0) {
+                notdef_index = packed_index;
+            }
+
+            int w = 0, h = 0;
+            if (glyph[packed_index].notdef_index < 0) {
+                glyph[packed_index].bitmap =
+                    stbtt_GetGlyphSDF(&font->font_info, font->scale, glyph_index, FONT_SDF_PADDING, FONT_SDF_ONEDGE,
+                                      (float)FONT_SDF_ONEDGE / FONT_SDF_PADDING, &w, &h, &glyph[packed_index].xoff,
+                                      &glyph[packed_index].yoff);
+            }
+
+            // Leave one pixel between glyphs so bilinear filtering doesn't bleed into neighbours
+            rect[packed_index].id = packed_index;
+            rect[packed_index].w = (glyph[packed_index].bitmap != NULL) ? w + 1 : 0;
+            rect[packed_index].h = (glyph[packed_index].bitmap != NULL) ? h + 1 : 0;
+        }
+    }
+
+    int w = 64, h = 64;
+    while (1) {
+        node = malloc(sizeof(stbrp_node) * w);
+        if (node == NULL) {
+            goto cleanup;
+        }
+
+        stbrp_context context;
+        stbrp_init_target(&context, w, h, node, w);
+        const int packed = stbrp_pack_rects(&context, rect, font->packed_count);
+        free(node);
+        node = NULL;
+        if (packed) {
+            break;
+        }
+        (w < h) ? (w *= 2) : (h *= 2);
+    }
+
+    // Pixels outside of any glyph are far outside the outline
+    bitmap = calloc(w, h);
+    if (bitmap == NULL) {
+        goto cleanup;
+    }
+
+    for (int i = 0; i < font->packed_count; i++) {
+        if (glyph[i].notdef_index >= 0) {
+            font->packed_chars[i] = font->packed_chars[glyph[i].notdef_index];
+            continue;
+        }
+
+        const int glyph_w = (rect[i].w > 0) ? rect[i].w - 1 : 0;
+        const int glyph_h = (rect[i].h > 0) ? rect[i].h - 1 : 0;
+        for (int y = 0; y < glyph_h; y++) {
+            memcpy(&bitmap[(rect[i].y + y) * w + rect[i].x], &glyph[i].bitmap[y * glyph_w], glyph_w);
+        }
+
+        font->packed_chars[i] = (stbtt_packedchar){
+            .x0 = rect[i].x,
+            .y0 = rect[i].y,
+            .x1 = rect[i].x + glyph_w,
+            .y1 = rect[i].y + glyph_h,
+            .xoff = (float)glyph[i].xoff,
+            .yoff = (float)glyph[i].yoff,
+            .xadvance = (float)font->advance[i] * font->scale,
+            .xoff2 = (float)(glyph[i].xoff + glyph_w),
+            .yoff2 = (float)(glyph[i].yoff + glyph_h)};
+    }
+
+    font->texture = texture_create(bitmap, w, h, XGU_TEXTURE_FORMAT_A8);
+    if (font->texture == NULL) {
+        goto cleanup;
+    }
+    font->texture->distance_field = true;
+    ret = 0;
+
+cleanup:
+    if (glyph != NULL) {
+        for (int i = 0; i < font->packed_count; i++) {
+            stbtt_FreeSDF(glyph[i].bitmap, NULL);
+        }
+    }
+    free(glyph);
+    free(rect);
+    free(bitmap);
+    return ret;
+}
+
+int text_create_sdf_scaled(const Font *sdf_font, float font_size, Font *font)
+{
+    assert(sdf_font->texture != NULL && sdf_font->texture->distance_field);
+    const float k = font_size / FONT_SDF_SIZE;
+
+    // The atlas, glyph lookup and advance widths are shared with the distance field font, only the glyph
+    // placement is scaled
+    *font = *sdf_font;
+    font->scale *= k;
+    font->line_height *= k;
+    font->dynamic_slot_size = (int)font->line_height + 2;
+    font->dynamic_texture = NULL;
+    font->dynamic_glyph = NULL;
+    font->dynamic_glyph_count = 0;
+    font->dynamic_generation = 0;
+    for (int i = 0; i < FONT_ADVANCE_CACHE_SIZE; i++) {
+        font->advance_cache[i].codepoint = -1;
+    }
+
+    font->packed_chars = malloc(sizeof(stbtt_packedchar) * font->packed_count);
+    if (font->packed_chars == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < font->packed_count; i++) {
+        stbtt_packedchar packed_char = sdf_font->packed_chars[i];
+        packed_char.xoff *= k;
+        packed_char.yoff *= k;
+        packed_char.xoff2 *= k;
+        packed_char.yoff2 *= k;
+        packed_char.xadvance *= k;
+        font->packed_chars[i] = packed_char;
+    }
+    return 0;
+}
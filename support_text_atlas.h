@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+
+// Pre-baked font atlas as generated by tools/font_baker at build time. The layout is:
+//  text_atlas_header_t
+//  int32_t[range_count][2]       - First and last codepoint of each packed range
+//  stbtt_packedchar[]            - One entry per codepoint, in range order
+//  uint8_t[width * height]       - A8 glyph bitmap
+#define TEXT_ATLAS_MAGIC   0x544E4658 // "XFNT"
+#define TEXT_ATLAS_VERSION 1
+
+typedef struct text_atlas_header
+{
+    uint32_t magic;
+    uint32_t version;
+    float font_size;
+    uint32_t width;
+    uint32_t height;
+    uint32_t range_count;
+} text_atlas_header_t;
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+// GPU ready texture as generated by tools/texture_encoder at build time. The layout is:
+//  texture_asset_header_t
+//  uint32_t[palette_count]       - A8R8G8B8 palette, only for TEXTURE_ASSET_FORMAT_P8_SWIZZLED
+//  uint8_t[data_size]            - Texel data padded to data_width * data_height, in the layout the GPU samples
+#define TEXTURE_ASSET_MAGIC   0x58455458 // "XTEX"
+#define TEXTURE_ASSET_VERSION 1
+
+typedef enum texture_asset_format
+{
+    TEXTURE_ASSET_FORMAT_A8B8G8R8,          // Linear, sampled with texel coordinates
+    TEXTURE_ASSET_FORMAT_A8B8G8R8_SWIZZLED, // Swizzled, sampled with normalised coordinates
+    TEXTURE_ASSET_FORMAT_P8_SWIZZLED,       // Swizzled 8-bit palette indices
+    TEXTURE_ASSET_FORMAT_DXT1,              // 4x4 blocks of 8 bytes, 1-bit alpha
+    TEXTURE_ASSET_FORMAT_DXT5,              // 4x4 blocks of 16 bytes, interpolated alpha
+} texture_asset_format_t;
+
+typedef struct texture_asset_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t data_width;
+    uint32_t data_height;
+    uint32_t palette_count;
+    uint32_t data_size;
+} texture_asset_header_t;
@@ -0,0 +1,142 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "support_utf8.h"
+
+#if defined(__SSE2__) && !defined(UTF8_NO_SSE2)
+#include <emmintrin.h>
+
+#define UTF8_BLOCK_SIZE 16
+
+// Writes every byte of the block out as a codepoint and returns how many of them, from the start, were ASCII.
+// Entries after those are overwritten by the caller.
+static inline int ascii_block(const uint8_t *p, int *codepoints)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bytes = _mm_loadu_si128((const __m128i *)p);
+    const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+    const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+    _mm_storeu_si128((__m128i *)&codepoints[0], _mm_unpacklo_epi16(lo, zero));
+    _mm_storeu_si128((__m128i *)&codepoints[4], _mm_unpackhi_epi16(lo, zero));
+    _mm_storeu_si128((__m128i *)&codepoints[8], _mm_unpacklo_epi16(hi, zero));
+    _mm_storeu_si128((__m128i *)&codepoints[12], _mm_unpackhi_epi16(hi, zero));
+
+    // The top bit of every non-ASCII byte is set
+    return __builtin_ctz((uint32_t)_mm_movemask_epi8(bytes) | (1u << UTF8_BLOCK_SIZE));
+}
+#else
+// The Xbox CPU has no SSE2, so it checks eight bytes at a time in a general purpose register instead.
+// This relies on the target being little endian.
+#define UTF8_BLOCK_SIZE 8
+
+static inline int ascii_block(const uint8_t *p, int *codepoints)
+{
+    uint64_t bytes;
+    memcpy(&bytes, p, sizeof(bytes));
+    for (int i = 0; i < UTF8_BLOCK_SIZE; i++) {
+        codepoints[i] = p[i];
+    }
+
+    const uint64_t high_bits = bytes & 0x8080808080808080ull;
+    return (high_bits == 0) ? UTF8_BLOCK_SIZE : __builtin_ctzll(high_bits) / 8;
+}
+#endif
+
+// Works out how much of a malformed sequence to replace. The allowed range of the second byte depends on the lead
+// byte to reject overlong forms, surrogates and anything above U+10FFFF, see table 3-7 of the Unicode standard. Sets
+// len to the bytes that were valid so far, at least one.
+static void malformed_sequence_length(const uint8_t *p, size_t length, int *len)
+{
+    const uint8_t lead = p[0];
+    uint8_t lo = 0x80, hi = 0xBF;
+    int continuation_count;
+
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        continuation_count = 1;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        continuation_count = 2;
+        lo = (lead == 0xE0) ? 0xA0 : lo;
+        hi = (lead == 0xED) ? 0x9F : hi;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        continuation_count = 3;
+        lo = (lead == 0xF0) ? 0x90 : lo;
+        hi = (lead == 0xF4) ? 0x8F : hi;
+    } else {
+        *len = 1;
+        return;
+    }
+
+    int i = 1;
+    while (i <= continuation_count && (size_t)i < length && p[i] >= lo && p[i] <= hi) {
+        lo = 0x80;
+        hi = 0xBF;
+        i++;
+    }
+    *len = i;
+}
+
+// Decodes one sequence starting with a non-ASCII byte. Well formed sequences are checked by their decoded value,
+// anything else is replaced. Continuation bytes are flipped to 0x00-0x3F, so one compare checks several at once.
+static inline int decode_sequence(const uint8_t *p, size_t length, int *len)
+{
+    const uint8_t lead = p[0];
+    if ((lead & 0xF0) == 0xE0) {
+        if (length >= 3) {
+            const int c1 = p[1] ^ 0x80, c2 = p[2] ^ 0x80;
+            const int codepoint = (lead & 0x0F) << 12 | c1 << 6 | c2;
+            if ((c1 | c2) < 0x40 && codepoint >= 0x800 && (unsigned)(codepoint - 0xD800) >= 0x800) {
+                *len = 3;
+                return codepoint;
+            }
+        }
+    } else if (lead >= 0xC2 && lead <= 0xDF) {
+        if (length >= 2 && (uint8_t)(p[1] ^ 0x80) < 0x40) {
+            *len = 2;
+            return (lead & 0x1F) << 6 | (p[1] ^ 0x80);
+        }
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        if (length >= 4) {
+            const int c1 = p[1] ^ 0x80, c2 = p[2] ^ 0x80, c3 = p[3] ^ 0x80;
+            const int codepoint = (lead & 0x07) << 18 | c1 << 12 | c2 << 6 | c3;
+            if ((c1 | c2 | c3) < 0x40 && codepoint >= 0x10000 && codepoint <= 0x10FFFF) {
+                *len = 4;
+                return codepoint;
+            }
+        }
+    }
+
+    malformed_sequence_length(p, length, len);
+    return UTF8_REPLACEMENT_CHARACTER;
+}
+
+int utf8_decode(const char *text, size_t length, int *codepoints, int max_codepoints, size_t *consumed)
+{
+    const uint8_t *p = (const uint8_t *)text;
+    size_t i = 0;
+    int count = 0;
+
+    while (i < length && count < max_codepoints) {
+        if (length - i >= UTF8_BLOCK_SIZE && max_codepoints - count >= UTF8_BLOCK_SIZE) {
+            const int ascii_count = ascii_block(&p[i], &codepoints[count]);
+            i += ascii_count;
+            count += ascii_count;
+            if (ascii_count == UTF8_BLOCK_SIZE) {
+                continue;
+            }
+        } else if (p[i] < 0x80) {
+            codepoints[count++] = p[i++];
+            continue;
+        }
+
+        // Only reached with a non-ASCII byte at p[i] and room for at least one more codepoint. Multibyte characters
+        // tend to come in runs, so decode all of them before looking for ASCII again.
+        do {
+            int len;
+            codepoints[count++] = decode_sequence(&p[i], length - i, &len);
+            i += len;
+        } while (i < length && count < max_codepoints && p[i] >= 0x80);
+    }
+
+    *consumed = i;
+    return count;
+}
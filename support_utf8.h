@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stddef.h>
+
+// Substituted for each malformed sequence, which follows the Unicode recommendation of one replacement
+// per maximal subpart so a bad byte never swallows the valid characters after it
+#define UTF8_REPLACEMENT_CHARACTER 0xFFFD
+
+// Decodes the first length bytes of text into at most max_codepoints codepoints. Returns the number of codepoints
+// written and sets consumed to the number of bytes they were decoded from, so long strings can be decoded in chunks.
+// Overlong forms, surrogates, codepoints above U+10FFFF and sequences cut off by the end of the buffer all decode to
+// UTF8_REPLACEMENT_CHARACTER. NUL bytes are not treated specially.
+int utf8_decode(const char *text, size_t length, int *codepoints, int max_codepoints, size_t *consumed);
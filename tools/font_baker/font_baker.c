@@ -0,0 +1,121 @@
+/* font_baker.c
+ * Packs a TTF font into an A8 atlas at build time so the dashboard doesn't need to rasterise it at boot.
+ * The packing matches text_create in support_text.c.
+ *
+ * Usage: font_baker <font.ttf> <font_size> <first>-<last> [<first>-<last> ...] <output.bin>
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <stb/stb_rect_pack.h>
+
+#define STB_TRUETYPE_IMPLEMENTATION
+#include <stb/stb_truetype.h>
+
+#include "support_text_atlas.h"
+
+static unsigned char *read_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    unsigned char *data = malloc(size);
+    if (data != NULL && fread(data, 1, size, f) != (size_t)size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 5) {
+        fprintf(stderr, "Usage: %s <font.ttf> <font_size> <first>-<last> [<first>-<last> ...] <output.bin>\n", argv[0]);
+        return 1;
+    }
+
+    unsigned char *ttf_data = read_file(argv[1]);
+    if (ttf_data == NULL) {
+        fprintf(stderr, "Could not read %s\n", argv[1]);
+        return 1;
+    }
+
+    const float font_size = strtof(argv[2], NULL);
+    const int range_count = argc - 4;
+    const char *output_path = argv[argc - 1];
+
+    int32_t(*range)[2] = malloc(sizeof(int32_t[2]) * range_count);
+    stbtt_pack_range *pack_range = malloc(sizeof(stbtt_pack_range) * range_count);
+    int packed_count = 0;
+    for (int i = 0; i < range_count; i++) {
+        if (sscanf(argv[3 + i], "%d-%d", &range[i][0], &range[i][1]) != 2 || range[i][1] < range[i][0]) {
+            fprintf(stderr, "Invalid range %s\n", argv[3 + i]);
+            return 1;
+        }
+        packed_count += range[i][1] - range[i][0] + 1;
+    }
+
+    stbtt_packedchar *packed_chars = calloc(packed_count, sizeof(stbtt_packedchar));
+    for (int i = 0, packed_index = 0; i < range_count; i++) {
+        pack_range[i].font_size = font_size;
+        pack_range[i].first_unicode_codepoint_in_range = range[i][0];
+        pack_range[i].array_of_unicode_codepoints = NULL;
+        pack_range[i].num_chars = range[i][1] - range[i][0] + 1;
+        pack_range[i].chardata_for_range = &packed_chars[packed_index];
+        packed_index += pack_range[i].num_chars;
+    }
+
+    // Grow the atlas until everything fits, same as the runtime path
+    unsigned char *bitmap = NULL;
+    int w = 32, h = 32, ret = 0;
+    while (ret == 0) {
+        stbtt_pack_context pc;
+        bitmap = calloc(w, h);
+        stbtt_PackBegin(&pc, bitmap, w, h, 0, 1, NULL);
+        ret = stbtt_PackFontRanges(&pc, ttf_data, 0, pack_range, range_count);
+        stbtt_PackEnd(&pc);
+
+        if (ret == 0) {
+            (w < h) ? (w *= 2) : (h *= 2);
+            free(bitmap);
+        }
+    }
+
+    text_atlas_header_t header = {
+        .magic = TEXT_ATLAS_MAGIC,
+        .version = TEXT_ATLAS_VERSION,
+        .font_size = font_size,
+        .width = w,
+        .height = h,
+        .range_count = range_count};
+
+    FILE *f = fopen(output_path, "wb");
+    if (f == NULL) {
+        fprintf(stderr, "Could not open %s for writing\n", output_path);
+        return 1;
+    }
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(range, sizeof(int32_t[2]), range_count, f);
+    fwrite(packed_chars, sizeof(stbtt_packedchar), packed_count, f);
+    fwrite(bitmap, 1, w * h, f);
+    fclose(f);
+
+    printf("Baked %s at %.1fpx into a %dx%d atlas (%d glyphs)\n", argv[1], font_size, w, h, packed_count);
+
+    free(bitmap);
+    free(packed_chars);
+    free(pack_range);
+    free(range);
+    free(ttf_data);
+    return 0;
+}
@@ -0,0 +1,382 @@
+/* ftp_bench.c
+ * Measures FTP download and upload throughput of the dashboard's FTP server from the host. Point it at xemu with the
+ * FTP port forwarded, or at a real Xbox on the network. The file is downloaded with RETR, or uploaded with STOR of
+ * generated data, the given number of times over passive mode data connections. With --parallel, that many clients
+ * log in and transfer at the same time, each to its own file named <remote_path>.<client number>, to load the server's
+ * file I/O threads from all connections at once. After uploading, each client downloads its file again and compares it
+ * with the data it sent, so data the server wrote out of order or into another client's file fails the run.
+ *
+ * Usage: ftp_bench <host> <remote_path> [--port <port>] [--repeat <count>] [--upload <megabytes>]
+ *                  [--parallel <clients>] [--user <name>] [--pass <password>]
+ *
+ * For example, with xemu forwarding host port 2121 to the Xbox's port 21:
+ *   ftp_bench 127.0.0.1 /E/bench.bin --port 2121 --upload 64 --repeat 3
+ *   ftp_bench 127.0.0.1 /E/bench.bin --port 2121 --repeat 3
+ *   ftp_bench 127.0.0.1 /E/bench.bin --port 2121 --upload 32 --parallel 10
+ */
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define REPLY_SIZE    1024
+#define TRANSFER_SIZE (256 * 1024)
+#define MAX_CLIENTS   10
+
+typedef struct
+{
+    int fd;
+    char buffer[REPLY_SIZE];
+    size_t buffered;
+} control_t;
+
+typedef struct
+{
+    // Shared by all clients
+    const char *host;
+    const char *user;
+    const char *pass;
+    int port;
+    int repeat;
+    uint64_t upload_bytes;
+
+    // Per client
+    int number;
+    char path[REPLY_SIZE];
+    double best, total_megabytes, total_seconds;
+    double finished; // When the last timed transfer completed, before verifying
+    int failed;
+} client_t;
+
+static double now_seconds(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static int tcp_connect(const char *host, int port)
+{
+    char port_text[16];
+    snprintf(port_text, sizeof(port_text), "%d", port);
+
+    struct addrinfo hints = {0}, *result;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port_text, &hints, &result) != 0) {
+        return -1;
+    }
+
+    int fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    if (fd >= 0 && connect(fd, result->ai_addr, result->ai_addrlen) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(result);
+    return fd;
+}
+
+// Reads one reply, skipping the lines of a multi line reply, and returns its code or -1 if the connection failed
+static int read_reply(control_t *control, char *line, size_t line_size)
+{
+    while (1) {
+        char *end = memchr(control->buffer, '\n', control->buffered);
+        if (end == NULL) {
+            if (control->buffered == sizeof(control->buffer)) {
+                return -1;
+            }
+            ssize_t received = recv(control->fd, &control->buffer[control->buffered],
+                                    sizeof(control->buffer) - control->buffered, 0);
+            if (received <= 0) {
+                return -1;
+            }
+            control->buffered += received;
+            continue;
+        }
+
+        const size_t length = end - control->buffer + 1;
+        const size_t copy = (length < line_size) ? length : line_size - 1;
+        memcpy(line, control->buffer, copy);
+        line[copy] = '\0';
+        memmove(control->buffer, end + 1, control->buffered - length);
+        control->buffered -= length;
+
+        // The last line of a reply is the code followed by a space, the others use a dash
+        if (length >= 4 && line[0] >= '0' && line[0] <= '9' && line[3] == ' ') {
+            return atoi(line);
+        }
+    }
+}
+
+static int command(control_t *control, char *reply, size_t reply_size, const char *format, ...)
+{
+    char text[REPLY_SIZE];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, sizeof(text) - 2, format, args);
+    va_end(args);
+    memcpy(&text[length], "\r\n", 2);
+
+    if (send(control->fd, text, length + 2, 0) != length + 2) {
+        return -1;
+    }
+    return read_reply(control, reply, reply_size);
+}
+
+// Opens a passive mode data connection, the server's address is taken from the 227 reply
+static int open_data_connection(control_t *control, const char *host)
+{
+    char reply[REPLY_SIZE];
+    if (command(control, reply, sizeof(reply), "PASV") != 227) {
+        fprintf(stderr, "PASV failed: %s", reply);
+        return -1;
+    }
+
+    unsigned int h1, h2, h3, h4, p1, p2;
+    const char *numbers = strchr(reply, '(');
+    if (numbers == NULL || sscanf(numbers, "(%u,%u,%u,%u,%u,%u)", &h1, &h2, &h3, &h4, &p1, &p2) != 6) {
+        fprintf(stderr, "Unexpected PASV reply: %s", reply);
+        return -1;
+    }
+
+    // Behind xemu's NAT the address in the reply is the guest's, so connect to the control connection's host
+    return tcp_connect(host, (int)(p1 * 256 + p2));
+}
+
+// Generated once in main, all clients upload from it
+static char upload_data[TRANSFER_SIZE];
+
+// Each client starts at its own place in upload_data, so one client's data in another's file doesn't match
+static size_t upload_offset(const client_t *client, uint64_t position)
+{
+    return (size_t)((position + (uint64_t)client->number * 4099) % TRANSFER_SIZE);
+}
+
+// With uploaded set, the file has to hold exactly the data that client uploaded
+static double download(control_t *control, const char *host, const char *path, uint64_t *bytes,
+                       const client_t *uploaded)
+{
+    char *data = malloc(TRANSFER_SIZE);
+    char reply[REPLY_SIZE];
+
+    int data_fd = open_data_connection(control, host);
+    if (data_fd < 0) {
+        free(data);
+        return -1.0;
+    }
+
+    const double start = now_seconds();
+    const int code = command(control, reply, sizeof(reply), "RETR %s", path);
+    if (code != 150 && code != 125) {
+        fprintf(stderr, "RETR failed: %s", reply);
+        close(data_fd);
+        free(data);
+        return -1.0;
+    }
+
+    *bytes = 0;
+    int mismatch = 0;
+    ssize_t received;
+    while ((received = recv(data_fd, data, TRANSFER_SIZE, 0)) > 0) {
+        for (ssize_t i = 0; uploaded != NULL && !mismatch && i < received; i++) {
+            if (*bytes + i >= uploaded->upload_bytes || data[i] != upload_data[upload_offset(uploaded, *bytes + i)]) {
+                fprintf(stderr, "[%d] %s differs from the upload at byte %llu\n", uploaded->number, path,
+                        (unsigned long long)(*bytes + i));
+                mismatch = 1;
+            }
+        }
+        *bytes += received;
+    }
+    close(data_fd);
+    free(data);
+
+    if (read_reply(control, reply, sizeof(reply)) != 226) {
+        fprintf(stderr, "RETR did not complete: %s", reply);
+        return -1.0;
+    }
+    if (uploaded != NULL && !mismatch && *bytes != uploaded->upload_bytes) {
+        fprintf(stderr, "[%d] %s is %llu bytes, %llu were uploaded\n", uploaded->number, path,
+                (unsigned long long)*bytes, (unsigned long long)uploaded->upload_bytes);
+        mismatch = 1;
+    }
+    return mismatch ? -1.0 : now_seconds() - start;
+}
+
+static double upload(control_t *control, const client_t *client)
+{
+    char reply[REPLY_SIZE];
+
+    int data_fd = open_data_connection(control, client->host);
+    if (data_fd < 0) {
+        return -1.0;
+    }
+
+    const double start = now_seconds();
+    const int code = command(control, reply, sizeof(reply), "STOR %s", client->path);
+    if (code != 150 && code != 125) {
+        fprintf(stderr, "STOR failed: %s", reply);
+        close(data_fd);
+        return -1.0;
+    }
+
+    // Partial sends continue where they left off, so the file is the pattern without gaps
+    const uint64_t size = client->upload_bytes;
+    uint64_t sent = 0;
+    while (sent < size) {
+        const size_t offset = upload_offset(client, sent);
+        const size_t chunk = (size - sent < TRANSFER_SIZE - offset) ? (size_t)(size - sent) : TRANSFER_SIZE - offset;
+        ssize_t written = send(data_fd, &upload_data[offset], chunk, 0);
+        if (written <= 0) {
+            fprintf(stderr, "Data connection closed after %llu bytes\n", (unsigned long long)sent);
+            close(data_fd);
+            return -1.0;
+        }
+        sent += written;
+    }
+    close(data_fd);
+
+    // The upload is only complete once the server has written the file out and replied
+    if (read_reply(control, reply, sizeof(reply)) != 226) {
+        fprintf(stderr, "STOR did not complete: %s", reply);
+        return -1.0;
+    }
+    return now_seconds() - start;
+}
+
+static void *run_client(void *param)
+{
+    client_t *client = param;
+    client->failed = 1;
+
+    control_t control = {.fd = tcp_connect(client->host, client->port)};
+    if (control.fd < 0) {
+        fprintf(stderr, "Could not connect to %s:%d\n", client->host, client->port);
+        return NULL;
+    }
+
+    char reply[REPLY_SIZE];
+    if (read_reply(&control, reply, sizeof(reply)) != 220 ||
+        command(&control, reply, sizeof(reply), "USER %s", client->user) != 331 ||
+        command(&control, reply, sizeof(reply), "PASS %s", client->pass) != 230 ||
+        command(&control, reply, sizeof(reply), "TYPE I") != 200) {
+        fprintf(stderr, "Login failed: %s", reply);
+        close(control.fd);
+        return NULL;
+    }
+
+    for (int run = 0; run < client->repeat; run++) {
+        uint64_t bytes = client->upload_bytes;
+        const double seconds = client->upload_bytes
+                                   ? upload(&control, client)
+                                   : download(&control, client->host, client->path, &bytes, NULL);
+        if (seconds < 0.0) {
+            close(control.fd);
+            return NULL;
+        }
+
+        const double megabytes = bytes / (1024.0 * 1024.0);
+        const double rate = megabytes / seconds;
+        printf("[%d] %s %.1f MB in %.3f s: %.2f MB/s\n", client->number, client->upload_bytes ? "STOR" : "RETR",
+               megabytes, seconds, rate);
+        client->best = (rate > client->best) ? rate : client->best;
+        client->total_megabytes += megabytes;
+        client->total_seconds += seconds;
+    }
+    client->finished = now_seconds();
+
+    // Every run uploaded the same data, the file holds the last one
+    uint64_t bytes;
+    if (client->upload_bytes && download(&control, client->host, client->path, &bytes, client) < 0.0) {
+        close(control.fd);
+        return NULL;
+    }
+
+    command(&control, reply, sizeof(reply), "QUIT");
+    close(control.fd);
+    client->failed = 0;
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <host> <remote_path> [--port <port>] [--repeat <count>] [--upload <megabytes>] "
+                        "[--parallel <clients>] [--user <name>] [--pass <password>]\n", argv[0]);
+        return 1;
+    }
+
+    client_t settings = {.host = argv[1], .user = "xbox", .pass = "xbox", .port = 21, .repeat = 1};
+    const char *path = argv[2];
+    int parallel = 1;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--port") == 0) {
+            settings.port = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--repeat") == 0) {
+            settings.repeat = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--upload") == 0) {
+            settings.upload_bytes = (uint64_t)atoll(argv[i + 1]) * 1024 * 1024;
+        } else if (strcmp(argv[i], "--parallel") == 0) {
+            parallel = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--user") == 0) {
+            settings.user = argv[i + 1];
+        } else if (strcmp(argv[i], "--pass") == 0) {
+            settings.pass = argv[i + 1];
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (parallel < 1 || parallel > MAX_CLIENTS) {
+        fprintf(stderr, "--parallel must be between 1 and %d\n", MAX_CLIENTS);
+        return 1;
+    }
+
+    for (size_t i = 0; i < sizeof(upload_data); i++) {
+        upload_data[i] = (char)(i * 31 + (i >> 11));
+    }
+
+    static client_t clients[MAX_CLIENTS];
+    pthread_t threads[MAX_CLIENTS];
+    const double start = now_seconds();
+    for (int i = 0; i < parallel; i++) {
+        clients[i] = settings;
+        clients[i].number = i;
+        snprintf(clients[i].path, sizeof(clients[i].path), (parallel > 1) ? "%s.%d" : "%s", path, i);
+        pthread_create(&threads[i], NULL, run_client, &clients[i]);
+    }
+
+    int failed = 0;
+    double best = 0.0, total_megabytes = 0.0, total_seconds = 0.0, finished = start;
+    for (int i = 0; i < parallel; i++) {
+        pthread_join(threads[i], NULL);
+        failed |= clients[i].failed;
+        best = (clients[i].best > best) ? clients[i].best : best;
+        total_megabytes += clients[i].total_megabytes;
+        total_seconds += clients[i].total_seconds;
+        finished = (clients[i].finished > finished) ? clients[i].finished : finished;
+    }
+    const double elapsed = finished - start;
+    if (failed) {
+        return 1;
+    }
+    if (settings.upload_bytes) {
+        printf("All %d uploads read back intact\n", parallel);
+    }
+
+    printf("Average %.2f MB/s, best %.2f MB/s over %d runs\n", total_megabytes / total_seconds, best,
+           settings.repeat * parallel);
+    if (parallel > 1) {
+        printf("%d clients moved %.1f MB in %.3f s: %.2f MB/s combined\n", parallel, total_megabytes, elapsed,
+               total_megabytes / elapsed);
+    }
+    return 0;
+}
@@ -0,0 +1,243 @@
+/* ftp_io_stress.c
+ * Stress test for the FTP server's file I/O threads in lib/ftpd/ftp_file.c, built for the host against the stand-ins
+ * in host/. Each of FTP_NBR_CLIENTS threads plays a connection uploading a file at the same time as the others: it
+ * feeds ftps_f_write chains of segments of random size like STOR does, with its own number of cache buffers, then
+ * reads the file back through ftps_f_read_async like RETR. The I/O threads are shared by all files and only keep each
+ * file's requests in order by handing a file to one thread at a time, so a request carried out early or twice shows up
+ * as a wrong byte. Afterwards the cache buffers are trimmed and the pool has to be back to a zero footprint.
+ *
+ * Usage: ftp_io_stress <directory> [--rounds <count>] [--megabytes <size>] [--seed <seed>]
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ftp.h"
+#include "ftp_file.h"
+#include "ftp_pool.h"
+
+#define MAX_CHAIN 3
+
+typedef struct
+{
+    int number;
+    int round;
+    int cache_count;
+    uint32_t size;
+    uint32_t seed;
+    char path[_MAX_LFN];
+    int failed;
+} upload_t;
+
+static const char *directory;
+static uint32_t upload_bytes = 4 * 1024 * 1024;
+
+static uint32_t next_random(uint32_t *state)
+{
+    *state = *state * 1664525 + 1013904223;
+    return *state >> 8;
+}
+
+// Differs between files, rounds and nearby offsets, so data landing in the wrong place or file doesn't match
+static uint8_t pattern_byte(const upload_t *upload, uint32_t offset)
+{
+    uint32_t x = offset * 2654435761u + (offset >> 12) + upload->number * 977 + upload->round * 131;
+    return (uint8_t)(x ^ (x >> 13));
+}
+
+static int upload(upload_t *upload, uint8_t *segment_data)
+{
+    FIL file;
+    FRESULT res;
+
+    // Like a client retrying once the other connections hand their buffers back
+    while ((res = ftps_f_open(&file, upload->path, FA_CREATE_ALWAYS | FA_WRITE, upload->cache_count)) == FR_NOT_ENOUGH_CORE) {
+        usleep(1000);
+    }
+    if (res != FR_OK) {
+        fprintf(stderr, "client %d: could not create %s (%d)\n", upload->number, upload->path, res);
+        return -1;
+    }
+
+    uint32_t offset = 0;
+    while (offset < upload->size) {
+        // One to MAX_CHAIN pbufs of up to TCP_MSS bytes, as netconn_recv hands them to STOR
+        struct pbuf chain[MAX_CHAIN];
+        int links = 1 + next_random(&upload->seed) % MAX_CHAIN;
+        uint16_t total = 0;
+        for (int i = 0; i < links && offset + total < upload->size; i++) {
+            uint32_t len = 1 + next_random(&upload->seed) % TCP_MSS;
+            if (len > upload->size - offset - total) {
+                len = upload->size - offset - total;
+            }
+            chain[i].payload = segment_data + total;
+            chain[i].len = len;
+            chain[i].next = NULL;
+            if (i > 0) {
+                chain[i - 1].next = &chain[i];
+            }
+            for (uint32_t j = 0; j < len; j++) {
+                segment_data[total + j] = pattern_byte(upload, offset + total + j);
+            }
+            total += len;
+        }
+        chain[0].tot_len = total;
+
+        if (ftps_f_write(&file, chain, total, NULL) != FR_OK) {
+            fprintf(stderr, "client %d: write failed at %u\n", upload->number, offset);
+            ftps_f_close(&file);
+            return -1;
+        }
+        offset += total;
+
+        // Let the I/O threads and the other clients in at varying points
+        if (next_random(&upload->seed) % 8 == 0) {
+            sched_yield();
+        }
+    }
+
+    if (ftps_f_close(&file) != FR_OK) {
+        fprintf(stderr, "client %d: close failed\n", upload->number);
+        return -1;
+    }
+    return 0;
+}
+
+static int verify(upload_t *upload)
+{
+    FIL file;
+    FRESULT res;
+    while ((res = ftps_f_open(&file, upload->path, FA_READ, FILE_CACHE_RETR)) == FR_NOT_ENOUGH_CORE) {
+        usleep(1000);
+    }
+    if (res != FR_OK) {
+        fprintf(stderr, "client %d: could not open %s (%d)\n", upload->number, upload->path, res);
+        return -1;
+    }
+
+    int failed = 0;
+    if (ftps_f_size(&file) != upload->size) {
+        fprintf(stderr, "client %d: %s is %zu bytes, expected %u\n", upload->number, upload->path, ftps_f_size(&file),
+                upload->size);
+        failed = 1;
+    }
+
+    // Reads go through the same queue as the writes did, one in flight like RETR keeps it
+    uint32_t offset = 0;
+    int index = 0;
+    while (!failed && offset < upload->size) {
+        uint32_t read;
+        ftps_f_read_async(&file, file.cache_buf[index], FILE_CACHE_SIZE, offset);
+        if (ftps_f_read_wait(&file, &read) != FR_OK || read == 0) {
+            fprintf(stderr, "client %d: read failed at %u\n", upload->number, offset);
+            failed = 1;
+            break;
+        }
+        const uint8_t *data = (const uint8_t *)file.cache_buf[index];
+        for (uint32_t i = 0; i < read; i++) {
+            if (data[i] != pattern_byte(upload, offset + i)) {
+                fprintf(stderr, "client %d round %d: byte %u of %s is %02x, expected %02x\n", upload->number,
+                        upload->round, offset + i, upload->path, data[i], pattern_byte(upload, offset + i));
+                failed = 1;
+                break;
+            }
+        }
+        offset += read;
+        index = (index + 1) % file.cache_count;
+    }
+
+    ftps_f_close(&file);
+    return failed ? -1 : 0;
+}
+
+static void *client_thread(void *arg)
+{
+    upload_t *upload_state = arg;
+    uint8_t *segment_data = malloc(MAX_CHAIN * TCP_MSS);
+    upload_state->failed = upload(upload_state, segment_data) != 0 || verify(upload_state) != 0;
+    ftps_f_unlink(upload_state->path);
+    free(segment_data);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = 3;
+    uint32_t seed = 1;
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <directory> [--rounds <count>] [--megabytes <size>] [--seed <seed>]\n", argv[0]);
+        return 1;
+    }
+    directory = argv[1];
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--megabytes") == 0 && i + 1 < argc) {
+            upload_bytes = (uint32_t)(atof(argv[++i]) * 1024 * 1024);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (ftps_f_mkdir(directory) != FR_OK && errno != EEXIST) {
+        fprintf(stderr, "Could not create %s\n", directory);
+        return 1;
+    }
+
+    // A scheduler that replays requests keeps appending to the file, make that a failed write instead of a full disk
+    struct rlimit file_limit = {2 * upload_bytes + FILE_CACHE_SIZE, 2 * upload_bytes + FILE_CACHE_SIZE};
+    signal(SIGXFSZ, SIG_IGN);
+    setrlimit(RLIMIT_FSIZE, &file_limit);
+
+    ftps_io_init();
+
+    int failures = 0;
+    for (int round = 0; round < rounds; round++) {
+        upload_t uploads[FTP_NBR_CLIENTS];
+        pthread_t threads[FTP_NBR_CLIENTS];
+        for (int i = 0; i < FTP_NBR_CLIENTS; i++) {
+            upload_t *u = &uploads[i];
+            u->number = i;
+            u->round = round;
+            u->cache_count = FILE_CACHE_MIN + (i + round) % (FILE_CACHE_MAX - FILE_CACHE_MIN + 1);
+            u->seed = seed * 7919 + round * FTP_NBR_CLIENTS + i;
+
+            // Sizes that end anywhere within a cache buffer, including exactly on its end
+            u->size = upload_bytes / 2 + next_random(&u->seed) % upload_bytes;
+            if (i == 0) {
+                u->size = (u->size / FILE_CACHE_SIZE + 1) * FILE_CACHE_SIZE;
+            }
+            snprintf(u->path, sizeof(u->path), "%s/client%d.bin", directory, i);
+            pthread_create(&threads[i], NULL, client_thread, u);
+        }
+        int intact = 0;
+        for (int i = 0; i < FTP_NBR_CLIENTS; i++) {
+            pthread_join(threads[i], NULL);
+            intact += !uploads[i].failed;
+        }
+        printf("Round %d: %d of %d uploads intact\n", round + 1, intact, FTP_NBR_CLIENTS);
+        failures += FTP_NBR_CLIENTS - intact;
+        if (failures) {
+            break;
+        }
+    }
+
+    // Every file is closed, so trimming has to give all cache buffers back
+    ftps_cache_trim();
+    if (ftp_pool_footprint() != 0) {
+        fprintf(stderr, "Pool still holds %zu bytes after trimming\n", ftp_pool_footprint());
+        failures++;
+    }
+    ftps_f_unlink(directory);
+    return failures ? 1 : 0;
+}
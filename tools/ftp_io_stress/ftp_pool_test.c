@@ -0,0 +1,160 @@
+/* ftp_pool_test.c
+ * Checks the block pools in lib/ftpd/ftp_pool.c on the host, built with the address sanitizer so a block reaching past
+ * its slab is reported. Blocks of awkward sizes have to be aligned for any type and must not overlap, pools have to
+ * stop at max_blocks and at FTP_POOL_MEMORY_MAX, trimming has to give everything back once no block is in use, and
+ * threads taking and returning blocks at the same time must never be handed the same block.
+ *
+ * Usage: ftp_pool_test
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ftp.h"
+#include "ftp_pool.h"
+
+#define THREADS 8
+#define THREAD_ITERATIONS 20000
+#define THREAD_BLOCKS 4
+
+static int failures;
+
+#define CHECK(condition, ...)                                    \
+    do {                                                         \
+        if (!(condition)) {                                      \
+            fprintf(stderr, __VA_ARGS__);                        \
+            fputc('\n', stderr);                                 \
+            __atomic_fetch_add(&failures, 1, __ATOMIC_RELAXED); \
+        }                                                        \
+    } while (0)
+
+static void test_alignment(void)
+{
+    // Sizes that aren't a multiple of a pointer or of 8, like the structures the server keeps in pools
+    static const size_t sizes[] = {1, 4, 12, 20, 100, 1700, 4097, 9000};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        ftp_pool_t pool;
+        void *blocks[64];
+        ftp_pool_init(&pool, sizes[s], 64);
+
+        int count = 0;
+        while (count < 64 && (blocks[count] = ftp_pool_get(&pool)) != NULL) {
+            CHECK((uintptr_t)blocks[count] % _Alignof(max_align_t) == 0, "%zu byte block %p isn't aligned", sizes[s],
+                  blocks[count]);
+            memset(blocks[count], count, sizes[s]);
+            count++;
+        }
+        CHECK(count == 64, "%zu byte pool handed out %d of its 64 blocks", sizes[s], count);
+        CHECK(ftp_pool_get(&pool) == NULL, "%zu byte pool grew past max_blocks", sizes[s]);
+
+        // Filling a block must not have touched any other
+        for (int i = 0; i < count; i++) {
+            const unsigned char *bytes = blocks[i];
+            for (size_t j = 0; j < sizes[s]; j++) {
+                if (bytes[j] != (unsigned char)i) {
+                    CHECK(0, "%zu byte block %d was overwritten at byte %zu", sizes[s], i, j);
+                    break;
+                }
+            }
+        }
+
+        for (int i = 0; i < count; i++) {
+            ftp_pool_put(&pool, blocks[i]);
+        }
+        ftp_pool_trim(&pool);
+        CloseHandle(pool.mutex);
+    }
+    CHECK(ftp_pool_footprint() == 0, "Alignment pools still hold %zu bytes", ftp_pool_footprint());
+}
+
+static void test_memory_cap_and_trim(void)
+{
+    // Cache buffer sized blocks each take a slab of their own, so this pool only stops at FTP_POOL_MEMORY_MAX
+    ftp_pool_t pool;
+    void *blocks[FTP_POOL_MEMORY_MAX / PAGE_SIZE];
+    ftp_pool_init(&pool, FILE_CACHE_BUFFER_SIZE, UINT32_MAX);
+
+    int count = 0;
+    while ((blocks[count] = ftp_pool_get(&pool)) != NULL) {
+        CHECK((uintptr_t)blocks[count] % PAGE_SIZE == 0, "Cache buffer %p isn't page aligned", blocks[count]);
+        memset(blocks[count], 0xA5, FILE_CACHE_BUFFER_SIZE);
+        count++;
+    }
+    CHECK(ftp_pool_footprint() <= FTP_POOL_MEMORY_MAX, "Pools hold %zu bytes, more than FTP_POOL_MEMORY_MAX",
+          ftp_pool_footprint());
+    CHECK((size_t)count == FTP_POOL_MEMORY_MAX / pool.slab_size, "Got %d cache buffers, expected %zu", count,
+          (size_t)FTP_POOL_MEMORY_MAX / pool.slab_size);
+
+    // Nothing is given back while a block is still in use
+    ftp_pool_put(&pool, blocks[--count]);
+    ftp_pool_trim(&pool);
+    CHECK(ftp_pool_footprint() == (size_t)(count + 1) * pool.slab_size, "Trimming freed slabs still in use");
+
+    while (count > 0) {
+        ftp_pool_put(&pool, blocks[--count]);
+    }
+    ftp_pool_trim(&pool);
+    CHECK(ftp_pool_footprint() == 0, "Pool still holds %zu bytes after trimming", ftp_pool_footprint());
+
+    // A trimmed pool grows again when needed
+    void *block = ftp_pool_get(&pool);
+    CHECK(block != NULL, "Trimmed pool couldn't grow again");
+    ftp_pool_put(&pool, block);
+    ftp_pool_trim(&pool);
+    CloseHandle(pool.mutex);
+}
+
+static ftp_pool_t shared_pool;
+
+// Each thread marks the blocks it holds with its own tag, another thread handed the same block would change it
+static void *pool_thread(void *arg)
+{
+    const uintptr_t tag = (uintptr_t)arg;
+    void *held[THREAD_BLOCKS] = {NULL};
+    for (int i = 0; i < THREAD_ITERATIONS; i++) {
+        const int slot = i % THREAD_BLOCKS;
+        if (held[slot] != NULL) {
+            uintptr_t *words = held[slot];
+            CHECK(words[1] == tag && words[2] == (uintptr_t)i, "Block %p was handed to another thread", held[slot]);
+            ftp_pool_put(&shared_pool, held[slot]);
+            held[slot] = NULL;
+        }
+
+        uintptr_t *words = ftp_pool_get(&shared_pool);
+        if (words != NULL) {
+            words[1] = tag;
+            words[2] = (uintptr_t)(i + THREAD_BLOCKS);
+            held[slot] = words;
+        }
+    }
+    for (int slot = 0; slot < THREAD_BLOCKS; slot++) {
+        ftp_pool_put(&shared_pool, held[slot]);
+    }
+    return NULL;
+}
+
+static void test_threads(void)
+{
+    // Fewer blocks than the threads want at once, so some gets come back empty
+    ftp_pool_init(&shared_pool, 3 * sizeof(uintptr_t), THREADS * THREAD_BLOCKS / 2);
+    pthread_t threads[THREADS];
+    for (uintptr_t i = 0; i < THREADS; i++) {
+        pthread_create(&threads[i], NULL, pool_thread, (void *)(i + 1));
+    }
+    for (int i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    CHECK(shared_pool.in_use == 0, "%u blocks still in use after all threads returned theirs", shared_pool.in_use);
+    ftp_pool_trim(&shared_pool);
+    CHECK(ftp_pool_footprint() == 0, "Shared pool still holds %zu bytes after trimming", ftp_pool_footprint());
+}
+
+int main(void)
+{
+    test_alignment();
+    test_memory_cap_and_trim();
+    test_threads();
+    printf("%s\n", failures ? "Pool checks failed" : "Pool checks passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+// Host stand-in for the lwIP netconn API types that lib/ftpd's headers refer to, and the pbuf chains STOR hands to
+// ftps_f_write
+#include <string.h>
+#include "lwip/opt.h"
+
+struct netconn;
+struct netbuf;
+
+typedef struct
+{
+    u32_t addr;
+} ip_addr_t;
+
+typedef void *sys_thread_t;
+
+struct pbuf
+{
+    struct pbuf *next;
+    void *payload;
+    u16_t tot_len;
+    u16_t len;
+};
+
+static inline u16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, u16_t len, u16_t offset)
+{
+    u16_t copied = 0;
+    for (; p != NULL && copied < len; p = p->next)
+    {
+        if (offset >= p->len)
+        {
+            offset -= p->len;
+            continue;
+        }
+        u16_t n = p->len - offset;
+        if (n > len - copied)
+        {
+            n = len - copied;
+        }
+        memcpy((u8_t *)dataptr + copied, (const u8_t *)p->payload + offset, n);
+        copied += n;
+        offset = 0;
+    }
+    return copied;
+}
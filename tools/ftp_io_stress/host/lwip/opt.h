@@ -0,0 +1,11 @@
+#pragma once
+
+// Host stand-in for the lwIP options lib/ftpd/ftp_file.c needs
+#include <stdint.h>
+
+typedef uint8_t u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+typedef int8_t err_t;
+
+#define TCP_MSS 1460
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdbool.h>
+
+// No drives are mounted on the host, paths go straight to the host file system
+static inline bool nxIsDriveMounted(char drive_letter)
+{
+    (void)drive_letter;
+    return false;
+}
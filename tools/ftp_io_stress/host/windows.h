@@ -0,0 +1,456 @@
+#pragma once
+
+// Host stand-in for the parts of the nxdk Win32 API that lib/ftpd/ftp_file.c and ftp_pool.c use, over pthreads and
+// POSIX files. Mutexes, semaphores and auto reset events are all a count guarded by a pthread mutex.
+#include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define WINAPI
+#define TRUE 1
+#define FALSE 0
+#define INFINITE 0xFFFFFFFF
+#define WAIT_OBJECT_0 0
+
+typedef int BOOL;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef int32_t LONG;
+typedef intptr_t LONG_PTR;
+typedef uint64_t ULONGLONG;
+typedef uint64_t DWORDLONG;
+typedef void *LPVOID;
+typedef DWORD *LPDWORD;
+
+typedef struct host_handle
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    LONG count;
+    LONG max_count;
+    int fd;
+    BOOL unbuffered;
+} *HANDLE;
+
+#define INVALID_HANDLE_VALUE ((HANDLE)(LONG_PTR)-1)
+
+static inline HANDLE host_handle_create(LONG count, LONG max_count, int fd)
+{
+    HANDLE h = calloc(1, sizeof(*h));
+    pthread_mutex_init(&h->lock, NULL);
+    pthread_cond_init(&h->cond, NULL);
+    h->count = count;
+    h->max_count = max_count;
+    h->fd = fd;
+    return h;
+}
+
+static inline BOOL host_handle_release(HANDLE h, LONG count)
+{
+    pthread_mutex_lock(&h->lock);
+    BOOL ok = h->count + count <= h->max_count;
+    if (ok)
+    {
+        h->count += count;
+        pthread_cond_broadcast(&h->cond);
+    }
+    pthread_mutex_unlock(&h->lock);
+    return ok;
+}
+
+// Synchronisation
+static inline HANDLE CreateMutex(void *attributes, BOOL initial_owner, const char *name)
+{
+    (void)attributes;
+    (void)name;
+    return host_handle_create(initial_owner ? 0 : 1, 1, -1);
+}
+
+static inline HANDLE CreateSemaphore(void *attributes, LONG initial_count, LONG max_count, const char *name)
+{
+    (void)attributes;
+    (void)name;
+    return host_handle_create(initial_count, max_count, -1);
+}
+
+static inline HANDLE CreateEvent(void *attributes, BOOL manual_reset, BOOL initial_state, const char *name)
+{
+    (void)attributes;
+    (void)name;
+    assert(!manual_reset); // Only auto reset events are used
+    return host_handle_create(initial_state ? 1 : 0, 1, -1);
+}
+
+static inline DWORD WaitForSingleObject(HANDLE h, DWORD milliseconds)
+{
+    assert(milliseconds == INFINITE);
+    pthread_mutex_lock(&h->lock);
+    while (h->count == 0)
+    {
+        pthread_cond_wait(&h->cond, &h->lock);
+    }
+    h->count--;
+    pthread_mutex_unlock(&h->lock);
+    return WAIT_OBJECT_0;
+}
+
+static inline BOOL ReleaseMutex(HANDLE h)
+{
+    return host_handle_release(h, 1);
+}
+
+static inline BOOL ReleaseSemaphore(HANDLE h, LONG count, LONG *previous_count)
+{
+    assert(previous_count == NULL);
+    BOOL ok = host_handle_release(h, count);
+    assert(ok); // Going over the maximum count is a bug in the caller
+    return ok;
+}
+
+static inline BOOL SetEvent(HANDLE h)
+{
+    pthread_mutex_lock(&h->lock);
+    h->count = 1;
+    pthread_cond_broadcast(&h->cond);
+    pthread_mutex_unlock(&h->lock);
+    return TRUE;
+}
+
+static inline BOOL CloseHandle(HANDLE h)
+{
+    if (h == INVALID_HANDLE_VALUE || h == NULL)
+    {
+        return FALSE;
+    }
+    if (h->fd >= 0)
+    {
+        close(h->fd);
+    }
+    pthread_mutex_destroy(&h->lock);
+    pthread_cond_destroy(&h->cond);
+    free(h);
+    return TRUE;
+}
+
+// Threads, which are detached as nothing joins them
+typedef DWORD (WINAPI *LPTHREAD_START_ROUTINE)(LPVOID);
+
+typedef struct
+{
+    LPTHREAD_START_ROUTINE start;
+    LPVOID parameter;
+} host_thread_t;
+
+static inline void *host_thread_entry(void *arg)
+{
+    host_thread_t thread = *(host_thread_t *)arg;
+    free(arg);
+    thread.start(thread.parameter);
+    return NULL;
+}
+
+static inline HANDLE CreateThread(void *attributes, size_t stack_size, LPTHREAD_START_ROUTINE start, LPVOID parameter,
+                                  DWORD flags, LPDWORD thread_id)
+{
+    (void)attributes;
+    (void)stack_size;
+    (void)flags;
+    (void)thread_id;
+    host_thread_t *thread = malloc(sizeof(*thread));
+    thread->start = start;
+    thread->parameter = parameter;
+    pthread_t id;
+    if (pthread_create(&id, NULL, host_thread_entry, thread) != 0)
+    {
+        free(thread);
+        return NULL;
+    }
+    pthread_detach(id);
+    return host_handle_create(0, 1, -1);
+}
+
+// Files. ftp_file.c hands over paths with '\' separators, these go back to '/' before reaching the host.
+#define GENERIC_READ 0x80000000
+#define GENERIC_WRITE 0x40000000
+#define FILE_SHARE_READ 0x00000001
+#define CREATE_ALWAYS 2
+#define OPEN_EXISTING 3
+#define FILE_BEGIN 0
+#define FILE_FLAG_NO_BUFFERING 0x20000000
+#define FILE_ATTRIBUTE_READONLY 0x00000001
+#define FILE_ATTRIBUTE_HIDDEN 0x00000002
+#define FILE_ATTRIBUTE_SYSTEM 0x00000004
+#define FILE_ATTRIBUTE_DIRECTORY 0x00000010
+#define FILE_ATTRIBUTE_ARCHIVE 0x00000020
+#define FILE_ATTRIBUTE_NORMAL 0x00000080
+#define INVALID_FILE_ATTRIBUTES ((DWORD)-1)
+#define INVALID_FILE_SIZE ((DWORD)0xFFFFFFFF)
+
+// Unbuffered writes have to be a whole number of sectors from a sector aligned buffer
+#define HOST_SECTOR_SIZE 512
+
+// Reads and writes go to the disk in pieces with a yield between them, like a slow disk, so the other threads run
+// while a request is in progress
+#define HOST_IO_PIECE (16 * 1024)
+
+typedef struct
+{
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+} FILETIME;
+
+typedef struct
+{
+    WORD wYear;
+    WORD wMonth;
+    WORD wDayOfWeek;
+    WORD wDay;
+    WORD wHour;
+    WORD wMinute;
+    WORD wSecond;
+    WORD wMilliseconds;
+} SYSTEMTIME;
+
+typedef struct
+{
+    DWORD dwFileAttributes;
+    FILETIME ftCreationTime;
+    FILETIME ftLastAccessTime;
+    FILETIME ftLastWriteTime;
+    DWORD nFileSizeHigh;
+    DWORD nFileSizeLow;
+    char cFileName[260];
+} WIN32_FIND_DATA;
+
+typedef union
+{
+    struct
+    {
+        DWORD LowPart;
+        LONG HighPart;
+    };
+    int64_t QuadPart;
+} LARGE_INTEGER;
+
+typedef struct
+{
+    LARGE_INTEGER EndOfFile;
+} FILE_END_OF_FILE_INFO;
+
+typedef enum
+{
+    FileEndOfFileInfo = 6
+} FILE_INFO_BY_HANDLE_CLASS;
+
+static inline const char *host_path(const char *path, char *out)
+{
+    size_t i = 0;
+    for (; path[i] != '\0' && i < 259; i++)
+    {
+        out[i] = (path[i] == '\\') ? '/' : path[i];
+    }
+    out[i] = '\0';
+    return out;
+}
+
+static inline HANDLE CreateFileA(const char *path, DWORD access, DWORD share_mode, void *attributes, DWORD disposition,
+                                 DWORD flags, HANDLE template_file)
+{
+    (void)share_mode;
+    (void)attributes;
+    (void)template_file;
+    char p[260];
+    int oflags = ((access & GENERIC_READ) && (access & GENERIC_WRITE)) ? O_RDWR : (access & GENERIC_WRITE) ? O_WRONLY : O_RDONLY;
+    oflags |= (disposition == CREATE_ALWAYS) ? O_CREAT | O_TRUNC : 0;
+    int fd = open(host_path(path, p), oflags, 0644);
+    if (fd < 0)
+    {
+        return INVALID_HANDLE_VALUE;
+    }
+    HANDLE h = host_handle_create(0, 0, fd);
+    h->unbuffered = (flags & FILE_FLAG_NO_BUFFERING) != 0;
+    return h;
+}
+
+static inline BOOL ReadFile(HANDLE h, LPVOID buffer, DWORD len, LPDWORD read_len, void *overlapped)
+{
+    assert(overlapped == NULL);
+    *read_len = 0;
+    while (*read_len < len)
+    {
+        DWORD piece = (len - *read_len < HOST_IO_PIECE) ? len - *read_len : HOST_IO_PIECE;
+        ssize_t n = read(h->fd, (char *)buffer + *read_len, piece);
+        if (n < 0)
+        {
+            return FALSE;
+        }
+        if (n == 0)
+        {
+            break;
+        }
+        *read_len += n;
+        sched_yield();
+    }
+    return TRUE;
+}
+
+static inline BOOL WriteFile(HANDLE h, const void *buffer, DWORD len, LPDWORD written, void *overlapped)
+{
+    assert(overlapped == NULL);
+    if (h->unbuffered)
+    {
+        assert(len % HOST_SECTOR_SIZE == 0);
+        assert((uintptr_t)buffer % HOST_SECTOR_SIZE == 0);
+    }
+    *written = 0;
+    while (*written < len)
+    {
+        DWORD piece = (len - *written < HOST_IO_PIECE) ? len - *written : HOST_IO_PIECE;
+        ssize_t n = write(h->fd, (const char *)buffer + *written, piece);
+        if (n <= 0)
+        {
+            return FALSE;
+        }
+        *written += n;
+        sched_yield();
+    }
+    return TRUE;
+}
+
+static inline DWORD SetFilePointer(HANDLE h, LONG distance, LONG *distance_high, DWORD method)
+{
+    assert(distance_high == NULL && method == FILE_BEGIN);
+    return (DWORD)lseek(h->fd, (DWORD)distance, SEEK_SET);
+}
+
+static inline DWORD GetFileSize(HANDLE h, LPDWORD size_high)
+{
+    assert(size_high == NULL);
+    struct stat st;
+    if (h == INVALID_HANDLE_VALUE || fstat(h->fd, &st) != 0)
+    {
+        return INVALID_FILE_SIZE;
+    }
+    return (DWORD)st.st_size;
+}
+
+static inline BOOL GetFileTime(HANDLE h, FILETIME *creation, FILETIME *access, FILETIME *write)
+{
+    (void)h;
+    (void)creation;
+    (void)access;
+    memset(write, 0, sizeof(*write));
+    return FALSE;
+}
+
+static inline BOOL FileTimeToSystemTime(const FILETIME *filetime, SYSTEMTIME *systemtime)
+{
+    (void)filetime;
+    memset(systemtime, 0, sizeof(*systemtime));
+    systemtime->wYear = 1980;
+    systemtime->wMonth = 1;
+    systemtime->wDay = 1;
+    return TRUE;
+}
+
+static inline BOOL SetFileInformationByHandle(HANDLE h, FILE_INFO_BY_HANDLE_CLASS info_class, LPVOID info, DWORD size)
+{
+    assert(info_class == FileEndOfFileInfo && size == sizeof(FILE_END_OF_FILE_INFO));
+    return ftruncate(h->fd, ((FILE_END_OF_FILE_INFO *)info)->EndOfFile.QuadPart) == 0;
+}
+
+static inline DWORD GetFileAttributesA(const char *path)
+{
+    char p[260];
+    struct stat st;
+    if (stat(host_path(path, p), &st) != 0)
+    {
+        return INVALID_FILE_ATTRIBUTES;
+    }
+    return S_ISDIR(st.st_mode) ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_NORMAL;
+}
+
+static inline BOOL CreateDirectoryA(const char *path, void *attributes)
+{
+    (void)attributes;
+    char p[260];
+    return mkdir(host_path(path, p), 0755) == 0;
+}
+
+static inline BOOL RemoveDirectory(const char *path)
+{
+    char p[260];
+    return rmdir(host_path(path, p)) == 0;
+}
+
+static inline BOOL DeleteFile(const char *path)
+{
+    char p[260];
+    return unlink(host_path(path, p)) == 0;
+}
+
+static inline BOOL MoveFile(const char *from, const char *to)
+{
+    char p_from[260], p_to[260];
+    return rename(host_path(from, p_from), host_path(to, p_to)) == 0;
+}
+
+// Directory listings aren't exercised on the host
+static inline HANDLE FindFirstFile(const char *path, WIN32_FIND_DATA *data)
+{
+    (void)path;
+    (void)data;
+    return INVALID_HANDLE_VALUE;
+}
+
+static inline BOOL FindNextFile(HANDLE h, WIN32_FIND_DATA *data)
+{
+    (void)h;
+    (void)data;
+    return FALSE;
+}
+
+// Memory
+#define MEM_COMMIT 0x00001000
+#define MEM_RESERVE 0x00002000
+#define MEM_RELEASE 0x00008000
+#define PAGE_READWRITE 0x04
+
+typedef struct
+{
+    DWORD dwLength;
+    DWORD dwMemoryLoad;
+    DWORDLONG ullTotalPhys;
+    DWORDLONG ullAvailPhys;
+} MEMORYSTATUSEX;
+
+static inline BOOL GlobalMemoryStatusEx(MEMORYSTATUSEX *status)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+    status->dwMemoryLoad = 0;
+    status->ullTotalPhys = (DWORDLONG)sysconf(_SC_PHYS_PAGES) * page_size;
+    status->ullAvailPhys = (DWORDLONG)sysconf(_SC_AVPHYS_PAGES) * page_size;
+    return TRUE;
+}
+
+// Page aligned heap memory, so the address sanitizer sees overruns past the end of a slab
+static inline LPVOID VirtualAlloc(LPVOID address, size_t size, DWORD allocation_type, DWORD protect)
+{
+    (void)allocation_type;
+    (void)protect;
+    assert(address == NULL);
+    return aligned_alloc(4096, (size + 4095) & ~(size_t)4095);
+}
+
+static inline BOOL VirtualFree(LPVOID address, size_t size, DWORD free_type)
+{
+    assert(size == 0 && free_type == MEM_RELEASE);
+    free(address);
+    return TRUE;
+}
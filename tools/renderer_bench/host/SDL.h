@@ -0,0 +1,4 @@
+#pragma once
+
+// Host stand-in for SDL.h, only what main.h needs to be included
+#define SDL_USEREVENT 0x8000
@@ -0,0 +1,9 @@
+#pragma once
+
+// Host stand-in for the nxdk hal/video.h, there is no video output to enable
+#include <stdbool.h>
+
+static inline void XVideoSetVideoEnable(bool enable)
+{
+    (void)enable;
+}
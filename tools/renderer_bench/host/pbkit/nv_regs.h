@@ -0,0 +1,95 @@
+#pragma once
+
+// From pbkit's nv_regs.h, which the real pbkit.h includes. xgu relies on the first few, support_renderer.c on the
+// register fields of the combiner and shader stage methods, whose addresses come from lib/xgu/nv2a_regs.h.
+#define NV097_SET_TRANSFORM_EXECUTION_MODE_MODE_FIXED   0
+#define NV097_SET_TRANSFORM_EXECUTION_MODE_MODE_PROGRAM 2
+#define NV097_SET_ZMIN_MAX_CONTROL                      0x00001D78
+#define NV097_SET_COMPRESS_ZBUFFER_EN                   0x00001D80
+
+#define NV097_SET_COMBINER_ALPHA_ICW_D_SOURCE 0x0000000F
+#define NV097_SET_COMBINER_ALPHA_ICW_D_ALPHA  (1 << 4)
+#define NV097_SET_COMBINER_ALPHA_ICW_D_MAP    0x000000E0
+#define NV097_SET_COMBINER_ALPHA_ICW_C_SOURCE 0x00000F00
+#define NV097_SET_COMBINER_ALPHA_ICW_C_ALPHA  (1 << 12)
+#define NV097_SET_COMBINER_ALPHA_ICW_C_MAP    0x0000E000
+#define NV097_SET_COMBINER_ALPHA_ICW_B_SOURCE 0x000F0000
+#define NV097_SET_COMBINER_ALPHA_ICW_B_ALPHA  (1 << 20)
+#define NV097_SET_COMBINER_ALPHA_ICW_B_MAP    0x00E00000
+#define NV097_SET_COMBINER_ALPHA_ICW_A_SOURCE 0x0F000000
+#define NV097_SET_COMBINER_ALPHA_ICW_A_ALPHA  (1 << 28)
+#define NV097_SET_COMBINER_ALPHA_ICW_A_MAP    0xE0000000
+
+#define NV097_SET_COMBINER_COLOR_ICW_D_SOURCE 0x0000000F
+#define NV097_SET_COMBINER_COLOR_ICW_D_ALPHA  (1 << 4)
+#define NV097_SET_COMBINER_COLOR_ICW_D_MAP    0x000000E0
+#define NV097_SET_COMBINER_COLOR_ICW_C_SOURCE 0x00000F00
+#define NV097_SET_COMBINER_COLOR_ICW_C_ALPHA  (1 << 12)
+#define NV097_SET_COMBINER_COLOR_ICW_C_MAP    0x0000E000
+#define NV097_SET_COMBINER_COLOR_ICW_B_SOURCE 0x000F0000
+#define NV097_SET_COMBINER_COLOR_ICW_B_ALPHA  (1 << 20)
+#define NV097_SET_COMBINER_COLOR_ICW_B_MAP    0x00E00000
+#define NV097_SET_COMBINER_COLOR_ICW_A_SOURCE 0x0F000000
+#define NV097_SET_COMBINER_COLOR_ICW_A_ALPHA  (1 << 28)
+#define NV097_SET_COMBINER_COLOR_ICW_A_MAP    0xE0000000
+
+#define NV097_SET_COMBINER_ALPHA_OCW_CD_DST             0x0000000F
+#define NV097_SET_COMBINER_ALPHA_OCW_AB_DST             0x000000F0
+#define NV097_SET_COMBINER_ALPHA_OCW_SUM_DST            0x00000F00
+#define NV097_SET_COMBINER_ALPHA_OCW_MUX_ENABLE         (1 << 14)
+#define NV097_SET_COMBINER_ALPHA_OCW_OP                 0x00038000
+#define NV097_SET_COMBINER_ALPHA_OCW_OP_NOSHIFT         0
+#define NV097_SET_COMBINER_ALPHA_OCW_OP_SHIFTLEFTBY2    4
+
+#define NV097_SET_COMBINER_COLOR_OCW_CD_DST        0x0000000F
+#define NV097_SET_COMBINER_COLOR_OCW_AB_DST        0x000000F0
+#define NV097_SET_COMBINER_COLOR_OCW_SUM_DST       0x00000F00
+#define NV097_SET_COMBINER_COLOR_OCW_CD_DOT_ENABLE (1 << 12)
+#define NV097_SET_COMBINER_COLOR_OCW_AB_DOT_ENABLE (1 << 13)
+#define NV097_SET_COMBINER_COLOR_OCW_MUX_ENABLE    (1 << 14)
+#define NV097_SET_COMBINER_COLOR_OCW_OP            0x00038000
+#define NV097_SET_COMBINER_COLOR_OCW_OP_NOSHIFT    0
+
+#define NV097_SET_COMBINER_CONTROL_ITERATION_COUNT        0x000000FF
+#define NV097_SET_COMBINER_CONTROL_FACTOR0                (1 << 12)
+#define NV097_SET_COMBINER_CONTROL_FACTOR0_SAME_FACTOR_ALL 0
+#define NV097_SET_COMBINER_CONTROL_FACTOR1                (1 << 16)
+#define NV097_SET_COMBINER_CONTROL_FACTOR1_SAME_FACTOR_ALL 0
+
+#define NV097_SET_COMBINER_SPECULAR_FOG_CW0_D_SOURCE  0x0000000F
+#define NV097_SET_COMBINER_SPECULAR_FOG_CW0_D_ALPHA   (1 << 4)
+#define NV097_SET_COMBINER_SPECULAR_FOG_CW0_D_INVERSE (1 << 5)
+#define NV097_SET_COMBINER_SPECULAR_FOG_CW0_C_SOURCE  0x00000F00
+#define NV097_SET_COMBINER_SPECULAR_FOG_CW0_C_ALPHA   (1 << 12)
+#define NV097_SET_COMBINER_SPECULAR_FOG_CW0_C_INVERSE (1 << 13)
+#define NV097_SET_COMBINER_SPECULAR_FOG_CW0_B_SOURCE  0x000F0000
+#define NV097_SET_COMBINER_SPECULAR_FOG_CW0_B_ALPHA   (1 << 20)
+#define NV097_SET_COMBINER_SPECULAR_FOG_CW0_B_INVERSE (1 << 21)
+#define NV097_SET_COMBINER_SPECULAR_FOG_CW0_A_SOURCE  0x0F000000
+#define NV097_SET_COMBINER_SPECULAR_FOG_CW0_A_ALPHA   (1 << 28)
+#define NV097_SET_COMBINER_SPECULAR_FOG_CW0_A_INVERSE (1 << 29)
+
+#define NV097_SET_COMBINER_SPECULAR_FOG_CW1_SPECULAR_CLAMP (1 << 7)
+#define NV097_SET_COMBINER_SPECULAR_FOG_CW1_G_SOURCE       0x00000F00
+#define NV097_SET_COMBINER_SPECULAR_FOG_CW1_G_ALPHA        (1 << 12)
+#define NV097_SET_COMBINER_SPECULAR_FOG_CW1_G_INVERSE      (1 << 13)
+#define NV097_SET_COMBINER_SPECULAR_FOG_CW1_F_SOURCE       0x000F0000
+#define NV097_SET_COMBINER_SPECULAR_FOG_CW1_F_ALPHA        (1 << 20)
+#define NV097_SET_COMBINER_SPECULAR_FOG_CW1_F_INVERSE      (1 << 21)
+#define NV097_SET_COMBINER_SPECULAR_FOG_CW1_E_SOURCE       0x0F000000
+#define NV097_SET_COMBINER_SPECULAR_FOG_CW1_E_ALPHA        (1 << 28)
+#define NV097_SET_COMBINER_SPECULAR_FOG_CW1_E_INVERSE      (1 << 29)
+
+#define NV097_SET_SHADER_STAGE_PROGRAM_STAGE0                0x0000001F
+#define NV097_SET_SHADER_STAGE_PROGRAM_STAGE0_PROGRAM_NONE   0
+#define NV097_SET_SHADER_STAGE_PROGRAM_STAGE0_2D_PROJECTIVE  1
+#define NV097_SET_SHADER_STAGE_PROGRAM_STAGE1                0x000003E0
+#define NV097_SET_SHADER_STAGE_PROGRAM_STAGE1_PROGRAM_NONE   0
+#define NV097_SET_SHADER_STAGE_PROGRAM_STAGE2                0x00007C00
+#define NV097_SET_SHADER_STAGE_PROGRAM_STAGE2_PROGRAM_NONE   0
+#define NV097_SET_SHADER_STAGE_PROGRAM_STAGE3                0x000F8000
+#define NV097_SET_SHADER_STAGE_PROGRAM_STAGE3_PROGRAM_NONE   0
+
+#define NV097_SET_SHADER_OTHER_STAGE_INPUT_STAGE1 0x0000FFFF
+#define NV097_SET_SHADER_OTHER_STAGE_INPUT_STAGE2 0x000F0000
+#define NV097_SET_SHADER_OTHER_STAGE_INPUT_STAGE3 0x00F00000
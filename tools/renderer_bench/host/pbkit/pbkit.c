@@ -0,0 +1,383 @@
+/* pbkit.c
+ * Host stand-in for pbkit and the NV2A, so support_renderer.c can be built and measured without hardware.
+ * pb_end copies the words pushed since pb_begin into a FIFO, and a thread standing in for the GPU executes the methods
+ * in it in order. Only what the renderer's tests look at is modelled: draw calls, quads, semaphore releases and back
+ * buffer swaps. pbkit's own methods, like the surface setup pb_target_back_buffer pushes, are left out. Drawing takes
+ * the time the NV2A's fill rate would need for the screen area of each quad, the GPU thread sleeps it off before the
+ * next semaphore release or swap, or before it runs out of work.
+ *
+ * By default a vertical blank happens whenever pb_wait_for_vbl is called, which then waits until the GPU runs out of
+ * work or stalls on the next swap, or when pb_busy is polled while the GPU is stalled on a swap. Frames are rendered
+ * as fast as the host allows that way. pb_host_set_vblank_rate has a thread signal them at a fixed rate instead, to
+ * measure how the renderer waits for the GPU at the display's refresh rate.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <xgu/nv2a_regs.h>
+
+#include "pbkit.h"
+
+#define FIFO_WORDS    (1 << 20) // Must be a power of two
+#define STAGING_WORDS (1 << 16) // Most words pushed between one pb_begin and pb_end
+#define SWAPS_MAX     2         // pb_finished refuses to queue another swap while this many are pending
+#define PIXELS_PER_US 932       // 4 pixels per clock at 233 MHz
+#define SCREEN_WIDTH  640
+#define SCREEN_HEIGHT 480
+
+#define METHOD_ADDRESS(header) ((header) & 0x1FFC)
+#define METHOD_COUNT(header)   (((header) >> 18) & 0x7FF)
+
+// Everything below is guarded by lock, and changed is broadcast whenever any of it changes
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t changed = PTHREAD_COND_INITIALIZER;
+static uint32_t fifo[FIFO_WORDS];
+static uint64_t fifo_put; // Words submitted so far
+static uint64_t fifo_get; // Words the GPU has executed so far
+static uint64_t vblank_count;
+static int vblank_hz; // 0 while vertical blanks only happen when waited for
+static int swaps_pending;
+static bool gpu_stalled; // Waiting at a swap for the vertical blank after gpu_stall_vblank
+static uint64_t gpu_stall_vblank;
+static bool gpu_held;
+static pb_host_stats_t stats;
+
+static uint32_t staging[STAGING_WORDS];
+
+// Only touched by the GPU thread
+static uint32_t inline_vertices;
+static float inline_positions[4][2];
+static uint32_t vertex_array_offset;
+static uint32_t vertex_array_stride;
+static uint32_t semaphore_offset;
+static uint64_t draw_time_ns; // Drawing done but not yet slept off
+
+// The renderer only draws screen aligned quads, so their bounding box is the area filled
+static void draw_quad(const float positions[4][2])
+{
+    float x0 = positions[0][0], x1 = x0, y0 = positions[0][1], y1 = y0;
+    for (int i = 1; i < 4; i++) {
+        x0 = (positions[i][0] < x0) ? positions[i][0] : x0;
+        x1 = (positions[i][0] > x1) ? positions[i][0] : x1;
+        y0 = (positions[i][1] < y0) ? positions[i][1] : y0;
+        y1 = (positions[i][1] > y1) ? positions[i][1] : y1;
+    }
+    x0 = (x0 < 0.0f) ? 0.0f : x0;
+    y0 = (y0 < 0.0f) ? 0.0f : y0;
+    x1 = (x1 > SCREEN_WIDTH) ? SCREEN_WIDTH : x1;
+    y1 = (y1 > SCREEN_HEIGHT) ? SCREEN_HEIGHT : y1;
+    if (x1 > x0 && y1 > y0) {
+        draw_time_ns += (uint64_t)((x1 - x0) * (y1 - y0)) * 1000 / PIXELS_PER_US;
+    }
+    stats.quads++;
+}
+
+static void catch_up(void)
+{
+    if (vblank_hz > 0 && draw_time_ns > 0) {
+        const struct timespec duration = {draw_time_ns / 1000000000, draw_time_ns % 1000000000};
+        nanosleep(&duration, NULL);
+    }
+    draw_time_ns = 0;
+}
+
+static void execute(uint32_t method, const uint32_t *params, uint32_t count)
+{
+    switch (method) {
+        case NV097_SET_BEGIN_END:
+            if (params[0] != NV097_SET_BEGIN_END_OP_END) {
+                stats.draw_calls++;
+                inline_vertices = 0;
+            }
+            break;
+        case NV097_SET_VERTEX4F:
+            memcpy(inline_positions[inline_vertices % 4], params, sizeof(inline_positions[0]));
+            if (++inline_vertices % 4 == 0) {
+                draw_quad(inline_positions);
+            }
+            break;
+        case NV097_SET_VERTEX_DATA_ARRAY_OFFSET:
+            vertex_array_offset = params[0];
+            break;
+        case NV097_SET_VERTEX_DATA_ARRAY_FORMAT:
+            vertex_array_stride = params[0] >> 8;
+            break;
+        case NV097_DRAW_ARRAYS:
+            for (uint32_t i = 0; i < count; i++) {
+                const uint32_t first = params[i] & NV097_DRAW_ARRAYS_START_INDEX;
+                const uint32_t vertices = (params[i] >> 24) + 1;
+                for (uint32_t v = first; v + 4 <= first + vertices; v += 4) {
+                    float positions[4][2];
+                    for (int j = 0; j < 4; j++) {
+                        const uintptr_t address = vertex_array_offset + (v + j) * vertex_array_stride;
+                        memcpy(positions[j], (const void *)address, sizeof(positions[j]));
+                    }
+                    draw_quad(positions);
+                }
+            }
+            break;
+        case NV097_SET_SEMAPHORE_OFFSET:
+            semaphore_offset = params[0];
+            break;
+        case NV097_BACK_END_WRITE_SEMAPHORE_RELEASE:
+            // Everything before the release has been drawn by the time the value lands in memory
+            catch_up();
+            __atomic_store_n((uint32_t *)(uintptr_t)semaphore_offset, params[0], __ATOMIC_RELEASE);
+            break;
+    }
+}
+
+static void *gpu_thread(void *arg)
+{
+    (void)arg;
+    static uint32_t params[0x800];
+
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        while (fifo_get == fifo_put || gpu_held) {
+            pthread_cond_wait(&changed, &lock);
+        }
+
+        // pb_end only ever queues whole methods, and the words aren't reused before fifo_get moves past them
+        const uint32_t header = fifo[fifo_get % FIFO_WORDS];
+        const uint32_t count = METHOD_COUNT(header);
+        if (METHOD_ADDRESS(header) == NV097_FLIP_STALL) {
+            pthread_mutex_unlock(&lock);
+            catch_up();
+            pthread_mutex_lock(&lock);
+
+            // The swap retires on the first vertical blank after the GPU gets to it
+            gpu_stalled = true;
+            gpu_stall_vblank = vblank_count;
+            pthread_cond_broadcast(&changed);
+            while (vblank_count == gpu_stall_vblank) {
+                pthread_cond_wait(&changed, &lock);
+            }
+            gpu_stalled = false;
+            swaps_pending--;
+            stats.flips++;
+        } else {
+            pthread_mutex_unlock(&lock);
+            for (uint32_t i = 0; i < count; i++) {
+                params[i] = fifo[(fifo_get + 1 + i) % FIFO_WORDS];
+            }
+            execute(METHOD_ADDRESS(header), params, count);
+            pthread_mutex_lock(&lock);
+            if (fifo_get + 1 + count == fifo_put) {
+                pthread_mutex_unlock(&lock);
+                catch_up();
+                pthread_mutex_lock(&lock);
+            }
+        }
+        fifo_get += 1 + count;
+        pthread_cond_broadcast(&changed);
+    }
+    return NULL;
+}
+
+static void *vblank_thread(void *arg)
+{
+    (void)arg;
+    const long period_ns = 1000000000L / vblank_hz;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (;;) {
+        next.tv_nsec += period_ns;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+        pthread_mutex_lock(&lock);
+        vblank_count++;
+        pthread_cond_broadcast(&changed);
+        pthread_mutex_unlock(&lock);
+    }
+    return NULL;
+}
+
+static void submit(const uint32_t *words, uint64_t count)
+{
+    pthread_mutex_lock(&lock);
+    while (fifo_put + count - fifo_get > FIFO_WORDS) {
+        pthread_cond_wait(&changed, &lock);
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        fifo[(fifo_put + i) % FIFO_WORDS] = words[i];
+    }
+    fifo_put += count;
+    stats.words += count;
+    pthread_cond_broadcast(&changed);
+    pthread_mutex_unlock(&lock);
+}
+
+// Retires any swap the GPU is stalled on, until it has executed everything submitted. Called with lock held
+static void drain(void)
+{
+    while (fifo_get != fifo_put) {
+        if (gpu_stalled) {
+            vblank_count++;
+            pthread_cond_broadcast(&changed);
+        }
+        pthread_cond_wait(&changed, &lock);
+    }
+}
+
+int pb_init(void)
+{
+    static bool initialised = false;
+    if (!initialised) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, gpu_thread, NULL) != 0) {
+            return -1;
+        }
+        pthread_detach(thread);
+        initialised = true;
+    }
+    return 0;
+}
+
+void pb_show_front_screen(void)
+{
+}
+
+int pb_back_buffer_width(void)
+{
+    return 640;
+}
+
+int pb_back_buffer_height(void)
+{
+    return 480;
+}
+
+void pb_reset(void)
+{
+}
+
+void pb_target_back_buffer(void)
+{
+}
+
+uint32_t *pb_begin(void)
+{
+    return staging;
+}
+
+void pb_end(uint32_t *p)
+{
+    assert(p >= staging && p <= staging + STAGING_WORDS);
+    submit(staging, (uint64_t)(p - staging));
+}
+
+void pb_push(uint32_t *p, uint32_t command, uint32_t nparam)
+{
+    *p = nparam << 18 | command;
+}
+
+uint32_t *pb_push1(uint32_t *p, uint32_t command, uint32_t param1)
+{
+    pb_push(p, command, 1);
+    p[1] = param1;
+    return p + 2;
+}
+
+int pb_busy(void)
+{
+    pthread_mutex_lock(&lock);
+    const bool busy = fifo_get != fifo_put;
+    if (vblank_hz == 0 && gpu_stalled) {
+        // Stands in for the time spent polling until the vertical blank
+        vblank_count++;
+        pthread_cond_broadcast(&changed);
+    }
+    pthread_mutex_unlock(&lock);
+    return busy;
+}
+
+int pb_finished(void)
+{
+    pthread_mutex_lock(&lock);
+    if (swaps_pending == SWAPS_MAX) {
+        pthread_mutex_unlock(&lock);
+        return 1;
+    }
+    swaps_pending++;
+    pthread_mutex_unlock(&lock);
+
+    const uint32_t swap[2] = {1 << 18 | NV097_FLIP_STALL, 0};
+    submit(swap, 2);
+    return 0;
+}
+
+void pb_wait_for_vbl(void)
+{
+    pthread_mutex_lock(&lock);
+    if (vblank_hz > 0) {
+        const uint64_t vblank = vblank_count;
+        while (vblank_count == vblank) {
+            pthread_cond_wait(&changed, &lock);
+        }
+    } else {
+        vblank_count++;
+        pthread_cond_broadcast(&changed);
+
+        // Give the GPU the rest of the frame, until it runs out of work or stalls on the next swap
+        while (fifo_get != fifo_put && !(gpu_stalled && gpu_stall_vblank == vblank_count)) {
+            pthread_cond_wait(&changed, &lock);
+        }
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+int pb_host_set_vblank_rate(int hz)
+{
+    assert(vblank_hz == 0 && hz > 0);
+    vblank_hz = hz;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, vblank_thread, NULL) != 0) {
+        vblank_hz = 0;
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
+
+void pb_create_dma_ctx(uint32_t ChannelID, uint32_t Class, uint32_t Base, uint32_t Limit, struct s_CtxDma *pDmaObject)
+{
+    (void)Base, (void)Limit;
+    *pDmaObject = (struct s_CtxDma){.ChannelID = ChannelID, .Class = Class};
+}
+
+void pb_bind_channel(struct s_CtxDma *pCtxDmaObject)
+{
+    (void)pCtxDmaObject;
+}
+
+void pb_host_hold(bool hold)
+{
+    pthread_mutex_lock(&lock);
+    gpu_held = hold;
+    pthread_cond_broadcast(&changed);
+    pthread_mutex_unlock(&lock);
+}
+
+void pb_host_get_stats(pb_host_stats_t *stats_out)
+{
+    pthread_mutex_lock(&lock);
+    drain();
+    *stats_out = stats;
+    pthread_mutex_unlock(&lock);
+}
+
+void pb_host_reset_stats(void)
+{
+    pthread_mutex_lock(&lock);
+    drain();
+    memset(&stats, 0, sizeof(stats));
+    pthread_mutex_unlock(&lock);
+}
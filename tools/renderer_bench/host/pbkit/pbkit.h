@@ -0,0 +1,59 @@
+#pragma once
+
+// Host stand-in for pbkit. The software renderer only includes it for xgu.h, renderer_bench_nv2a and
+// renderer_fence_test run the real support_renderer.c against the implementation in pbkit.c. Words pushed between pb_begin and pb_end are queued for a
+// thread standing in for the NV2A, which works through them in order, counts the draw calls and quads, writes semaphore
+// releases to memory and stalls on a queued back buffer swap until the next vertical blank.
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nv_regs.h"
+
+#define DMA_CLASS_3D 0x3D
+#define MAXRAM       0x03FFAFFF
+
+struct s_CtxDma
+{
+    uint32_t ChannelID;
+    uint32_t Inst;
+    uint32_t Class;
+    uint32_t isGr;
+};
+
+int pb_init(void);
+void pb_show_front_screen(void);
+int pb_back_buffer_width(void);
+int pb_back_buffer_height(void);
+void pb_reset(void);
+void pb_target_back_buffer(void);
+
+uint32_t *pb_begin(void);
+void pb_end(uint32_t *p);
+void pb_push(uint32_t *p, uint32_t command, uint32_t nparam);
+uint32_t *pb_push1(uint32_t *p, uint32_t command, uint32_t param1);
+
+int pb_busy(void);
+int pb_finished(void);
+void pb_wait_for_vbl(void);
+
+void pb_create_dma_ctx(uint32_t ChannelID, uint32_t Class, uint32_t Base, uint32_t Limit, struct s_CtxDma *pDmaObject);
+void pb_bind_channel(struct s_CtxDma *pCtxDmaObject);
+
+// Host only, what the stand-in GPU has been given and has executed since the last reset
+typedef struct pb_host_stats
+{
+    uint64_t words;      // Push buffer words submitted with pb_end, including the swaps queued by pb_finished
+    uint64_t draw_calls; // NV097_SET_BEGIN_END pairs
+    uint64_t quads;      // From inline vertices and NV097_DRAW_ARRAYS
+    uint64_t flips;      // Back buffer swaps retired on a vertical blank
+} pb_host_stats_t;
+
+// Signals vertical blanks at a fixed rate from then on, rather than whenever pb_wait_for_vbl is called
+int pb_host_set_vblank_rate(int hz);
+
+// Stops the GPU before the next method it would execute until released, to check what waits on it
+void pb_host_hold(bool hold);
+
+// Both first let the GPU work through everything submitted so far, retiring any swap it stalls on
+void pb_host_get_stats(pb_host_stats_t *stats);
+void pb_host_reset_stats(void);
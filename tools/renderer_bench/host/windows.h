@@ -0,0 +1,67 @@
+#pragma once
+
+// Host stand-in for the nxdk windows.h. main.h only needs HANDLE, the rest is the kernel memory and thread calls
+// support_renderer.c makes. Contiguous memory is mapped below 2 GB so its address fits the 32 bit registers the
+// renderer writes it to, and doubles as the physical address the host pbkit reads it back through.
+#include <sched.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <time.h>
+
+typedef void *HANDLE;
+
+#define PAGE_SIZE         0x1000
+#define PAGE_READONLY     0x02
+#define PAGE_READWRITE    0x04
+#define PAGE_WRITECOMBINE 0x400
+
+// The mapping's length is kept in a page of its own in front of the memory handed out
+static inline void *MmAllocateContiguousMemoryEx(size_t size, uintptr_t lowest, uintptr_t highest, size_t alignment,
+                                                 uint32_t protect)
+{
+    (void)lowest, (void)highest, (void)alignment, (void)protect;
+    const size_t length = PAGE_SIZE + ((size + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1));
+    uint8_t *mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+    *(size_t *)mapping = length;
+    return mapping + PAGE_SIZE;
+}
+
+static inline void MmFreeContiguousMemory(void *address)
+{
+    uint8_t *mapping = (uint8_t *)address - PAGE_SIZE;
+    munmap(mapping, *(size_t *)mapping);
+}
+
+static inline uintptr_t MmGetPhysicalAddress(void *address)
+{
+    return (uintptr_t)address;
+}
+
+static inline void MmSetAddressProtect(void *address, size_t size, uint32_t protect)
+{
+    mprotect(address, size, (protect & PAGE_READONLY) ? PROT_READ : PROT_READ | PROT_WRITE);
+}
+
+static inline void Sleep(uint32_t milliseconds)
+{
+    if (milliseconds == 0) {
+        sched_yield();
+        return;
+    }
+    const struct timespec duration = {milliseconds / 1000, (milliseconds % 1000) * 1000000L};
+    nanosleep(&duration, NULL);
+}
+
+static inline void DbgPrint(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
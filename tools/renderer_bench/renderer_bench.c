@@ -0,0 +1,737 @@
+/* renderer_bench.c
+ * Renders the dashboard screens headlessly with the software renderer backend and reports how much work each
+ * frame took. The frame layout mirrors the main loop in main.c, and menus are drawn by the same support_menu.c.
+ * Built as renderer_bench_nv2a it runs the real support_renderer.c against the host pbkit in host/pbkit instead, and
+ * reports the push buffer words, draw calls and quads the GPU would be given. That build has no framebuffer to compare.
+ *
+ * Usage: renderer_bench <assets_dir> [frames] [--sdf] [--menu-items <count>] [--golden <image.ppm>]
+ *                       [--write-golden <image.ppm>] [--max-draw-calls <count>] [--max-quads <count>]
+ *                       [--max-push-buffer-words <count>] [--vblank-hz <rate>] [--text-bench] [--csv <timings.csv>]
+ *
+ * Fonts are loaded from atlases baked at build time by tools/font_baker, like main.c does, and the time packing them
+ * at runtime would take instead is reported alongside.
+ * --sdf draws the text from one signed distance field atlas per typeface instead of an atlas per font size.
+ * --menu-items replaces the second menu with a list of that many items, supplied on demand through get_item.
+ *
+ * The last frame rendered can be written out or compared against a previously written image, so changes to the
+ * text or renderer code can be checked for unintended output differences. The image depends on the frame count.
+ * The background is the paletted background.bin the build encodes with tools/texture_encoder, loaded the way main.c
+ * loads the copy it embeds, so the image also covers decoding swizzled and paletted textures.
+ *
+ * --max-draw-calls, --max-quads and --max-push-buffer-words fail the run when the average per frame rises above the
+ * given count, so a change that breaks batching shows up in ctest rather than only as a slower frame on hardware.
+ * Push buffer words are only counted by renderer_bench_nv2a.
+ *
+ * --vblank-hz has the host pbkit signal vertical blanks at that rate, rather than as soon as the renderer waits for
+ * one, and the GPU take as long as its fill rate would to draw each frame. The main thread's CPU time per frame then
+ * shows how much of a frame the renderer spends polling the GPU instead of blocking. renderer_bench_nv2a only.
+ *
+ * --text-bench also times text_calculate_width over the menu labels against reading the metrics from the font tables
+ * for every character, which is what it did before the advance widths were cached. It then packs the same codepoints
+ * as more and more ranges and times finding each glyph by scanning them against finding it through a page table, the
+ * two lookups support_text.c picks between by FONT_GLYPH_SCAN_RANGES.
+ *
+ * Frames are timed with the same profiler stages as main.c, --csv writes the last PROFILER_HISTORY_FRAMES of them out
+ * in the format the on-screen overlay summarises.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "main.h"
+#include "support_profiler.h"
+#include "support_utf8.h"
+#ifdef RENDERER_BENCH_NV2A
+#include <pbkit/pbkit.h>
+#else
+#include "support_renderer_soft.h"
+#endif
+
+#define NANOPRINTF_IMPLEMENTATION
+#define NANOPRINTF_USE_LARGE_FORMAT_SPECIFIERS       1
+#define NANOPRINTF_USE_FIELD_WIDTH_FORMAT_SPECIFIERS 1
+#define NANOPRINTF_USE_PRECISION_FORMAT_SPECIFIERS   1
+#define NANOPRINTF_USE_FLOAT_FORMAT_SPECIFIERS       1
+#define NANOPRINTF_USE_SMALL_FORMAT_SPECIFIERS       1
+#define NANOPRINTF_USE_BINARY_FORMAT_SPECIFIERS      0
+#define NANOPRINTF_USE_WRITEBACK_FORMAT_SPECIFIERS   0
+#define NANOPRINTF_USE_ALT_FORM_FLAG                 1
+#define NANOPRINTF_SNPRINTF_SAFE_EMPTY_STRING_ON_OVERFLOW
+#include <nanoprintf/nanoprintf.h>
+
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <stb/stb_rect_pack.h>
+
+#define STB_TRUETYPE_IMPLEMENTATION
+#include <stb/stb_truetype.h>
+
+// Frames are rendered as if the dashboard were running at full rate on a 60 Hz display
+#define BENCH_FRAME_TIME (1.0f / 60.0f)
+
+// Each text benchmark measures this many passes over the menu labels
+#define TEXT_BENCH_ITERATIONS 20000
+
+// The glyph lookup benchmark packs ASCII through the end of Cyrillic as 1, 2, 4 and so on up to this many ranges
+#define TEXT_BENCH_SPAN_FIRST 32
+#define TEXT_BENCH_SPAN_LAST  0x4FF
+#define TEXT_BENCH_RANGES_MAX 32
+
+// Codepoints packed for the dashboard fonts, as in main.c and the add_baked_font calls in CMakeLists.txt
+static const int font_ranges[][2] = {{32, 127}};
+static const int font_range_count = sizeof(font_ranges) / sizeof(font_ranges[0]);
+
+static void callback_stub(void)
+{
+}
+
+// Same labels as menu_main.c
+static MenuItem main_menu_items[] = {
+    {"Main Menu", NULL},
+    {"System Info", callback_stub},
+    {"EEPROM Settings", callback_stub},
+    {"Clear Cache", callback_stub},
+    {"Install", callback_stub},
+    {"Reboot", callback_stub}};
+
+// Representative of menu_system_info.c, long enough to scroll
+static MenuItem info_menu_items[] = {
+    {"System Info", NULL},
+    {"CPU: 733.33 MHz", NULL},
+    {"RAM: 64 MB", NULL},
+    {"Kernel Version: 1.0.5838.1", NULL},
+    {"Hardware Version: 1.0", NULL},
+    {"Encoder: Conexant", NULL},
+    {"AV Pack: Composite", NULL},
+    {"Video Mode: 640x480", NULL},
+    {"HDD Model: QEMU HARDDISK", NULL},
+    {"HDD Serial: QM00001", NULL},
+    {"DVD Model: QEMU DVD-ROM", NULL},
+    {"MAC Address: 00:50:F2:00:00:00", NULL},
+    {"Serial Number: 000000000000", NULL},
+    {"Game Region: North America", NULL}};
+
+// Stands in for a game list, each label is written on request into a shared buffer
+static const MenuItem *game_list_get_item(int index)
+{
+    static char label[32];
+    static MenuItem item;
+    if (index == 0) {
+        snprintf(label, sizeof(label), "Games");
+    } else {
+        snprintf(label, sizeof(label), "Game %05d.iso", index);
+    }
+    item.label = label;
+    item.callback = callback_stub;
+    return &item;
+}
+
+static Menu menus[] = {
+    {.item = main_menu_items, .item_count = sizeof(main_menu_items) / sizeof(main_menu_items[0]), .selected_index = 1},
+    {.item = info_menu_items, .item_count = sizeof(info_menu_items) / sizeof(info_menu_items[0]), .selected_index = 1}};
+
+void _putc(int c, void *ctx)
+{
+    (void)ctx;
+    putchar(c);
+}
+
+static unsigned char *read_file(const char *directory, const char *name, size_t *size_out)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    unsigned char *data = malloc(size);
+    if (data != NULL && fread(data, 1, size, f) != (size_t)size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    if (data != NULL && size_out != NULL) {
+        *size_out = size;
+    }
+    return data;
+}
+
+// Everything that changes over time is derived from the frame number so runs are reproducible
+static void render_frame(int frame, Font *body_font, renderer_list_t *chrome_list)
+{
+    Menu *current_menu = &menus[(frame / 120) % 2];
+    current_menu->selected_index = 1 + (frame / 10) % (current_menu->item_count - 1);
+
+    profiler_frame_begin();
+    renderer_start();
+
+    profiler_begin(PROFILER_STAGE_BACKGROUND);
+    const float x_offset = (float)((frame % 508) * (BACKGROUND_SCROLL_SPEED * BENCH_FRAME_TIME));
+    xgu_texture_boundary_t boundary = {0 + x_offset, 640 + x_offset, 0, 480};
+    renderer_list_set_boundary(chrome_list, 0, &boundary);
+    renderer_list_draw(chrome_list);
+    profiler_end(PROFILER_STAGE_BACKGROUND);
+
+    profiler_begin(PROFILER_STAGE_HEADER);
+    char menu_text_buffer[64];
+    snprintf(menu_text_buffer, sizeof(menu_text_buffer), "2001-11-15 00:%02d:%02d", (frame / 3600) % 60, (frame / 60) % 60);
+    text_draw(body_font, menu_text_buffer, WINDOW_WIDTH - X_MARGIN - text_calculate_width(body_font, menu_text_buffer),
+              Y_MARGIN + BODY_FONT_SIZE, &info_color);
+    profiler_end(PROFILER_STAGE_HEADER);
+
+    profiler_begin(PROFILER_STAGE_FOOTER);
+    snprintf(menu_text_buffer, sizeof(menu_text_buffer), "Tray State: %s", "Closed");
+    text_draw(body_font, menu_text_buffer, WINDOW_WIDTH - X_MARGIN - text_calculate_width(body_font, menu_text_buffer),
+              FOOTER_Y, &text_color);
+
+    snprintf(menu_text_buffer, sizeof(menu_text_buffer), "FTP Server - %s", "Active");
+    text_draw(body_font, menu_text_buffer, WINDOW_WIDTH - X_MARGIN - text_calculate_width(body_font, menu_text_buffer),
+              FOOTER_Y + BODY_FONT_SIZE, &text_color);
+    profiler_end(PROFILER_STAGE_FOOTER);
+
+    profiler_begin(PROFILER_STAGE_MENU);
+    menu_render(current_menu, body_font, BENCH_FRAME_TIME);
+    profiler_end(PROFILER_STAGE_MENU);
+
+#ifdef RENDERER_BENCH_NV2A
+    renderer_present();
+#else
+    // The software renderer has no GPU to wait on, presenting is all submission
+    profiler_begin(PROFILER_STAGE_SUBMIT);
+    renderer_present();
+    profiler_end(PROFILER_STAGE_SUBMIT);
+#endif
+    profiler_frame_end();
+}
+
+typedef struct bench_stats
+{
+    uint64_t draw_calls;
+    uint64_t quads;
+    uint64_t pixels_blended;    // Software renderer only
+    uint64_t push_buffer_words; // renderer_bench_nv2a only
+} bench_stats_t;
+
+static void bench_reset_stats(void)
+{
+#ifdef RENDERER_BENCH_NV2A
+    pb_host_reset_stats();
+#else
+    renderer_soft_reset_stats();
+#endif
+}
+
+static void bench_get_stats(bench_stats_t *stats)
+{
+#ifdef RENDERER_BENCH_NV2A
+    pb_host_stats_t host_stats;
+    pb_host_get_stats(&host_stats);
+    *stats = (bench_stats_t){.draw_calls = host_stats.draw_calls, .quads = host_stats.quads,
+                             .push_buffer_words = host_stats.words};
+#else
+    renderer_soft_stats_t soft_stats;
+    renderer_soft_get_stats(&soft_stats);
+    *stats = (bench_stats_t){.draw_calls = soft_stats.draw_calls, .quads = soft_stats.quads,
+                             .pixels_blended = soft_stats.pixels_blended};
+#endif
+}
+
+#ifndef RENDERER_BENCH_NV2A
+static int write_ppm(const char *path, const uint32_t *pixels)
+{
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        return -1;
+    }
+    fprintf(f, "P6\n%d %d\n255\n", RENDERER_SOFT_WIDTH, RENDERER_SOFT_HEIGHT);
+    for (int i = 0; i < RENDERER_SOFT_WIDTH * RENDERER_SOFT_HEIGHT; i++) {
+        const uint8_t rgb[3] = {pixels[i] & 0xFF, (pixels[i] >> 8) & 0xFF, (pixels[i] >> 16) & 0xFF};
+        fwrite(rgb, 1, 3, f);
+    }
+    fclose(f);
+    return 0;
+}
+
+// Returns the number of pixels that differ from the golden image, or -1 if it couldn't be read
+static int compare_ppm(const char *path, const uint32_t *pixels)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return -1;
+    }
+
+    int width, height, max_value;
+    if (fscanf(f, "P6 %d %d %d", &width, &height, &max_value) != 3 || fgetc(f) == EOF ||
+        width != RENDERER_SOFT_WIDTH || height != RENDERER_SOFT_HEIGHT || max_value != 255) {
+        fclose(f);
+        return -1;
+    }
+
+    int mismatches = 0;
+    for (int i = 0; i < RENDERER_SOFT_WIDTH * RENDERER_SOFT_HEIGHT; i++) {
+        uint8_t rgb[3];
+        if (fread(rgb, 1, 3, f) != 3) {
+            fclose(f);
+            return -1;
+        }
+        const uint32_t pixel = rgb[0] | rgb[1] << 8 | rgb[2] << 16;
+        mismatches += (pixel != (pixels[i] & 0x00FFFFFF));
+    }
+    fclose(f);
+    return mismatches;
+}
+#endif
+
+static double seconds_between(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Measures the width by looking up every character in the font tables, without any of the caching in support_text.c
+static int reference_text_width(Font *font, const char *text)
+{
+    int codepoint[64];
+    int xadvance = 0;
+    size_t length = strlen(text);
+    while (length > 0) {
+        size_t consumed;
+        const int count = utf8_decode(text, length, codepoint, 64, &consumed);
+        text += consumed;
+        length -= consumed;
+
+        for (int i = 0; i < count; i++) {
+            int advance_width = 0;
+            int index = stbtt_FindGlyphIndex(&font->font_info, codepoint[i]);
+            if (index == 0) {
+                index = stbtt_FindGlyphIndex(&font->font_info, '-');
+            }
+            stbtt_GetGlyphHMetrics(&font->font_info, index, &advance_width, NULL);
+            xadvance += advance_width;
+        }
+    }
+    return (int)((float)xadvance * font->scale);
+}
+
+// Finds the glyph by scanning the packed ranges in order, the lookup support_text.c used before the page table
+static int range_scan_text_width(Font *font, const char *text)
+{
+    int codepoint[64];
+    int xadvance = 0;
+    size_t length = strlen(text);
+    while (length > 0) {
+        size_t consumed;
+        const int count = utf8_decode(text, length, codepoint, 64, &consumed);
+        text += consumed;
+        length -= consumed;
+
+        for (int i = 0; i < count; i++) {
+            int offset = 0;
+            for (int r = 0; r < font->range_count; r++) {
+                const stbtt_pack_range *range = &font->range[r];
+                if (codepoint[i] >= range->first_unicode_codepoint_in_range &&
+                    codepoint[i] < range->first_unicode_codepoint_in_range + range->num_chars) {
+                    xadvance += font->advance[offset + codepoint[i] - range->first_unicode_codepoint_in_range];
+                    break;
+                }
+                offset += range->num_chars;
+            }
+        }
+    }
+    return (int)((float)xadvance * font->scale);
+}
+
+// Page table as support_text.c builds for fonts with more than FONT_GLYPH_SCAN_RANGES ranges, built here for any
+// font so both lookups can be timed whatever the range count
+static uint16_t *bench_glyph_page[FONT_GLYPH_PAGE_COUNT];
+
+static int build_glyph_pages(const Font *font)
+{
+    for (int r = 0, packed_index = 0; r < font->range_count; r++) {
+        for (int j = 0; j < font->range[r].num_chars; j++, packed_index++) {
+            const int codepoint = font->range[r].first_unicode_codepoint_in_range + j;
+            uint16_t **page = &bench_glyph_page[codepoint / FONT_GLYPH_PAGE_SIZE];
+            if (*page == NULL) {
+                *page = malloc(sizeof(uint16_t) * FONT_GLYPH_PAGE_SIZE);
+                if (*page == NULL) {
+                    return -1;
+                }
+                memset(*page, 0xFF, sizeof(uint16_t) * FONT_GLYPH_PAGE_SIZE);
+            }
+            (*page)[codepoint % FONT_GLYPH_PAGE_SIZE] = packed_index;
+        }
+    }
+    return 0;
+}
+
+static int page_table_text_width(Font *font, const char *text)
+{
+    int codepoint[64];
+    int xadvance = 0;
+    size_t length = strlen(text);
+    while (length > 0) {
+        size_t consumed;
+        const int count = utf8_decode(text, length, codepoint, 64, &consumed);
+        text += consumed;
+        length -= consumed;
+
+        for (int i = 0; i < count; i++) {
+            const uint16_t *page = bench_glyph_page[codepoint[i] / FONT_GLYPH_PAGE_SIZE];
+            if (page != NULL && page[codepoint[i] % FONT_GLYPH_PAGE_SIZE] != FONT_GLYPH_NONE) {
+                xadvance += font->advance[page[codepoint[i] % FONT_GLYPH_PAGE_SIZE]];
+            }
+        }
+    }
+    return (int)((float)xadvance * font->scale);
+}
+
+// Frees everything text_create allocated for the font, along with the page table built for it above
+static void destroy_font(Font *font)
+{
+    if (font->texture != NULL) {
+        texture_destroy(font->texture);
+    }
+    if (font->dynamic_texture != NULL) {
+        texture_destroy(font->dynamic_texture);
+    }
+    for (int i = 0; i < FONT_GLYPH_PAGE_COUNT; i++) {
+        free(font->glyph_page[i]);
+        free(bench_glyph_page[i]);
+        bench_glyph_page[i] = NULL;
+    }
+    free(font->range);
+    free(font->packed_chars);
+    free(font->advance);
+    free(font->dynamic_glyph);
+}
+
+// Returns the time per byte of UTF-8 taken to measure every label, or a negative value if a width differs from
+// text_calculate_width
+static double time_text_width(Font *font, const char *const *labels, int label_count,
+                              int (*width)(Font *font, const char *text))
+{
+    long bytes = 0;
+    for (int i = 0; i < label_count; i++) {
+        if (width(font, labels[i]) != text_calculate_width(font, labels[i])) {
+            fprintf(stderr, "Width of \"%s\" differs from text_calculate_width\n", labels[i]);
+            return -1.0;
+        }
+        bytes += (long)strlen(labels[i]);
+    }
+
+    // Summed into a volatile so the calls can't be optimised away
+    volatile int width_sum = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int n = 0; n < TEXT_BENCH_ITERATIONS; n++) {
+        for (int i = 0; i < label_count; i++) {
+            width_sum += width(font, labels[i]);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    (void)width_sum;
+    return seconds_between(&start, &end) * 1e9 / ((double)bytes * TEXT_BENCH_ITERATIONS);
+}
+
+// Returns 0 if every measurement agreed with text_calculate_width, -1 otherwise
+static int run_text_bench(Font *font, const unsigned char *ttf_data)
+{
+    const char *labels[sizeof(info_menu_items) / sizeof(info_menu_items[0])];
+    const int label_count = sizeof(labels) / sizeof(labels[0]);
+    for (int i = 0; i < label_count; i++) {
+        labels[i] = info_menu_items[i].label;
+    }
+
+    const double cached = time_text_width(font, labels, label_count, text_calculate_width);
+    const double tables = time_text_width(font, labels, label_count, reference_text_width);
+    const double scan = time_text_width(font, labels, label_count, range_scan_text_width);
+    if (cached < 0.0 || tables < 0.0 || scan < 0.0) {
+        return -1;
+    }
+    printf("Text width: %.1f ns per byte, %.1f ns reading the font tables (%.1fx), %.1f ns scanning the ranges\n",
+           cached, tables, tables / cached, scan);
+
+    // Text in several scripts, measured with fonts packing the same codepoints as more and more ranges. Glyphs in the
+    // later ranges take the longest to find by scanning, the page table takes the same time however many there are.
+    static const char *const extended_labels[] = {"Системная информация", "Ελληνικά γράμματα", "Größe: 8 GB",
+                                                  "Région: Amérique du Nord"};
+    const int extended_count = sizeof(extended_labels) / sizeof(extended_labels[0]);
+    printf("Glyph lookup over Latin, Greek and Cyrillic text, ns per byte:\n");
+    for (int range_count = 1; range_count <= TEXT_BENCH_RANGES_MAX; range_count *= 2) {
+        int range[TEXT_BENCH_RANGES_MAX][2];
+        const int span = TEXT_BENCH_SPAN_LAST - TEXT_BENCH_SPAN_FIRST + 1;
+        for (int r = 0; r < range_count; r++) {
+            range[r][0] = TEXT_BENCH_SPAN_FIRST + span * r / range_count;
+            range[r][1] = TEXT_BENCH_SPAN_FIRST + span * (r + 1) / range_count - 1;
+        }
+
+        Font extended_font = {0};
+        if (text_create(ttf_data, BODY_FONT_SIZE, (const int(*)[2])range, range_count, &extended_font) != 0 ||
+            build_glyph_pages(&extended_font) != 0) {
+            fprintf(stderr, "Could not create the extended font\n");
+            destroy_font(&extended_font);
+            return -1;
+        }
+        const double lookup = time_text_width(&extended_font, extended_labels, extended_count, text_calculate_width);
+        const double extended_scan =
+            time_text_width(&extended_font, extended_labels, extended_count, range_scan_text_width);
+        const double page_table = time_text_width(&extended_font, extended_labels, extended_count, page_table_text_width);
+        destroy_font(&extended_font);
+        if (lookup < 0.0 || extended_scan < 0.0 || page_table < 0.0) {
+            return -1;
+        }
+        printf("  %2d ranges: %.1f text_calculate_width, %.1f scanning the ranges, %.1f through the page table (%s)\n",
+               range_count, lookup, extended_scan, page_table,
+               (range_count > FONT_GLYPH_SCAN_RANGES) ? "uses the page table" : "scans the ranges");
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <assets_dir> [frames] [--sdf] [--menu-items <count>] [--golden <image.ppm>] [--write-golden <image.ppm>] [--max-draw-calls <count>] [--max-quads <count>] [--max-push-buffer-words <count>] [--vblank-hz <rate>] [--text-bench] [--csv <timings.csv>]\n", argv[0]);
+        return 1;
+    }
+
+    const char *assets_dir = argv[1];
+    int frames = 1000;
+    const char *golden_path = NULL;
+    const char *write_golden_path = NULL;
+    bool sdf_fonts = false;
+    int menu_items = 0;
+    double max_draw_calls = 0.0;
+    double max_quads = 0.0;
+    double max_push_buffer_words = 0.0;
+    int vblank_hz = 0;
+    bool text_bench = false;
+    const char *csv_path = NULL;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+            golden_path = argv[++i];
+        } else if (strcmp(argv[i], "--write-golden") == 0 && i + 1 < argc) {
+            write_golden_path = argv[++i];
+        } else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+            csv_path = argv[++i];
+        } else if (strcmp(argv[i], "--text-bench") == 0) {
+            text_bench = true;
+        } else if (strcmp(argv[i], "--sdf") == 0) {
+            sdf_fonts = true;
+        } else if (strcmp(argv[i], "--menu-items") == 0 && i + 1 < argc) {
+            menu_items = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-draw-calls") == 0 && i + 1 < argc) {
+            max_draw_calls = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--max-quads") == 0 && i + 1 < argc) {
+            max_quads = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--max-push-buffer-words") == 0 && i + 1 < argc) {
+            max_push_buffer_words = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--vblank-hz") == 0 && i + 1 < argc) {
+            vblank_hz = atoi(argv[++i]);
+        } else {
+            frames = atoi(argv[i]);
+        }
+    }
+    if (frames <= 0) {
+        fprintf(stderr, "Invalid frame count\n");
+        return 1;
+    }
+#ifdef RENDERER_BENCH_NV2A
+    if (golden_path != NULL || write_golden_path != NULL) {
+        fprintf(stderr, "Golden images need the software renderer, use renderer_bench\n");
+        return 1;
+    }
+    if (vblank_hz > 0 && pb_host_set_vblank_rate(vblank_hz) != 0) {
+        fprintf(stderr, "Could not start the vertical blank timer\n");
+        return 1;
+    }
+#else
+    if (vblank_hz > 0) {
+        fprintf(stderr, "The software renderer has no vertical blank, use renderer_bench_nv2a\n");
+        return 1;
+    }
+#endif
+    if (menu_items > 1) {
+        // The second menu becomes a long list supplied on demand, stepped through like the others
+        menus[1] = (Menu){.item_count = menu_items, .selected_index = 1, .get_item = game_list_get_item};
+    }
+
+    unsigned char *body_ttf = read_file(assets_dir, "RobotoMono-Regular.ttf", NULL);
+    unsigned char *header_ttf = read_file(assets_dir, "UbuntuMono-Regular.ttf", NULL);
+    if (body_ttf == NULL || header_ttf == NULL) {
+        fprintf(stderr, "Could not read the fonts from %s\n", assets_dir);
+        return 1;
+    }
+
+    // The background is the paletted texture the dashboard embeds, encoded from assets/background.png at build time
+    size_t background_size;
+    unsigned char *background_asset = read_file(ENCODED_ASSET_DIR, "background.bin", &background_size);
+    if (background_asset == NULL) {
+        fprintf(stderr, "Could not read %s/background.bin\n", ENCODED_ASSET_DIR);
+        return 1;
+    }
+
+    // Like main.c, the fonts are loaded from the atlases baked at build time unless they are drawn from distance fields
+    size_t body_atlas_size, header_atlas_size;
+    unsigned char *body_atlas = read_file(ENCODED_ASSET_DIR, "RobotoMono-Regular-26.bin", &body_atlas_size);
+    unsigned char *header_atlas = read_file(ENCODED_ASSET_DIR, "UbuntuMono-Regular-48.bin", &header_atlas_size);
+    if (body_atlas == NULL || header_atlas == NULL) {
+        fprintf(stderr, "Could not read the baked font atlases from %s\n", ENCODED_ASSET_DIR);
+        return 1;
+    }
+
+    renderer_initialise();
+    profiler_initialise();
+
+    Font body_font = {0}, header_font = {0};
+    Font body_sdf_font = {0}, header_sdf_font = {0};
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (sdf_fonts) {
+        if (text_create_sdf(body_ttf, font_ranges, font_range_count, &body_sdf_font) != 0 ||
+            text_create_sdf(header_ttf, font_ranges, font_range_count, &header_sdf_font) != 0 ||
+            text_create_sdf_scaled(&body_sdf_font, BODY_FONT_SIZE, &body_font) != 0 ||
+            text_create_sdf_scaled(&header_sdf_font, HEADER_FONT_SIZE, &header_font) != 0) {
+            fprintf(stderr, "Could not create the fonts\n");
+            return 1;
+        }
+    } else if (text_create_baked(body_atlas, body_atlas_size, body_ttf, BODY_FONT_SIZE, font_ranges, font_range_count,
+                                 &body_font) != 0 ||
+               text_create_baked(header_atlas, header_atlas_size, header_ttf, HEADER_FONT_SIZE, font_ranges,
+                                 font_range_count, &header_font) != 0) {
+        fprintf(stderr, "The baked font atlases don't match the font sizes and ranges\n");
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    free(body_atlas);
+    free(header_atlas);
+
+    // Atlas memory is what the GPU would hold, the distance field atlases are shared between sizes
+    xgu_texture_t *atlas[2] = {(sdf_fonts) ? body_sdf_font.texture : body_font.texture,
+                                     (sdf_fonts) ? header_sdf_font.texture : header_font.texture};
+    printf("Fonts created in %.2f ms, atlases %ux%u + %ux%u\n", seconds_between(&start, &end) * 1000.0,
+           atlas[0]->data_width, atlas[0]->data_height, atlas[1]->data_width, atlas[1]->data_height);
+
+    if (!sdf_fonts) {
+        // What startup would take if the baked atlases were rejected and the fonts packed at runtime instead
+        Font packed_body_font = {0}, packed_header_font = {0};
+        struct timespec packing_start, packing_end;
+        clock_gettime(CLOCK_MONOTONIC, &packing_start);
+        const int packed = text_create(body_ttf, BODY_FONT_SIZE, font_ranges, font_range_count, &packed_body_font) == 0 &&
+                           text_create(header_ttf, HEADER_FONT_SIZE, font_ranges, font_range_count, &packed_header_font) == 0;
+        clock_gettime(CLOCK_MONOTONIC, &packing_end);
+        destroy_font(&packed_body_font);
+        destroy_font(&packed_header_font);
+        if (!packed) {
+            fprintf(stderr, "Could not pack the fonts\n");
+            return 1;
+        }
+        printf("Packing them at runtime instead takes %.2f ms (%.0fx)\n",
+               seconds_between(&packing_start, &packing_end) * 1000.0,
+               seconds_between(&packing_start, &packing_end) / seconds_between(&start, &end));
+    }
+
+    xgu_texture_t *background_texture = texture_create_from_asset(background_asset, background_size);
+    free(background_asset);
+    if (background_texture == NULL) {
+        fprintf(stderr, "Could not load %s/background.bin\n", ENCODED_ASSET_DIR);
+        return 1;
+    }
+
+    // The background and header are recorded once like in main.c
+    const xgu_texture_boundary_t background_boundary = {0, 640, 0, 480};
+    renderer_list_t *chrome_list = renderer_list_create(16);
+    renderer_list_begin(chrome_list);
+    renderer_draw_textured_rectangle(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, background_texture, NULL, &background_boundary);
+    text_draw(&header_font, "xemu", X_MARGIN, HEADER_Y, &highlight_color);
+    renderer_list_end();
+
+    bench_reset_stats();
+
+    struct timespec cpu_start, cpu_end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int frame = 0; frame < frames; frame++) {
+        render_frame(frame, &body_font, chrome_list);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+
+    const double seconds = seconds_between(&start, &end);
+    bench_stats_t stats;
+    bench_get_stats(&stats);
+
+    printf("%d frames in %.3f s: %.1f frames/s, main thread CPU time %.3f ms per frame\n", frames, seconds,
+           frames / seconds, seconds_between(&cpu_start, &cpu_end) * 1000.0 / frames);
+    const double draw_calls_per_frame = (double)stats.draw_calls / frames;
+    const double quads_per_frame = (double)stats.quads / frames;
+    const double push_buffer_words_per_frame = (double)stats.push_buffer_words / frames;
+#ifdef RENDERER_BENCH_NV2A
+    printf("Per frame: %.1f draw calls, %.1f quads, %.1f push buffer words\n", draw_calls_per_frame, quads_per_frame,
+           push_buffer_words_per_frame);
+#else
+    printf("Per frame: %.1f draw calls, %.1f quads, %.0f pixels blended\n", draw_calls_per_frame, quads_per_frame,
+           (double)stats.pixels_blended / frames);
+#endif
+
+    int result = 0;
+    if (max_draw_calls > 0.0 && draw_calls_per_frame > max_draw_calls) {
+        fprintf(stderr, "%.1f draw calls per frame, expected at most %.1f\n", draw_calls_per_frame, max_draw_calls);
+        result = 1;
+    }
+    if (max_quads > 0.0 && quads_per_frame > max_quads) {
+        fprintf(stderr, "%.1f quads per frame, expected at most %.1f\n", quads_per_frame, max_quads);
+        result = 1;
+    }
+    if (max_push_buffer_words > 0.0 && push_buffer_words_per_frame > max_push_buffer_words) {
+        fprintf(stderr, "%.1f push buffer words per frame, expected at most %.1f\n", push_buffer_words_per_frame,
+                max_push_buffer_words);
+        result = 1;
+    }
+    if (csv_path != NULL) {
+        FILE *csv = fopen(csv_path, "w");
+        if (csv == NULL) {
+            fprintf(stderr, "Could not write %s\n", csv_path);
+            result = 1;
+        } else {
+            profiler_dump_csv(csv);
+            fclose(csv);
+        }
+    }
+    if (text_bench && run_text_bench(&body_font, body_ttf) != 0) {
+        result = 1;
+    }
+#ifndef RENDERER_BENCH_NV2A
+    if (write_golden_path != NULL) {
+        if (write_ppm(write_golden_path, renderer_soft_framebuffer()) != 0) {
+            fprintf(stderr, "Could not write %s\n", write_golden_path);
+            result = 1;
+        }
+    }
+    if (golden_path != NULL) {
+        int mismatches = compare_ppm(golden_path, renderer_soft_framebuffer());
+        if (mismatches < 0) {
+            fprintf(stderr, "Could not read golden image %s\n", golden_path);
+            result = 1;
+        } else if (mismatches > 0) {
+            fprintf(stderr, "%d pixels differ from %s\n", mismatches, golden_path);
+            result = 1;
+        } else {
+            printf("Matches %s\n", golden_path);
+        }
+    }
+#endif
+
+    renderer_list_destroy(chrome_list);
+    texture_destroy(background_texture);
+    texture_destroy(atlas[0]);
+    texture_destroy(atlas[1]);
+    free(body_ttf);
+    free(header_ttf);
+    return result;
+}
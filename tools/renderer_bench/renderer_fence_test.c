@@ -0,0 +1,137 @@
+/* renderer_fence_test.c
+ * Checks the frame fences in support_renderer.c against the pbkit stand-in in host/pbkit, with vertical blanks at
+ * 60 Hz. A fence must not be signalled before the GPU has executed the semaphore release it pushed, fences must be
+ * signalled in the order they were inserted, and waiting on one must block rather than spin.
+ *
+ * Usage: renderer_fence_test
+ */
+
+#include <pbkit/pbkit.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "support_profiler.h"
+#include "support_renderer.h"
+
+#define FENCES  1000
+#define HOLD_MS 100
+
+static int failures;
+
+#define CHECK(condition, ...)             \
+    do {                                  \
+        if (!(condition)) {               \
+            fprintf(stderr, __VA_ARGS__); \
+            fputc('\n', stderr);          \
+            failures++;                   \
+        }                                 \
+    } while (0)
+
+// Only renderer_present records stages, which these checks don't call
+void profiler_begin(profiler_stage_t stage)
+{
+    (void)stage;
+}
+
+void profiler_end(profiler_stage_t stage)
+{
+    (void)stage;
+}
+
+static double elapsed_ms(clockid_t clock, const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(clock, &end);
+    return (end.tv_sec - start->tv_sec) * 1000.0 + (end.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+static void test_held(void)
+{
+    // Nothing the GPU hasn't reached yet may count as signalled
+    pb_host_hold(true);
+    const renderer_fence_t first = renderer_fence_insert();
+    const renderer_fence_t second = renderer_fence_insert();
+    const struct timespec duration = {0, HOLD_MS * 1000000L};
+    nanosleep(&duration, NULL);
+    CHECK(!renderer_fence_signalled(first), "Fence %u signalled while the GPU was held", first);
+    CHECK(!renderer_fence_signalled(second), "Fence %u signalled while the GPU was held", second);
+
+    pb_host_hold(false);
+    renderer_fence_wait(second);
+    CHECK(renderer_fence_signalled(first), "Fence %u not signalled after the later fence %u", first, second);
+}
+
+static void test_order(void)
+{
+    pb_host_hold(true);
+    renderer_fence_t fences[FENCES];
+    for (int i = 0; i < FENCES; i++) {
+        fences[i] = renderer_fence_insert();
+    }
+    pb_host_hold(false);
+
+    // Watch the GPU work through them, a signalled fence must never be followed by an earlier one that isn't
+    int signalled = 0;
+    while (signalled < FENCES) {
+        int latest = -1;
+        for (int i = FENCES - 1; i >= 0; i--) {
+            if (renderer_fence_signalled(fences[i])) {
+                latest = i;
+                break;
+            }
+        }
+        CHECK(latest + 1 >= signalled, "Fence %u no longer signalled", fences[signalled - 1]);
+        for (int i = 0; i < latest; i++) {
+            if (!renderer_fence_signalled(fences[i])) {
+                CHECK(0, "Fence %u signalled before the earlier fence %u", fences[latest], fences[i]);
+                return;
+            }
+        }
+        signalled = latest + 1;
+    }
+}
+
+static void *release_thread(void *arg)
+{
+    (void)arg;
+    const struct timespec duration = {0, HOLD_MS * 1000000L};
+    nanosleep(&duration, NULL);
+    pb_host_hold(false);
+    return NULL;
+}
+
+static void test_wait_blocks(void)
+{
+    pb_host_hold(true);
+    const renderer_fence_t fence = renderer_fence_insert();
+    pthread_t thread;
+    pthread_create(&thread, NULL, release_thread, NULL);
+
+    struct timespec start, cpu_start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+    renderer_fence_wait(fence);
+    const double wall_ms = elapsed_ms(CLOCK_MONOTONIC, &start);
+    const double cpu_ms = elapsed_ms(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+    pthread_join(thread, NULL);
+
+    CHECK(wall_ms >= HOLD_MS - 1, "Fence wait returned after %.1f ms, before the GPU was released", wall_ms);
+    // Each vertical blank only wakes the waiter once to check the semaphore
+    CHECK(cpu_ms < 5.0, "Fence wait used %.2f ms of CPU time over %.1f ms", cpu_ms, wall_ms);
+}
+
+int main(void)
+{
+    if (pb_host_set_vblank_rate(60) != 0) {
+        fprintf(stderr, "Could not start the vertical blank timer\n");
+        return 1;
+    }
+    renderer_initialise();
+
+    test_held();
+    test_order();
+    test_wait_blocks();
+    printf("%s\n", failures ? "Fence checks failed" : "Fence checks passed");
+    return failures ? 1 : 0;
+}
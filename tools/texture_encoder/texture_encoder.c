@@ -0,0 +1,309 @@
+/* texture_encoder.c
+ * Converts an image into a GPU ready texture at build time so the dashboard can upload it without decoding.
+ * The output is padded to power of two dimensions and optionally swizzled, palettised or DXT compressed.
+ *
+ * Usage: texture_encoder <input.png> <rgba|rgba_swizzled|p8|dxt1|dxt5> <output.bin>
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+
+#include "support_texture_asset.h"
+
+static const struct
+{
+    const char *name;
+    texture_asset_format_t format;
+} format_names[] = {
+    {"rgba", TEXTURE_ASSET_FORMAT_A8B8G8R8},
+    {"rgba_swizzled", TEXTURE_ASSET_FORMAT_A8B8G8R8_SWIZZLED},
+    {"p8", TEXTURE_ASSET_FORMAT_P8_SWIZZLED},
+    {"dxt1", TEXTURE_ASSET_FORMAT_DXT1},
+    {"dxt5", TEXTURE_ASSET_FORMAT_DXT5},
+};
+
+static uint32_t npot2pot(uint32_t num)
+{
+    uint32_t pot = 1;
+    while (pot < num) {
+        pot <<= 1;
+    }
+    return pot;
+}
+
+// NV2A swizzling interleaves the bits of the x and y coordinates, starting with x in bit 0.
+// Once the smaller dimension runs out of bits the rest come from the larger one.
+static uint32_t swizzle_offset(uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+    uint32_t offset = 0, bit = 0;
+    for (uint32_t mask = 1; mask < width || mask < height; mask <<= 1) {
+        if (mask < width) {
+            offset |= ((x & mask) ? 1u : 0u) << bit++;
+        }
+        if (mask < height) {
+            offset |= ((y & mask) ? 1u : 0u) << bit++;
+        }
+    }
+    return offset;
+}
+
+// Fetch a pixel from the padded image. The padding repeats the edge pixels so filtering at the border of
+// the image doesn't pull in black.
+static const uint8_t *padded_pixel(const uint8_t *rgba, int width, int height, uint32_t x, uint32_t y)
+{
+    x = (x < (uint32_t)width) ? x : (uint32_t)width - 1;
+    y = (y < (uint32_t)height) ? y : (uint32_t)height - 1;
+    return &rgba[(y * width + x) * 4];
+}
+
+static uint16_t rgb_to_565(const uint8_t *c)
+{
+    return (uint16_t)(((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3));
+}
+
+static void rgb_from_565(uint16_t v, int *c)
+{
+    c[0] = ((v >> 11) & 0x1F) * 255 / 31;
+    c[1] = ((v >> 5) & 0x3F) * 255 / 63;
+    c[2] = (v & 0x1F) * 255 / 31;
+}
+
+static int colour_distance(const int *a, const uint8_t *b)
+{
+    int dr = a[0] - b[0], dg = a[1] - b[1], db = a[2] - b[2];
+    return dr * dr + dg * dg + db * db;
+}
+
+// Encodes a 4x4 block of RGBA pixels as a DXT1 colour block. The end points are the two pixels furthest
+// apart in the block, which is crude but good enough for UI art. If allow_alpha is set, pixels with
+// alpha below 128 use the transparent index of the three colour mode.
+static void encode_colour_block(const uint8_t block[16][4], int allow_alpha, uint8_t *out)
+{
+    int best = -1, i0 = 0, i1 = 0, has_alpha = 0;
+    for (int i = 0; i < 16; i++) {
+        has_alpha |= allow_alpha && block[i][3] < 128;
+        for (int j = i + 1; j < 16; j++) {
+            int c[3] = {block[i][0], block[i][1], block[i][2]};
+            int d = colour_distance(c, block[j]);
+            if (d > best) {
+                best = d;
+                i0 = i;
+                i1 = j;
+            }
+        }
+    }
+
+    uint16_t c0 = rgb_to_565(block[i0]);
+    uint16_t c1 = rgb_to_565(block[i1]);
+
+    // c0 > c1 selects four colour mode, c0 <= c1 selects three colours plus transparent
+    if ((c0 < c1) != has_alpha) {
+        uint16_t t = c0;
+        c0 = c1;
+        c1 = t;
+    }
+
+    int palette[4][3];
+    rgb_from_565(c0, palette[0]);
+    rgb_from_565(c1, palette[1]);
+    int colour_count;
+    for (int k = 0; k < 3; k++) {
+        if (c0 > c1) {
+            palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+            palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+        } else {
+            palette[2][k] = (palette[0][k] + palette[1][k]) / 2;
+            palette[3][k] = 0;
+        }
+    }
+    colour_count = (c0 > c1) ? 4 : 3;
+
+    uint32_t indices = 0;
+    for (int i = 0; i < 16; i++) {
+        int index = 3;
+        if (!(has_alpha && block[i][3] < 128)) {
+            int best_distance = -1;
+            for (int k = 0; k < colour_count; k++) {
+                int d = colour_distance(palette[k], block[i]);
+                if (best_distance < 0 || d < best_distance) {
+                    best_distance = d;
+                    index = k;
+                }
+            }
+        }
+        indices |= (uint32_t)index << (i * 2);
+    }
+
+    out[0] = c0 & 0xFF;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xFF;
+    out[3] = c1 >> 8;
+    memcpy(&out[4], &indices, 4);
+}
+
+// Encodes the alpha channel of a 4x4 block as a DXT5 alpha block using the eight value mode
+static void encode_alpha_block(const uint8_t block[16][4], uint8_t *out)
+{
+    int a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; i++) {
+        a0 = (block[i][3] > a0) ? block[i][3] : a0;
+        a1 = (block[i][3] < a1) ? block[i][3] : a1;
+    }
+
+    int palette[8] = {a0, a1};
+    for (int k = 1; k < 7; k++) {
+        palette[k + 1] = ((7 - k) * a0 + k * a1) / 7;
+    }
+
+    uint64_t indices = 0;
+    for (int i = 0; i < 16; i++) {
+        int index = 0, best_distance = 256;
+        for (int k = 0; k < 8; k++) {
+            int d = abs(palette[k] - block[i][3]);
+            if (d < best_distance) {
+                best_distance = d;
+                index = k;
+            }
+        }
+        indices |= (uint64_t)index << (i * 3);
+    }
+
+    out[0] = (uint8_t)a0;
+    out[1] = (uint8_t)a1;
+    for (int i = 0; i < 6; i++) {
+        out[2 + i] = (indices >> (i * 8)) & 0xFF;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 4) {
+        fprintf(stderr, "Usage: %s <input.png> <rgba|rgba_swizzled|p8|dxt1|dxt5> <output.bin>\n", argv[0]);
+        return 1;
+    }
+
+    int format = -1;
+    for (size_t i = 0; i < sizeof(format_names) / sizeof(format_names[0]); i++) {
+        if (strcmp(argv[2], format_names[i].name) == 0) {
+            format = format_names[i].format;
+        }
+    }
+    if (format < 0) {
+        fprintf(stderr, "Unknown texture format %s\n", argv[2]);
+        return 1;
+    }
+
+    int width, height, channels;
+    uint8_t *rgba = stbi_load(argv[1], &width, &height, &channels, 4);
+    if (rgba == NULL) {
+        fprintf(stderr, "Could not read %s: %s\n", argv[1], stbi_failure_reason());
+        return 1;
+    }
+
+    uint32_t data_width = npot2pot(width);
+    uint32_t data_height = npot2pot(height);
+    uint32_t palette[256];
+    uint32_t palette_count = 0;
+    uint32_t data_size;
+    uint8_t *data;
+
+    if (format == TEXTURE_ASSET_FORMAT_DXT1 || format == TEXTURE_ASSET_FORMAT_DXT5) {
+        // Compressed textures are at least one 4x4 block in each direction
+        data_width = (data_width < 4) ? 4 : data_width;
+        data_height = (data_height < 4) ? 4 : data_height;
+        const uint32_t block_size = (format == TEXTURE_ASSET_FORMAT_DXT1) ? 8 : 16;
+        data_size = (data_width / 4) * (data_height / 4) * block_size;
+        data = malloc(data_size);
+
+        uint8_t *out = data;
+        for (uint32_t by = 0; by < data_height; by += 4) {
+            for (uint32_t bx = 0; bx < data_width; bx += 4) {
+                uint8_t block[16][4];
+                for (int i = 0; i < 16; i++) {
+                    memcpy(block[i], padded_pixel(rgba, width, height, bx + (i & 3), by + (i >> 2)), 4);
+                }
+                if (format == TEXTURE_ASSET_FORMAT_DXT5) {
+                    encode_alpha_block(block, out);
+                    encode_colour_block(block, 0, out + 8);
+                } else {
+                    encode_colour_block(block, 1, out);
+                }
+                out += block_size;
+            }
+        }
+    } else if (format == TEXTURE_ASSET_FORMAT_P8_SWIZZLED) {
+        data_size = data_width * data_height;
+        data = malloc(data_size);
+
+        for (uint32_t y = 0; y < data_height; y++) {
+            for (uint32_t x = 0; x < data_width; x++) {
+                const uint8_t *c = padded_pixel(rgba, width, height, x, y);
+                const uint32_t argb = (uint32_t)c[3] << 24 | (uint32_t)c[0] << 16 | (uint32_t)c[1] << 8 | c[2];
+
+                uint32_t index = 0;
+                while (index < palette_count && palette[index] != argb) {
+                    index++;
+                }
+                if (index == palette_count) {
+                    if (palette_count == 256) {
+                        fprintf(stderr, "%s has more than 256 colours, use another format\n", argv[1]);
+                        return 1;
+                    }
+                    palette[palette_count++] = argb;
+                }
+                data[swizzle_offset(x, y, data_width, data_height)] = (uint8_t)index;
+            }
+        }
+
+        // The GPU always reads the full palette length
+        memset(&palette[palette_count], 0, (256 - palette_count) * sizeof(uint32_t));
+        palette_count = 256;
+    } else {
+        const int swizzled = (format == TEXTURE_ASSET_FORMAT_A8B8G8R8_SWIZZLED);
+        data_size = data_width * data_height * 4;
+        data = malloc(data_size);
+
+        for (uint32_t y = 0; y < data_height; y++) {
+            for (uint32_t x = 0; x < data_width; x++) {
+                const uint32_t offset = swizzled ? swizzle_offset(x, y, data_width, data_height) : y * data_width + x;
+                memcpy(&data[offset * 4], padded_pixel(rgba, width, height, x, y), 4);
+            }
+        }
+    }
+
+    texture_asset_header_t header = {
+        .magic = TEXTURE_ASSET_MAGIC,
+        .version = TEXTURE_ASSET_VERSION,
+        .format = format,
+        .width = width,
+        .height = height,
+        .data_width = data_width,
+        .data_height = data_height,
+        .palette_count = palette_count,
+        .data_size = data_size};
+
+    FILE *f = fopen(argv[3], "wb");
+    if (f == NULL) {
+        fprintf(stderr, "Could not open %s for writing\n", argv[3]);
+        return 1;
+    }
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(palette, sizeof(uint32_t), palette_count, f);
+    fwrite(data, 1, data_size, f);
+    fclose(f);
+
+    // Compare against what a padded linear A8B8G8R8 texture used to cost at runtime
+    const uint32_t gpu_size = data_size + palette_count * sizeof(uint32_t);
+    const uint32_t linear_size = npot2pot(width) * npot2pot(height) * 4;
+    printf("Encoded %s (%dx%d) as %s %ux%u: %u bytes of GPU memory, %u%% of linear A8B8G8R8 (%u bytes)\n",
+           argv[1], width, height, argv[2], data_width, data_height, gpu_size, gpu_size * 100 / linear_size, linear_size);
+
+    free(data);
+    stbi_image_free(rgba);
+    return 0;
+}
@@ -0,0 +1,126 @@
+/* utf8_bench.c
+ * Measures the throughput of utf8_decode in support_utf8.c on a few kinds of text, next to the byte at a time
+ * decoder support_text.c used before it for comparison.
+ *
+ * Usage: utf8_bench [megabytes]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "support_utf8.h"
+
+#define BENCH_TEXT_SIZE (64 * 1024)
+#define BENCH_CHUNK     64 // Same as TEXT_DECODE_CHUNK in support_text.c
+#define BENCH_ROUNDS    16
+
+// The previous decoder, one codepoint per call without validation
+static int old_utf8_decode(const char *s, int *len)
+{
+    const unsigned char *p = (const unsigned char *)s;
+    if (p[0] < 0x80) {
+        *len = 1;
+        return p[0];
+    }
+    if ((p[0] & 0xE0) == 0xC0 && (p[1] & 0xC0) == 0x80) {
+        *len = 2;
+        return (p[0] & 0x1F) << 6 | (p[1] & 0x3F);
+    }
+    if ((p[0] & 0xF0) == 0xE0 && (p[1] & 0xC0) == 0x80 && (p[2] & 0xC0) == 0x80) {
+        *len = 3;
+        return (p[0] & 0x0F) << 12 | (p[1] & 0x3F) << 6 | (p[2] & 0x3F);
+    }
+    if ((p[0] & 0xF8) == 0xF0 && (p[1] & 0xC0) == 0x80 && (p[2] & 0xC0) == 0x80 && (p[3] & 0xC0) == 0x80) {
+        *len = 4;
+        return (p[0] & 0x07) << 18 | (p[1] & 0x3F) << 12 | (p[2] & 0x3F) << 6 | (p[3] & 0x3F);
+    }
+    *len = 1;
+    return 0;
+}
+
+static double now_seconds(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// Fills the buffer by repeating sample without splitting a sequence, then NUL terminates it
+static void fill_text(char *text, const char *sample)
+{
+    const size_t sample_length = strlen(sample);
+    size_t i = 0;
+    while (i + sample_length < BENCH_TEXT_SIZE) {
+        memcpy(&text[i], sample, sample_length);
+        i += sample_length;
+    }
+    text[i] = '\0';
+}
+
+// The passes are split into rounds alternating between the decoders, and the fastest round of each is reported so
+// that other work on the machine skews both the same way
+static void bench(const char *name, const char *text, long passes)
+{
+    static int codepoint[BENCH_CHUNK];
+    const size_t length = strlen(text);
+    const long round_passes = (passes + BENCH_ROUNDS - 1) / BENCH_ROUNDS;
+    volatile int sink = 0;
+    double old_seconds = 0.0, new_seconds = 0.0;
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        double start = now_seconds();
+        for (long n = 0; n < round_passes; n++) {
+            for (const char *p = text; *p; p++) {
+                int len;
+                sink += old_utf8_decode(p, &len);
+                p += len - 1;
+            }
+        }
+        const double old_round = now_seconds() - start;
+
+        start = now_seconds();
+        for (long n = 0; n < round_passes; n++) {
+            const char *p = text;
+            size_t remaining = length;
+            while (remaining > 0) {
+                size_t consumed;
+                const int count = utf8_decode(p, remaining, codepoint, BENCH_CHUNK, &consumed);
+                sink += codepoint[count - 1];
+                p += consumed;
+                remaining -= consumed;
+            }
+        }
+        const double new_round = now_seconds() - start;
+
+        old_seconds = (round == 0 || old_round < old_seconds) ? old_round : old_seconds;
+        new_seconds = (round == 0 || new_round < new_seconds) ? new_round : new_seconds;
+    }
+
+    const double megabytes = (double)length * round_passes / (1024.0 * 1024.0);
+    printf("%-10s old %8.1f MB/s  new %8.1f MB/s  %.2fx\n", name, megabytes / old_seconds, megabytes / new_seconds,
+           old_seconds / new_seconds);
+}
+
+int main(int argc, char **argv)
+{
+    const long megabytes = (argc > 1) ? atol(argv[1]) : 256;
+    const long passes = megabytes * 1024 * 1024 / BENCH_TEXT_SIZE;
+    if (passes <= 0) {
+        fprintf(stderr, "Usage: %s [megabytes]\n", argv[0]);
+        return 1;
+    }
+
+    static char text[BENCH_TEXT_SIZE];
+    fill_text(text, "System Info EEPROM Settings 192.168.1.100 FTP Server - Active ");
+    bench("ascii", text, passes);
+    fill_text(text, "Système Paramètres réseau Sauvegardé ");
+    bench("latin", text, passes);
+    fill_text(text, "システム情報 ネットワーク設定 ");
+    bench("cjk", text, passes);
+    fill_text(text, "Game_\xC3\xA9\xFF\xE2\x82 Save \xED\xA0\x80 Data ");
+    bench("malformed", text, passes);
+    return 0;
+}
@@ -0,0 +1,166 @@
+/* utf8_fuzz.c
+ * Fuzz target for utf8_decode in support_utf8.c. Every input is decoded whole and in small chunks and compared
+ * against a plain byte at a time reference decoder written straight from the Unicode standard.
+ *
+ * Built with clang this is a libFuzzer target:
+ *   utf8_fuzz [corpus_dir]
+ * Otherwise it runs its own random inputs biased towards UTF-8 lead and continuation bytes:
+ *   utf8_fuzz [iterations] [seed]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "support_utf8.h"
+
+#define FUZZ_MAX_INPUT 4096
+
+// Reference decoder, one codepoint per call. Returns the codepoint and sets len to the bytes used.
+static int reference_decode(const uint8_t *p, size_t length, int *len)
+{
+    int need, codepoint;
+    uint8_t lo = 0x80, hi = 0xBF;
+
+    if (p[0] < 0x80) {
+        *len = 1;
+        return p[0];
+    } else if (p[0] >= 0xC2 && p[0] <= 0xDF) {
+        need = 1, codepoint = p[0] & 0x1F;
+    } else if (p[0] == 0xE0) {
+        need = 2, codepoint = p[0] & 0x0F, lo = 0xA0;
+    } else if (p[0] == 0xED) {
+        need = 2, codepoint = p[0] & 0x0F, hi = 0x9F;
+    } else if (p[0] >= 0xE1 && p[0] <= 0xEF) {
+        need = 2, codepoint = p[0] & 0x0F;
+    } else if (p[0] == 0xF0) {
+        need = 3, codepoint = p[0] & 0x07, lo = 0x90;
+    } else if (p[0] == 0xF4) {
+        need = 3, codepoint = p[0] & 0x07, hi = 0x8F;
+    } else if (p[0] >= 0xF1 && p[0] <= 0xF3) {
+        need = 3, codepoint = p[0] & 0x07;
+    } else {
+        *len = 1;
+        return UTF8_REPLACEMENT_CHARACTER;
+    }
+
+    for (int i = 1; i <= need; i++) {
+        if (i >= (int)length || p[i] < lo || p[i] > hi) {
+            *len = i;
+            return UTF8_REPLACEMENT_CHARACTER;
+        }
+        codepoint = (codepoint << 6) | (p[i] & 0x3F);
+        lo = 0x80, hi = 0xBF;
+    }
+    *len = need + 1;
+    return codepoint;
+}
+
+static void fail(const char *what, const uint8_t *data, size_t size)
+{
+    fprintf(stderr, "utf8_fuzz: %s for input of %zu bytes:", what, size);
+    for (size_t i = 0; i < size; i++) {
+        fprintf(stderr, " %02X", data[i]);
+    }
+    fprintf(stderr, "\n");
+    abort();
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static int expected[FUZZ_MAX_INPUT];
+    static int decoded[FUZZ_MAX_INPUT + 32]; // Chunked decoding can write a partial chunk past the end
+    if (size > FUZZ_MAX_INPUT) {
+        return 0;
+    }
+
+    int expected_count = 0;
+    for (size_t i = 0; i < size;) {
+        int len;
+        expected[expected_count++] = reference_decode(&data[i], size - i, &len);
+        i += len;
+    }
+
+    // One guard entry past the end catches writes beyond max_codepoints
+    size_t consumed;
+    decoded[expected_count] = -1;
+    int count = utf8_decode((const char *)data, size, decoded, expected_count, &consumed);
+    if (count != expected_count || consumed != size || decoded[expected_count] != -1) {
+        fail("whole buffer decode length mismatch", data, size);
+    }
+    if (memcmp(decoded, expected, sizeof(int) * count) != 0) {
+        fail("whole buffer decode mismatch", data, size);
+    }
+
+    // Chunked decoding has to give the same codepoints, whatever the chunk size
+    for (int chunk = 1; chunk <= 17; chunk += 4) {
+        size_t offset = 0;
+        count = 0;
+        while (offset < size) {
+            const int n = utf8_decode((const char *)data + offset, size - offset, &decoded[count], chunk, &consumed);
+            if (n <= 0 || n > chunk || consumed == 0 || consumed > size - offset) {
+                fail("chunked decode made no progress", data, size);
+            }
+            offset += consumed;
+            count += n;
+        }
+        if (count != expected_count || memcmp(decoded, expected, sizeof(int) * count) != 0) {
+            fail("chunked decode mismatch", data, size);
+        }
+    }
+    return 0;
+}
+
+#ifndef UTF8_FUZZ_LIBFUZZER
+static uint32_t rng_state;
+
+static uint32_t rng_next(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// Bytes interesting to a UTF-8 decoder are far more likely than uniformly random ones
+static uint8_t random_byte(void)
+{
+    static const uint8_t interesting[] = {0x00, 0x41, 0x7F, 0x80, 0x8F, 0x90, 0x9F, 0xA0, 0xBF, 0xC0, 0xC1,
+                                          0xC2, 0xDF, 0xE0, 0xE1, 0xEC, 0xED, 0xEE, 0xEF, 0xF0, 0xF1, 0xF3,
+                                          0xF4, 0xF5, 0xF8, 0xFE, 0xFF};
+    const uint32_t r = rng_next();
+    switch (r % 4) {
+        case 0:
+            return interesting[(r >> 8) % sizeof(interesting)];
+        case 1:
+            return 0x80 | ((r >> 8) & 0x3F);
+        case 2:
+            return (r >> 8) & 0x7F;
+        default:
+            return (uint8_t)(r >> 8);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const long iterations = (argc > 1) ? atol(argv[1]) : 1000000;
+    rng_state = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : 0x12345678;
+    if (rng_state == 0) {
+        rng_state = 1;
+    }
+
+    static uint8_t input[FUZZ_MAX_INPUT];
+    for (long n = 0; n < iterations; n++) {
+        // Mostly short inputs, with the occasional long one to cover the ASCII fast path and chunk boundaries
+        const size_t size = (rng_next() % 16 == 0) ? rng_next() % FUZZ_MAX_INPUT : rng_next() % 48;
+        const int ascii_run = rng_next() % 3 == 0;
+        for (size_t i = 0; i < size; i++) {
+            input[i] = (ascii_run && rng_next() % 8 != 0) ? 0x20 + rng_next() % 0x5F : random_byte();
+        }
+        LLVMFuzzerTestOneInput(input, size);
+    }
+    printf("%ld inputs decoded without a mismatch\n", iterations);
+    return 0;
+}
+#endif